@@ -0,0 +1,947 @@
+/*====================================================================*
+ *
+ *   host_port.c
+ *
+ *   POSIX implementation of the ESP-IDF and FreeRTOS calls used by the
+ *   driver, so qca_spi.c and friends run unchanged on a Linux host.
+ *
+ *   Tasks are threads, a tick is one millisecond of CLOCK_MONOTONIC,
+ *   every esp_timer has its own thread and SPI transactions go to the
+ *   device registered with host_spi_attach. Good enough for tools and
+ *   benchmarks, not a scheduler model: priorities and cores are ignored.
+ *
+ *--------------------------------------------------------------------*/
+
+#include "driver/gpio.h"
+#include "driver/spi_master.h"
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+esp_log_level_t host_log_level = ESP_LOG_WARN;
+
+/*====================================================================*
+ *   time;
+ *--------------------------------------------------------------------*/
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / (1000 * portTICK_PERIOD_MS));
+}
+
+/* Absolute CLOCK_MONOTONIC deadline for a wait of ticks */
+static struct timespec host_deadline(TickType_t ticks)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ticks / 1000;
+    ts.tv_nsec += (long)(ticks % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+static void host_cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/* Wait on cond until pred holds or ticks pass. Return: pred */
+#define HOST_WAIT(cond, mutex, pred, ticks)                                             \
+    ({                                                                                  \
+        struct timespec dl_ = host_deadline(ticks);                                     \
+        int rc_             = 0;                                                        \
+        while (!(pred) && rc_ != ETIMEDOUT)                                             \
+        {                                                                               \
+            if ((ticks) == portMAX_DELAY)                                               \
+                pthread_cond_wait((cond), (mutex));                                     \
+            else if ((ticks) == 0)                                                      \
+                rc_ = ETIMEDOUT;                                                        \
+            else                                                                        \
+                rc_ = pthread_cond_timedwait((cond), (mutex), &dl_);                    \
+        }                                                                               \
+        (bool)(pred);                                                                   \
+    })
+
+/*====================================================================*
+ *   critical sections;
+ *--------------------------------------------------------------------*/
+
+void portMUX_INITIALIZE(portMUX_TYPE *mux)
+{
+    pthread_mutex_init(&mux->mutex, NULL);
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    return 0;
+}
+
+/*====================================================================*
+ *   tasks and notifications;
+ *--------------------------------------------------------------------*/
+
+/* 64 bit code needs about twice the stack of the ESP32 build. Tasks
+ * get HOST_STACK_SCALE times what they ask for, plus slack for glibc;
+ * the high-water mark leaves the slack out and is scaled back, so it
+ * is a rough guide to the headroom on the target. */
+#define HOST_STACK_SCALE 2
+#define HOST_STACK_SLACK (256 * 1024)
+#define HOST_STACK_FILL  0xA5
+
+struct host_task {
+    pthread_t thread;
+    uint8_t *stack; /* Lowest address, NULL for threads not from xTaskCreate */
+    size_t stack_size;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t value;
+    bool pending;
+    TaskFunction_t fn;
+    void *arg;
+    const char *name;
+};
+
+static __thread struct host_task *host_self;
+
+static struct host_task *host_task_new(TaskFunction_t fn, void *arg, const char *name)
+{
+    struct host_task *task = calloc(1, sizeof(*task));
+
+    if (task == NULL)
+        return NULL;
+    pthread_mutex_init(&task->lock, NULL);
+    host_cond_init(&task->cond);
+    task->fn   = fn;
+    task->arg  = arg;
+    task->name = name;
+    return task;
+}
+
+static void *host_task_entry(void *arg)
+{
+    host_self = arg;
+    host_self->fn(host_self->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *handle, BaseType_t core)
+{
+    struct host_task *task = host_task_new(fn, arg, name);
+    pthread_attr_t attr;
+    int err;
+
+    (void)prio;
+    (void)core;
+
+    if (task == NULL)
+        return pdFAIL;
+
+    /* A painted stack of our own, for uxTaskGetStackHighWaterMark */
+    task->stack_size = stack * HOST_STACK_SCALE + HOST_STACK_SLACK;
+    if (posix_memalign((void **)&task->stack, 4096, task->stack_size) != 0)
+    {
+        free(task);
+        return pdFAIL;
+    }
+    memset(task->stack, HOST_STACK_FILL, task->stack_size);
+
+    /* The handle must be valid before the task runs, as on FreeRTOS */
+    if (handle != NULL)
+        *handle = task;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, task->stack, task->stack_size);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    err = pthread_create(&task->thread, &attr, host_task_entry, task);
+    pthread_attr_destroy(&attr);
+
+    if (err != 0)
+    {
+        if (handle != NULL)
+            *handle = NULL;
+        free(task->stack);
+        free(task);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio,
+                       TaskHandle_t *handle)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack, arg, prio, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == host_self)
+        pthread_exit(NULL);
+    /* Deleting another task is not supported, threads end on their own */
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    /* Threads not created through xTaskCreate (e.g. main) get a handle on first use */
+    if (host_self == NULL)
+        host_self = host_task_new(NULL, NULL, "host");
+    return host_self;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = {.tv_sec = ticks / 1000, .tv_nsec = (long)(ticks % 1000) * 1000000};
+
+    if (ticks == 0)
+        sched_yield();
+    else
+        while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    size_t untouched = 0;
+
+    if (task == NULL)
+        task = xTaskGetCurrentTaskHandle();
+    if (task->stack == NULL)
+        return 0;
+
+    /* The stack grows down from the top */
+    while (untouched < task->stack_size && task->stack[untouched] == HOST_STACK_FILL) untouched++;
+
+    return (untouched > HOST_STACK_SLACK) ? (UBaseType_t)((untouched - HOST_STACK_SLACK) / HOST_STACK_SCALE) : 0;
+}
+
+static BaseType_t host_notify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    BaseType_t ret = pdPASS;
+
+    pthread_mutex_lock(&task->lock);
+    switch (action)
+    {
+    case eSetBits:
+        task->value |= value;
+        break;
+    case eIncrement:
+        task->value++;
+        break;
+    case eSetValueWithoutOverwrite:
+        if (task->pending)
+        {
+            ret = pdFAIL;
+            break;
+        }
+        /* fall through */
+    case eSetValueWithOverwrite:
+        task->value = value;
+        break;
+    case eNoAction:
+        break;
+    }
+    task->pending = true;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return ret;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    return host_notify(task, value, action);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    return host_notify(task, 0, eIncrement);
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t *woken)
+{
+    if (woken != NULL)
+        *woken = pdFALSE;
+    return host_notify(task, value, action);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken)
+{
+    if (woken != NULL)
+        *woken = pdFALSE;
+    host_notify(task, 0, eIncrement);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    struct host_task *self = xTaskGetCurrentTaskHandle();
+    uint32_t value;
+
+    pthread_mutex_lock(&self->lock);
+    HOST_WAIT(&self->cond, &self->lock, self->value != 0, ticks);
+    value = self->value;
+    if (value)
+        self->value = clear ? 0 : value - 1;
+    self->pending = false;
+    pthread_mutex_unlock(&self->lock);
+    return value;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks)
+{
+    struct host_task *self = xTaskGetCurrentTaskHandle();
+    bool got;
+
+    pthread_mutex_lock(&self->lock);
+    if (!self->pending)
+        self->value &= ~clear_on_entry;
+    got = HOST_WAIT(&self->cond, &self->lock, self->pending, ticks);
+    if (value != NULL)
+        *value = self->value;
+    if (got)
+        self->value &= ~clear_on_exit;
+    self->pending = false;
+    pthread_mutex_unlock(&self->lock);
+    return got ? pdTRUE : pdFALSE;
+}
+
+/*====================================================================*
+ *   event groups;
+ *--------------------------------------------------------------------*/
+
+struct host_event_group {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    EventBits_t bits;
+};
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct host_event_group *group = calloc(1, sizeof(*group));
+
+    if (group == NULL)
+        return NULL;
+    pthread_mutex_init(&group->lock, NULL);
+    host_cond_init(&group->cond);
+    return group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    EventBits_t ret;
+
+    pthread_mutex_lock(&group->lock);
+    ret = (group->bits |= bits);
+    pthread_cond_broadcast(&group->cond);
+    pthread_mutex_unlock(&group->lock);
+    return ret;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    EventBits_t ret;
+
+    pthread_mutex_lock(&group->lock);
+    ret = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return ret;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    EventBits_t ret;
+
+    pthread_mutex_lock(&group->lock);
+    ret = group->bits;
+    pthread_mutex_unlock(&group->lock);
+    return ret;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear, BaseType_t all,
+                                TickType_t ticks)
+{
+    EventBits_t ret;
+    bool got;
+
+    pthread_mutex_lock(&group->lock);
+    got = HOST_WAIT(&group->cond, &group->lock, all ? (group->bits & bits) == bits : (group->bits & bits) != 0, ticks);
+    ret = group->bits;
+    if (got && clear)
+        group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return ret;
+}
+
+/*====================================================================*
+ *   queues and semaphores;
+ *--------------------------------------------------------------------*/
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t *items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *queue = calloc(1, sizeof(*queue));
+
+    if (queue == NULL)
+        return NULL;
+    if (item_size && (queue->items = calloc(length, item_size)) == NULL)
+    {
+        free(queue);
+        return NULL;
+    }
+    pthread_mutex_init(&queue->lock, NULL);
+    host_cond_init(&queue->cond);
+    queue->length    = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    free(queue->items);
+    free(queue);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    bool got;
+
+    pthread_mutex_lock(&queue->lock);
+    got = HOST_WAIT(&queue->cond, &queue->lock, queue->count < queue->length, ticks);
+    if (got)
+    {
+        if (queue->item_size && item != NULL)
+            memcpy(queue->items + ((queue->head + queue->count) % queue->length) * queue->item_size, item,
+                   queue->item_size);
+        queue->count++;
+        pthread_cond_broadcast(&queue->cond);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return got ? pdPASS : pdFAIL;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    bool got;
+
+    pthread_mutex_lock(&queue->lock);
+    got = HOST_WAIT(&queue->cond, &queue->lock, queue->count > 0, ticks);
+    if (got)
+    {
+        if (queue->item_size && item != NULL)
+            memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_broadcast(&queue->cond);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return got ? pdPASS : pdFAIL;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    UBaseType_t count;
+
+    pthread_mutex_lock(&queue->lock);
+    count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->head  = 0;
+    queue->count = 0;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    QueueHandle_t sem = xQueueCreate(max, 0);
+
+    if (sem != NULL)
+        sem->count = initial;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    return xQueueReceive(sem, NULL, ticks);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return xQueueSend(sem, NULL, 0);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    vQueueDelete(sem);
+}
+
+/*====================================================================*
+ *   esp_timer;
+ *--------------------------------------------------------------------*/
+
+struct host_timer {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    esp_timer_cb_t callback;
+    void *arg;
+    int64_t deadline; /* us, 0 while stopped */
+    uint64_t period;  /* us, 0 for one-shot */
+    bool deleted;
+};
+
+static void *host_timer_thread(void *arg)
+{
+    struct host_timer *timer = arg;
+
+    pthread_mutex_lock(&timer->lock);
+    while (!timer->deleted)
+    {
+        if (timer->deadline == 0)
+        {
+            pthread_cond_wait(&timer->cond, &timer->lock);
+            continue;
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (now < timer->deadline)
+        {
+            struct timespec ts = {.tv_sec = timer->deadline / 1000000, .tv_nsec = (timer->deadline % 1000000) * 1000};
+            pthread_cond_timedwait(&timer->cond, &timer->lock, &ts);
+            continue;
+        }
+
+        timer->deadline = timer->period ? timer->deadline + (int64_t)timer->period : 0;
+        pthread_mutex_unlock(&timer->lock);
+        timer->callback(timer->arg);
+        pthread_mutex_lock(&timer->lock);
+    }
+    pthread_mutex_unlock(&timer->lock);
+    free(timer);
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle)
+{
+    struct host_timer *timer = calloc(1, sizeof(*timer));
+
+    if (timer == NULL)
+        return ESP_ERR_NO_MEM;
+    pthread_mutex_init(&timer->lock, NULL);
+    host_cond_init(&timer->cond);
+    timer->callback = args->callback;
+    timer->arg      = args->arg;
+    if (pthread_create(&timer->thread, NULL, host_timer_thread, timer) != 0)
+    {
+        free(timer);
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_detach(timer->thread);
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t host_timer_start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period)
+{
+    esp_err_t ret = ESP_OK;
+
+    pthread_mutex_lock(&timer->lock);
+    if (timer->deadline != 0)
+    {
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    else
+    {
+        timer->deadline = esp_timer_get_time() + (int64_t)(timeout_us ? timeout_us : 1);
+        timer->period   = period;
+        pthread_cond_signal(&timer->cond);
+    }
+    pthread_mutex_unlock(&timer->lock);
+    return ret;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return host_timer_start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    return host_timer_start(timer, period, period);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    esp_err_t ret = ESP_OK;
+
+    pthread_mutex_lock(&timer->lock);
+    if (timer->deadline == 0)
+        ret = ESP_ERR_INVALID_STATE;
+    timer->deadline = 0;
+    pthread_cond_signal(&timer->cond);
+    pthread_mutex_unlock(&timer->lock);
+    return ret;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    pthread_mutex_lock(&timer->lock);
+    timer->deleted = true;
+    pthread_cond_signal(&timer->cond);
+    pthread_mutex_unlock(&timer->lock);
+    return ESP_OK;
+}
+
+/*====================================================================*
+ *   gpio;
+ *--------------------------------------------------------------------*/
+
+static struct {
+    uint32_t level[GPIO_NUM_MAX];
+    gpio_isr_t isr[GPIO_NUM_MAX];
+    void *isr_arg[GPIO_NUM_MAX];
+    void (*level_hook)(gpio_num_t pin, uint32_t level);
+} host_gpio;
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    (void)config;
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int flags)
+{
+    (void)flags;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t handler, void *arg)
+{
+    if (pin < 0 || pin >= GPIO_NUM_MAX)
+        return ESP_ERR_INVALID_ARG;
+    host_gpio.isr_arg[pin] = arg;
+    host_gpio.isr[pin]     = handler;
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t pin)
+{
+    (void)pin;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t pin, gpio_mode_t mode)
+{
+    (void)pin;
+    (void)mode;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level)
+{
+    if (pin < 0 || pin >= GPIO_NUM_MAX)
+        return ESP_ERR_INVALID_ARG;
+    host_gpio.level[pin] = level;
+    if (host_gpio.level_hook != NULL)
+        host_gpio.level_hook(pin, level);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t pin)
+{
+    return (pin >= 0 && pin < GPIO_NUM_MAX) ? (int)host_gpio.level[pin] : 0;
+}
+
+void host_gpio_trigger(gpio_num_t pin)
+{
+    if (pin >= 0 && pin < GPIO_NUM_MAX && host_gpio.isr[pin] != NULL)
+        host_gpio.isr[pin](host_gpio.isr_arg[pin]);
+}
+
+void host_gpio_set_level_hook(void (*hook)(gpio_num_t pin, uint32_t level))
+{
+    host_gpio.level_hook = hook;
+}
+
+/*====================================================================*
+ *   spi;
+ *--------------------------------------------------------------------*/
+
+static struct {
+    pthread_mutex_t lock;
+    esp_err_t (*xfer)(void *ctx, spi_transaction_t *trans);
+    void *ctx;
+} host_spi = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *config, int dma)
+{
+    (void)host;
+    (void)config;
+    (void)dma;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *config,
+                             spi_device_handle_t *handle)
+{
+    (void)host;
+    (void)config;
+    /* There is only one device, the handle just has to be non-NULL */
+    *handle = (spi_device_handle_t)&host_spi;
+    return ESP_OK;
+}
+
+void host_spi_attach(esp_err_t (*xfer)(void *ctx, spi_transaction_t *trans), void *ctx)
+{
+    pthread_mutex_lock(&host_spi.lock);
+    host_spi.xfer = xfer;
+    host_spi.ctx  = ctx;
+    pthread_mutex_unlock(&host_spi.lock);
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans)
+{
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+
+    (void)handle;
+
+    /* Transactions are atomic, as on the real bus */
+    pthread_mutex_lock(&host_spi.lock);
+    if (host_spi.xfer != NULL)
+        ret = host_spi.xfer(host_spi.ctx, trans);
+    pthread_mutex_unlock(&host_spi.lock);
+    return ret;
+}
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *trans)
+{
+    return spi_device_transmit(handle, trans);
+}
+
+/*====================================================================*
+ *   uart;
+ *--------------------------------------------------------------------*/
+
+static struct host_uart {
+    int fd;
+    pthread_t reader;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    QueueHandle_t events;
+    uint8_t *ring;
+    size_t size;
+    size_t head;
+    size_t count;
+} host_uart[UART_NUM_MAX];
+
+static void *host_uart_reader(void *arg)
+{
+    struct host_uart *uart = arg;
+    uint8_t buf[256];
+    ssize_t len, i;
+
+    for (;;)
+    {
+        len = read(uart->fd, buf, sizeof(buf));
+        if (len <= 0)
+        {
+            if (len < 0 && errno == EINTR)
+                continue;
+            return NULL;
+        }
+
+        /* No overflow on the host: the writer waits, like with RTS/CTS */
+        pthread_mutex_lock(&uart->lock);
+        for (i = 0; i < len; i++)
+        {
+            HOST_WAIT(&uart->cond, &uart->lock, uart->count < uart->size, portMAX_DELAY);
+            uart->ring[(uart->head + uart->count) % uart->size] = buf[i];
+            uart->count++;
+        }
+        pthread_cond_broadcast(&uart->cond);
+        pthread_mutex_unlock(&uart->lock);
+
+        if (uart->events != NULL)
+        {
+            uart_event_t event = {.type = UART_DATA, .size = (size_t)len};
+            xQueueSend(uart->events, &event, 0);
+        }
+    }
+}
+
+void host_uart_attach(uart_port_t port, int fd)
+{
+    struct termios tio;
+
+    if (tcgetattr(fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    host_uart[port].fd = fd;
+}
+
+esp_err_t uart_driver_install(uart_port_t port, int rx_buffer_size, int tx_buffer_size, int queue_size,
+                              QueueHandle_t *uart_queue, int intr_alloc_flags)
+{
+    struct host_uart *uart = &host_uart[port];
+
+    (void)tx_buffer_size;
+    (void)intr_alloc_flags;
+    if (port < 0 || port >= UART_NUM_MAX || rx_buffer_size <= 0)
+        return ESP_ERR_INVALID_ARG;
+
+    pthread_mutex_init(&uart->lock, NULL);
+    host_cond_init(&uart->cond);
+    uart->size = (size_t)rx_buffer_size;
+    uart->ring = malloc(uart->size);
+    if (uart->ring == NULL)
+        return ESP_ERR_NO_MEM;
+    if (uart_queue != NULL && queue_size > 0)
+        *uart_queue = uart->events = xQueueCreate(queue_size, sizeof(uart_event_t));
+    if (pthread_create(&uart->reader, NULL, host_uart_reader, uart) != 0)
+        return ESP_ERR_NO_MEM;
+    pthread_detach(uart->reader);
+    return ESP_OK;
+}
+
+esp_err_t uart_param_config(uart_port_t port, const uart_config_t *config)
+{
+    (void)port;
+    (void)config;
+    return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t port, int tx, int rx, int rts, int cts)
+{
+    (void)port;
+    (void)tx;
+    (void)rx;
+    (void)rts;
+    (void)cts;
+    return ESP_OK;
+}
+
+esp_err_t uart_set_rx_full_threshold(uart_port_t port, int threshold)
+{
+    (void)port;
+    (void)threshold;
+    return ESP_OK;
+}
+
+int uart_read_bytes(uart_port_t port, void *buf, uint32_t length, TickType_t ticks_to_wait)
+{
+    struct host_uart *uart = &host_uart[port];
+    uint8_t *dst           = buf;
+    uint32_t got           = 0;
+
+    pthread_mutex_lock(&uart->lock);
+    HOST_WAIT(&uart->cond, &uart->lock, uart->count >= length, ticks_to_wait);
+    while (got < length && uart->count > 0)
+    {
+        dst[got++] = uart->ring[uart->head];
+        uart->head = (uart->head + 1) % uart->size;
+        uart->count--;
+    }
+    pthread_cond_broadcast(&uart->cond);
+    pthread_mutex_unlock(&uart->lock);
+    return (int)got;
+}
+
+int uart_write_bytes(uart_port_t port, const void *src, size_t size)
+{
+    const uint8_t *p = src;
+    size_t left      = size;
+    ssize_t len;
+
+    while (left > 0)
+    {
+        len = write(host_uart[port].fd, p, left);
+        if (len < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += len;
+        left -= (size_t)len;
+    }
+    return (int)size;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t port, size_t *size)
+{
+    struct host_uart *uart = &host_uart[port];
+
+    pthread_mutex_lock(&uart->lock);
+    *size = uart->count;
+    pthread_mutex_unlock(&uart->lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_flush_input(uart_port_t port)
+{
+    struct host_uart *uart = &host_uart[port];
+
+    pthread_mutex_lock(&uart->lock);
+    uart->head  = 0;
+    uart->count = 0;
+    pthread_cond_broadcast(&uart->cond);
+    pthread_mutex_unlock(&uart->lock);
+    return ESP_OK;
+}
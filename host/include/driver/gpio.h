@@ -0,0 +1,70 @@
+/*====================================================================*
+ *
+ *   gpio.h (host port)
+ *
+ *   Pins are plain levels. A registered ISR runs when host_gpio_trigger
+ *   is called, level changes are reported to an optional hook so a
+ *   simulated device can follow its reset line.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef HOST_GPIO_H
+#define HOST_GPIO_H
+
+#include "esp_attr.h"
+#include "esp_err.h"
+#include <stdint.h>
+
+typedef int gpio_num_t;
+
+#define GPIO_NUM_9  9
+#define GPIO_NUM_10 10
+#define GPIO_NUM_11 11
+#define GPIO_NUM_12 12
+#define GPIO_NUM_13 13
+#define GPIO_NUM_14 14
+#define GPIO_NUM_17 17
+#define GPIO_NUM_18 18
+#define GPIO_NUM_MAX 64
+
+typedef enum
+{
+    GPIO_INTR_DISABLE = 0,
+    GPIO_INTR_POSEDGE,
+    GPIO_INTR_NEGEDGE,
+    GPIO_INTR_ANYEDGE,
+} gpio_int_type_t;
+
+typedef enum
+{
+    GPIO_MODE_DISABLE = 0,
+    GPIO_MODE_INPUT,
+    GPIO_MODE_OUTPUT,
+} gpio_mode_t;
+
+typedef struct {
+    uint64_t pin_bit_mask;
+    gpio_mode_t mode;
+    int pull_up_en;
+    int pull_down_en;
+    gpio_int_type_t intr_type;
+} gpio_config_t;
+
+/* Accepted and ignored, there is no flash cache */
+#define ESP_INTR_FLAG_IRAM (1 << 10)
+
+typedef void (*gpio_isr_t)(void *arg);
+
+esp_err_t gpio_config(const gpio_config_t *config);
+esp_err_t gpio_install_isr_service(int flags);
+esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t handler, void *arg);
+esp_err_t gpio_reset_pin(gpio_num_t pin);
+esp_err_t gpio_set_direction(gpio_num_t pin, gpio_mode_t mode);
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level);
+int gpio_get_level(gpio_num_t pin);
+
+/* Host only */
+void host_gpio_trigger(gpio_num_t pin);
+void host_gpio_set_level_hook(void (*hook)(gpio_num_t pin, uint32_t level));
+
+#endif
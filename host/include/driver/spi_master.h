@@ -0,0 +1,62 @@
+/*====================================================================*
+ *
+ *   spi_master.h (host port)
+ *
+ *   Transactions go to whatever device was attached with
+ *   host_spi_attach, e.g. the QCA7000 model in host/qca7k_sim.c.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef HOST_SPI_MASTER_H
+#define HOST_SPI_MASTER_H
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct host_spi_device *spi_device_handle_t;
+typedef int spi_host_device_t;
+
+#define SPI2_HOST             1
+#define SPI_DMA_CH_AUTO       3
+#define SPI_DEVICE_HALFDUPLEX (1 << 4)
+
+typedef struct {
+    uint16_t cmd;
+    uint64_t addr;
+    size_t length;   /* TX bits */
+    size_t rxlength; /* RX bits */
+    void *user;
+    const void *tx_buffer;
+    void *rx_buffer;
+    uint32_t flags;
+} spi_transaction_t;
+
+typedef struct {
+    int mosi_io_num;
+    int miso_io_num;
+    int sclk_io_num;
+    int quadwp_io_num;
+    int quadhd_io_num;
+    int max_transfer_sz;
+} spi_bus_config_t;
+
+typedef struct {
+    uint8_t command_bits;
+    int clock_speed_hz;
+    uint8_t mode;
+    int spics_io_num;
+    int queue_size;
+    uint32_t flags;
+} spi_device_interface_config_t;
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *config, int dma);
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *config,
+                             spi_device_handle_t *handle);
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans);
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *trans);
+
+/* Host only: route every transaction to xfer */
+void host_spi_attach(esp_err_t (*xfer)(void *ctx, spi_transaction_t *trans), void *ctx);
+
+#endif
@@ -0,0 +1,13 @@
+/*====================================================================*
+ *
+ *   esp_attr.h (host port)
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef HOST_ESP_ATTR_H
+#define HOST_ESP_ATTR_H
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#endif
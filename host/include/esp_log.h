@@ -0,0 +1,41 @@
+/*====================================================================*
+ *
+ *   esp_log.h (host port)
+ *
+ *   Log lines go to stderr. host_log_level (default ESP_LOG_WARN)
+ *   selects how much is printed.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+#include "esp_err.h"
+#include <stdio.h>
+
+typedef enum
+{
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+} esp_log_level_t;
+
+extern esp_log_level_t host_log_level;
+
+#define HOST_LOG(level, letter, tag, fmt, ...)                                     \
+    do                                                                             \
+    {                                                                              \
+        if (host_log_level >= (level))                                             \
+            fprintf(stderr, letter " (%s) " fmt "\n", (tag), ##__VA_ARGS__);       \
+    } while (0)
+
+#define ESP_LOGE(tag, fmt, ...) HOST_LOG(ESP_LOG_ERROR, "E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) HOST_LOG(ESP_LOG_WARN, "W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) HOST_LOG(ESP_LOG_INFO, "I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) HOST_LOG(ESP_LOG_DEBUG, "D", tag, fmt, ##__VA_ARGS__)
+
+#define ESP_LOG_BUFFER_HEX(tag, buf, len) ((void)(tag), (void)(buf), (void)(len))
+
+#endif
@@ -0,0 +1,17 @@
+/*====================================================================*
+ *
+ *   esp_netif.h (host port)
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef HOST_ESP_NETIF_H
+#define HOST_ESP_NETIF_H
+
+typedef struct esp_netif_obj esp_netif_t;
+
+typedef struct {
+    esp_netif_t *netif;
+    void *post_attach;
+} esp_netif_driver_base_t;
+
+#endif
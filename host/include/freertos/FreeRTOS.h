@@ -0,0 +1,55 @@
+/*====================================================================*
+ *
+ *   FreeRTOS.h (host port)
+ *
+ *   FreeRTOS on POSIX threads, enough for the driver. One tick is one
+ *   millisecond, critical sections are mutexes (they must not nest) and
+ *   ISRs are plain function calls.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include "esp_attr.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+
+#define portMAX_DELAY      ((TickType_t)0xffffffffu)
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)  ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+#define tskIDLE_PRIORITY   0
+#define PRO_CPU_NUM        0
+#define APP_CPU_NUM        1
+#define tskNO_AFFINITY     0x7FFFFFFF
+#define portNUM_PROCESSORS 2
+
+#define portYIELD_FROM_ISR(x) ((void)(x))
+
+typedef struct {
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {PTHREAD_MUTEX_INITIALIZER}
+
+void portMUX_INITIALIZE(portMUX_TYPE *mux);
+#define portENTER_CRITICAL(mux)     pthread_mutex_lock(&(mux)->mutex)
+#define portEXIT_CRITICAL(mux)      pthread_mutex_unlock(&(mux)->mutex)
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)  portEXIT_CRITICAL(mux)
+
+BaseType_t xPortGetCoreID(void);
+
+#endif
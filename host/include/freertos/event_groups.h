@@ -0,0 +1,22 @@
+/*====================================================================*
+ *
+ *   event_groups.h (host port)
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef HOST_EVENT_GROUPS_H
+#define HOST_EVENT_GROUPS_H
+
+#include "FreeRTOS.h"
+
+typedef struct host_event_group *EventGroupHandle_t;
+typedef TickType_t EventBits_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear, BaseType_t all,
+                                TickType_t ticks);
+
+#endif
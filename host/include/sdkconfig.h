@@ -0,0 +1,12 @@
+/*====================================================================*
+ *
+ *   sdkconfig.h (host port)
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+
+#define CONFIG_QCA_HOST_PORT 1
+
+#endif
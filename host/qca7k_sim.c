@@ -0,0 +1,383 @@
+/*====================================================================*
+ *
+ *   qca7k_sim.c
+ *
+ *   QCA7000 SPI slave model for host builds, see qca7k_sim.h.
+ *
+ *   The write buffer drains instantly, so WRBUF_SPC_AVA always reads
+ *   QCASPI_HW_BUF_LEN. The read buffer is a byte FIFO of the same size.
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca7k_sim.h"
+#include "qca_7k.h"
+#include "qca_framing.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+static struct {
+    pthread_mutex_t lock;
+    gpio_num_t int_pin;
+    gpio_num_t rst_pin;
+    bool in_reset;
+    uint32_t down_ms; /* Length of the next soft reset */
+    bool loopback;
+    uint32_t loopback_drops;
+
+    uint16_t intr_cause;
+    uint16_t intr_enable;
+    uint16_t spi_config;
+    uint16_t bfr_size;
+    uint16_t action_ctrl;
+    uint16_t rdbuf_wm;
+    uint16_t wrbuf_wm;
+    uint16_t chunk;
+
+    uint8_t rdbuf[QCASPI_HW_BUF_LEN];
+    size_t rd_head;
+    size_t rd_fill;
+
+    qca7k_sim_tx_cb_t tx_cb;
+    void *tx_ctx;
+} sim = {.lock = PTHREAD_MUTEX_INITIALIZER, .int_pin = -1, .rst_pin = -1};
+
+/* Set interrupt causes, raising the line if an enabled cause was idle */
+static bool qca7k_sim_cause(uint16_t set)
+{
+    bool was_active = (sim.intr_cause & sim.intr_enable) != 0;
+
+    sim.intr_cause |= set;
+    return !was_active && (sim.intr_cause & sim.intr_enable) != 0;
+}
+
+/* Chip reset: buffers are lost and the CPU comes back on */
+static bool qca7k_sim_reset(void)
+{
+    sim.rd_head     = 0;
+    sim.rd_fill     = 0;
+    sim.intr_cause  = 0;
+    sim.intr_enable = SPI_INT_CPU_ON;
+    return qca7k_sim_cause(SPI_INT_CPU_ON);
+}
+
+static void qca7k_sim_irq(bool raise)
+{
+    if (raise && sim.int_pin >= 0)
+        host_gpio_trigger(sim.int_pin);
+}
+
+static uint16_t qca7k_sim_read_reg(uint16_t reg)
+{
+    switch (reg)
+    {
+    case SPI_REG_BFR_SIZE:
+        return sim.bfr_size;
+    case SPI_REG_WRBUF_SPC_AVA:
+        return QCASPI_HW_BUF_LEN;
+    case SPI_REG_RDBUF_BYTE_AVA:
+        return (sim.chunk && sim.rd_fill > sim.chunk) ? sim.chunk : (uint16_t)sim.rd_fill;
+    case SPI_REG_SPI_CONFIG:
+        return sim.spi_config;
+    case SPI_REG_INTR_CAUSE:
+        return sim.intr_cause;
+    case SPI_REG_INTR_ENABLE:
+        return sim.intr_enable;
+    case SPI_REG_RDBUF_WATERMARK:
+        return sim.rdbuf_wm;
+    case SPI_REG_WRBUF_WATERMARK:
+        return sim.wrbuf_wm;
+    case SPI_REG_SIGNATURE:
+        return QCASPI_GOOD_SIGNATURE;
+    case SPI_REG_ACTION_CTRL:
+        return sim.action_ctrl;
+    default:
+        return 0;
+    }
+}
+
+/* A slow soft reset: silent for down_ms, then CPU_ON */
+static void *qca7k_sim_down_thread(void *arg)
+{
+    bool raise;
+
+    usleep((useconds_t)(uintptr_t)arg * 1000);
+
+    pthread_mutex_lock(&sim.lock);
+    sim.in_reset = false;
+    raise        = qca7k_sim_reset();
+    pthread_mutex_unlock(&sim.lock);
+
+    qca7k_sim_irq(raise);
+    return NULL;
+}
+
+static bool qca7k_sim_write_reg(uint16_t reg, uint16_t value)
+{
+    bool raise = false;
+
+    switch (reg)
+    {
+    case SPI_REG_BFR_SIZE:
+        sim.bfr_size = value;
+        break;
+    case SPI_REG_SPI_CONFIG:
+        if (value & QCASPI_SLAVE_RESET_BIT)
+        {
+            if (sim.down_ms != 0)
+            {
+                pthread_t thread;
+
+                sim.in_reset = true;
+                pthread_create(&thread, NULL, qca7k_sim_down_thread, (void *)(uintptr_t)sim.down_ms);
+                pthread_detach(thread);
+                sim.down_ms = 0;
+            }
+            else
+            {
+                raise = qca7k_sim_reset();
+            }
+            value &= ~QCASPI_SLAVE_RESET_BIT;
+        }
+        sim.spi_config = value;
+        break;
+    case SPI_REG_INTR_CAUSE:
+        /* Write one to clear */
+        sim.intr_cause &= ~value;
+        break;
+    case SPI_REG_INTR_ENABLE:
+        raise           = !(sim.intr_cause & sim.intr_enable) && (sim.intr_cause & value);
+        sim.intr_enable = value;
+        break;
+    case SPI_REG_RDBUF_WATERMARK:
+        sim.rdbuf_wm = value;
+        break;
+    case SPI_REG_WRBUF_WATERMARK:
+        sim.wrbuf_wm = value;
+        break;
+    case SPI_REG_ACTION_CTRL:
+        sim.action_ctrl = value;
+        break;
+    default:
+        break;
+    }
+    return raise;
+}
+
+static bool qca7k_sim_read_ext(uint8_t *dst, size_t len)
+{
+    size_t n = (len < sim.rd_fill) ? len : sim.rd_fill;
+    size_t first = sizeof(sim.rdbuf) - sim.rd_head;
+
+    if (first > n)
+        first = n;
+    memcpy(dst, sim.rdbuf + sim.rd_head, first);
+    memcpy(dst + first, sim.rdbuf, n - first);
+    sim.rd_head = (sim.rd_head + n) % sizeof(sim.rdbuf);
+    sim.rd_fill -= n;
+
+    if (n == len)
+        return false;
+
+    /* Read beyond the buffered data */
+    memset(dst + n, 0, len - n);
+    return qca7k_sim_cause(SPI_INT_RDBUF_ERR);
+}
+
+/* Append to the read buffer, the caller checked for space */
+static void qca7k_sim_put(const uint8_t *src, size_t len)
+{
+    size_t tail  = (sim.rd_head + sim.rd_fill) % sizeof(sim.rdbuf);
+    size_t first = sizeof(sim.rdbuf) - tail;
+
+    if (first > len)
+        first = len;
+    memcpy(sim.rdbuf + tail, src, first);
+    memcpy(sim.rdbuf, src + first, len - first);
+    sim.rd_fill += len;
+}
+
+/* Queue a frame in the read buffer in the hardware format, caller holds the lock */
+static bool qca7k_sim_rx_put(const uint8_t *frame, uint16_t len, bool *raise)
+{
+    uint8_t hdr[QCASPI_HW_PKT_LEN + QCAFRM_HEADER_LEN];
+    uint8_t ftr[QCAFRM_FOOTER_LEN];
+    uint32_t hw_len = len + QCAFRM_FRAME_OVERHEAD;
+
+    if (sizeof(sim.rdbuf) - sim.rd_fill < sizeof(hdr) + len + sizeof(ftr))
+        return false;
+
+    /* Hardware length, big endian, followed by the regular framing */
+    hdr[0] = (uint8_t)(hw_len >> 24);
+    hdr[1] = (uint8_t)(hw_len >> 16);
+    hdr[2] = (uint8_t)(hw_len >> 8);
+    hdr[3] = (uint8_t)(hw_len >> 0);
+    QcaFrmCreateHeader(hdr + QCASPI_HW_PKT_LEN, len);
+    QcaFrmCreateFooter(ftr);
+
+    qca7k_sim_put(hdr, sizeof(hdr));
+    qca7k_sim_put(frame, len);
+    qca7k_sim_put(ftr, sizeof(ftr));
+
+    *raise = qca7k_sim_cause(SPI_INT_PKT_AVLBL);
+    return true;
+}
+
+static bool qca7k_sim_write_ext(const uint8_t *src, size_t len)
+{
+    bool raise = false;
+
+    if (len < QCAFRM_FRAME_OVERHEAD || len != sim.bfr_size)
+        return qca7k_sim_cause(SPI_INT_WRBUF_ERR);
+
+    if (sim.tx_cb != NULL)
+        sim.tx_cb(sim.tx_ctx, src + QCAFRM_HEADER_LEN, len - QCAFRM_FRAME_OVERHEAD);
+    if (sim.loopback && !qca7k_sim_rx_put(src + QCAFRM_HEADER_LEN, len - QCAFRM_FRAME_OVERHEAD, &raise))
+        sim.loopback_drops++;
+    return raise;
+}
+
+static esp_err_t qca7k_sim_xfer(void *ctx, spi_transaction_t *t)
+{
+    uint16_t reg = t->cmd & ~(QCA7K_SPI_READ | QCA7K_SPI_INTERNAL);
+    bool raise   = false;
+
+    (void)ctx;
+
+    pthread_mutex_lock(&sim.lock);
+    if (sim.in_reset)
+    {
+        /* Nobody answers, MISO stays low */
+        if (t->rx_buffer != NULL)
+            memset(t->rx_buffer, 0, t->rxlength / 8);
+    }
+    else if (t->cmd & QCA7K_SPI_INTERNAL)
+    {
+        if (t->cmd & QCA7K_SPI_READ)
+        {
+            uint16_t value = qca7k_sim_read_reg(reg);
+            uint8_t *rx    = t->rx_buffer;
+            rx[0]          = value >> 8;
+            rx[1]          = value & 0xFF;
+        }
+        else
+        {
+            const uint8_t *tx = t->tx_buffer;
+            raise             = qca7k_sim_write_reg(reg, (uint16_t)((tx[0] << 8) | tx[1]));
+        }
+    }
+    else if (t->cmd & QCA7K_SPI_READ)
+    {
+        raise = qca7k_sim_read_ext(t->rx_buffer, t->rxlength / 8);
+    }
+    else if (t->length)
+    {
+        raise = qca7k_sim_write_ext(t->tx_buffer, t->length / 8);
+    }
+    pthread_mutex_unlock(&sim.lock);
+
+    qca7k_sim_irq(raise);
+    return ESP_OK;
+}
+
+static void qca7k_sim_rst_level(gpio_num_t pin, uint32_t level)
+{
+    bool raise = false;
+
+    if (pin != sim.rst_pin)
+        return;
+
+    /* Reset is active low, the CPU comes up on the rising edge */
+    pthread_mutex_lock(&sim.lock);
+    if (sim.in_reset && level)
+        raise = qca7k_sim_reset();
+    sim.in_reset = !level;
+    pthread_mutex_unlock(&sim.lock);
+
+    qca7k_sim_irq(raise);
+}
+
+void qca7k_sim_init(gpio_num_t int_pin, gpio_num_t rst_pin)
+{
+    pthread_mutex_lock(&sim.lock);
+    sim.int_pin     = int_pin;
+    sim.rst_pin     = rst_pin;
+    sim.in_reset    = false;
+    sim.intr_cause  = 0;
+    sim.intr_enable = 0;
+    sim.rd_head     = 0;
+    sim.rd_fill     = 0;
+    pthread_mutex_unlock(&sim.lock);
+
+    if (rst_pin >= 0)
+        host_gpio_set_level_hook(qca7k_sim_rst_level);
+    host_spi_attach(qca7k_sim_xfer, NULL);
+}
+
+void qca7k_sim_set_tx_cb(qca7k_sim_tx_cb_t cb, void *ctx)
+{
+    pthread_mutex_lock(&sim.lock);
+    sim.tx_cb  = cb;
+    sim.tx_ctx = ctx;
+    pthread_mutex_unlock(&sim.lock);
+}
+
+void qca7k_sim_glitch(uint32_t down_ms)
+{
+    bool raise;
+
+    pthread_mutex_lock(&sim.lock);
+    sim.down_ms = down_ms;
+    raise       = qca7k_sim_cause(SPI_INT_WRBUF_ERR);
+    pthread_mutex_unlock(&sim.lock);
+
+    qca7k_sim_irq(raise);
+}
+
+void qca7k_sim_set_chunk(uint16_t chunk)
+{
+    pthread_mutex_lock(&sim.lock);
+    sim.chunk = chunk;
+    pthread_mutex_unlock(&sim.lock);
+}
+
+void qca7k_sim_set_loopback(bool loopback)
+{
+    pthread_mutex_lock(&sim.lock);
+    sim.loopback = loopback;
+    pthread_mutex_unlock(&sim.lock);
+}
+
+uint32_t qca7k_sim_loopback_drops(void)
+{
+    uint32_t drops;
+
+    pthread_mutex_lock(&sim.lock);
+    drops = sim.loopback_drops;
+    pthread_mutex_unlock(&sim.lock);
+    return drops;
+}
+
+size_t qca7k_sim_rx_space(void)
+{
+    size_t space;
+
+    pthread_mutex_lock(&sim.lock);
+    space = sizeof(sim.rdbuf) - sim.rd_fill;
+    pthread_mutex_unlock(&sim.lock);
+    return space;
+}
+
+bool qca7k_sim_rx_frame(const uint8_t *frame, uint16_t len)
+{
+    bool raise = false;
+    bool ok;
+
+    pthread_mutex_lock(&sim.lock);
+    ok = qca7k_sim_rx_put(frame, len, &raise);
+    pthread_mutex_unlock(&sim.lock);
+
+    qca7k_sim_irq(raise);
+    return ok;
+}
@@ -0,0 +1,79 @@
+/*====================================================================*
+ *
+ *   qca7k_sim.h
+ *
+ *   QCA7000 SPI slave model for host builds.
+ *
+ *   Serves the register reads and writes qca_7k.c issues, hands the
+ *   frames queued with qca7k_sim_rx_frame to external reads in the
+ *   hardware format (4 byte length, QCA7k header, frame, footer) and
+ *   passes every external write burst to the TX callback, or back into
+ *   the read buffer in loopback mode. Releasing the reset pin, or a
+ *   soft reset, raises SPI_INT_CPU_ON as on the chip.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA7K_SIM_HEADER
+#define QCA7K_SIM_HEADER
+
+#include "driver/gpio.h"
+#include "driver/spi_master.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Called with the Ethernet frame of every TX burst, header and footer stripped */
+typedef void (*qca7k_sim_tx_cb_t)(void *ctx, const uint8_t *frame, size_t len);
+
+/*====================================================================*
+ *
+ *   qca7k_sim_init
+ *
+ *   Attach the model to the host SPI bus. If int_pin is not -1, the
+ *   QCA7k interrupt is raised on it whenever an enabled cause is set.
+ *   If rst_pin is not -1, the model follows it as its reset line.
+ *
+ *--------------------------------------------------------------------*/
+
+void qca7k_sim_init(gpio_num_t int_pin, gpio_num_t rst_pin);
+
+void qca7k_sim_set_tx_cb(qca7k_sim_tx_cb_t cb, void *ctx);
+
+/* Loop TX frames back into the read buffer, like a peer echoing them.
+ * Frames that do not fit are counted and dropped. */
+void qca7k_sim_set_loopback(bool loopback);
+uint32_t qca7k_sim_loopback_drops(void);
+
+/*====================================================================*
+ *
+ *   qca7k_sim_rx_frame
+ *
+ *   Queue an Ethernet frame for the host. Frames only enter the read
+ *   buffer whole, as on the chip.
+ *
+ *   Return: false if the read buffer has no room for it.
+ *
+ *--------------------------------------------------------------------*/
+
+bool qca7k_sim_rx_frame(const uint8_t *frame, uint16_t len);
+
+/* Free read buffer bytes */
+size_t qca7k_sim_rx_space(void);
+
+/*====================================================================*
+ *
+ *   qca7k_sim_glitch
+ *
+ *   Raise WRBUF_ERR, as a burst garbled on the bus would. The soft
+ *   reset the host answers with keeps the model silent for down_ms
+ *   before its CPU comes back on.
+ *
+ *--------------------------------------------------------------------*/
+
+void qca7k_sim_glitch(uint32_t down_ms);
+
+/* Cap RDBUF_BYTE_AVA at chunk bytes, so frames are read in arbitrary
+ * pieces; 0 reports the whole buffer */
+void qca7k_sim_set_chunk(uint16_t chunk);
+
+#endif
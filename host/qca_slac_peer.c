@@ -0,0 +1,210 @@
+/*====================================================================*
+ *
+ *   qca_slac_peer.c
+ *
+ *   Emulated EVSE for host builds.
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca_slac_peer.h"
+#include "byte_order.h"
+#include "esp_timer.h"
+#include "qca7k_sim.h"
+#include "qca_mme.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PEER_QUEUE 16
+
+typedef struct {
+    int64_t due;
+    uint16_t len;
+    uint8_t frame[QCAFRM_ETHMAXLEN];
+} peer_answer_t;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    qca_slac_peer_config_t cfg;
+    peer_answer_t queue[PEER_QUEUE];
+    unsigned head;
+    unsigned count;
+    uint8_t run_id[QCA_MME_RUN_ID_LEN];
+    uint8_t sounds; /* CM_MNBC_SOUND.INDs of the current run */
+    qca_slac_peer_stats_t stats;
+} peer = {.lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER};
+
+static void *peer_hdr(peer_answer_t *a, uint16_t mmtype, const uint8_t *dest, uint16_t len)
+{
+    qca_mme_av_hdr_t *av = (qca_mme_av_hdr_t *)a->frame;
+
+    /* Padded on the wire like any Ethernet frame */
+    if (len < QCAFRM_ETHMINLEN)
+        len = QCAFRM_ETHMINLEN;
+    memset(a->frame, 0, len);
+    memcpy(av->hdr.dest, dest, QCA_MME_ETH_ALEN);
+    memcpy(av->hdr.src, peer.cfg.evse_mac, QCA_MME_ETH_ALEN);
+    av->hdr.ethertype = __cpu_to_be16(QCA_MME_ETHERTYPE);
+    av->hdr.mmv       = QCA_MME_MMV_AV_1_1;
+    av->hdr.mmtype    = __cpu_to_le16(mmtype);
+    a->len            = len;
+    return a->frame;
+}
+
+/* Called with peer.lock held. Return: NULL if the queue is full. */
+static peer_answer_t *peer_alloc(void)
+{
+    peer_answer_t *a;
+
+    if (peer.count == PEER_QUEUE)
+    {
+        peer.stats.dropped++;
+        return NULL;
+    }
+    a      = &peer.queue[(peer.head + peer.count) % PEER_QUEUE];
+    a->due = esp_timer_get_time() + peer.cfg.delay_us;
+    return a;
+}
+
+static void peer_commit(void)
+{
+    peer.count++;
+    pthread_cond_signal(&peer.cond);
+}
+
+/* The model calls this from inside an SPI transfer, under its own lock */
+static void peer_tx(void *ctx, const uint8_t *frame, size_t len)
+{
+    const qca_mme_av_hdr_t *req = (const qca_mme_av_hdr_t *)frame;
+    peer_answer_t *a;
+    uint8_t i;
+
+    (void)ctx;
+    pthread_mutex_lock(&peer.lock);
+
+    switch (qca_mme_type(frame, len))
+    {
+    case QCA_MMTYPE_CM_SLAC_PARM | QCA_MMTYPE_REQ: {
+        const qca_mme_slac_parm_req_t *parm = qca_mme_parse(frame, len, QCA_MMTYPE_CM_SLAC_PARM | QCA_MMTYPE_REQ,
+                                                             sizeof(*parm));
+        if (parm == NULL || (a = peer_alloc()) == NULL)
+            break;
+
+        qca_mme_slac_parm_cnf_t *cnf =
+            peer_hdr(a, QCA_MMTYPE_CM_SLAC_PARM | QCA_MMTYPE_CNF, req->hdr.src, sizeof(*cnf));
+        memset(cnf->msound_target, 0xFF, QCA_MME_ETH_ALEN);
+        cnf->num_sounds = peer.cfg.num_sounds;
+        cnf->time_out   = 6;
+        cnf->resp_type  = 1;
+        memcpy(cnf->forwarding_sta, req->hdr.src, QCA_MME_ETH_ALEN);
+        memcpy(cnf->run_id, parm->run_id, QCA_MME_RUN_ID_LEN);
+        memcpy(peer.run_id, parm->run_id, QCA_MME_RUN_ID_LEN);
+        peer.sounds = 0;
+        peer.stats.parm++;
+        peer_commit();
+        break;
+    }
+    case QCA_MMTYPE_CM_MNBC_SOUND | QCA_MMTYPE_IND: {
+        const qca_mme_mnbc_sound_ind_t *sound = qca_mme_parse(frame, len, QCA_MMTYPE_CM_MNBC_SOUND | QCA_MMTYPE_IND,
+                                                               sizeof(*sound));
+        if (sound == NULL || memcmp(sound->run_id, peer.run_id, QCA_MME_RUN_ID_LEN) != 0)
+            break;
+
+        peer.sounds++;
+        peer.stats.sounds++;
+        if (sound->cnt != 0 || (a = peer_alloc()) == NULL)
+            break;
+
+        qca_mme_atten_char_ind_t *ind =
+            peer_hdr(a, QCA_MMTYPE_CM_ATTEN_CHAR | QCA_MMTYPE_IND, req->hdr.src, sizeof(*ind));
+        memcpy(ind->source_address, req->hdr.src, QCA_MME_ETH_ALEN);
+        memcpy(ind->run_id, peer.run_id, QCA_MME_RUN_ID_LEN);
+        ind->num_sounds = peer.sounds;
+        ind->num_groups = QCA_MME_AAG_GROUPS;
+        for (i = 0; i < QCA_MME_AAG_GROUPS; i++) ind->aag[i] = 20 + i % 16;
+        peer.stats.atten_char++;
+        peer_commit();
+        break;
+    }
+    case QCA_MMTYPE_CM_SLAC_MATCH | QCA_MMTYPE_REQ: {
+        const qca_mme_slac_match_req_t *match = qca_mme_parse(frame, len, QCA_MMTYPE_CM_SLAC_MATCH | QCA_MMTYPE_REQ,
+                                                               sizeof(*match));
+        if (match == NULL || (a = peer_alloc()) == NULL)
+            break;
+
+        qca_mme_slac_match_cnf_t *cnf =
+            peer_hdr(a, QCA_MMTYPE_CM_SLAC_MATCH | QCA_MMTYPE_CNF, req->hdr.src, sizeof(*cnf));
+        cnf->mvf_length = __cpu_to_le16(sizeof(*cnf) - offsetof(qca_mme_slac_match_cnf_t, pev_id));
+        memcpy(cnf->pev_mac, match->pev_mac, QCA_MME_ETH_ALEN);
+        memcpy(cnf->evse_mac, peer.cfg.evse_mac, QCA_MME_ETH_ALEN);
+        memcpy(cnf->run_id, match->run_id, QCA_MME_RUN_ID_LEN);
+        memset(cnf->nid, 0x42, QCA_MME_NID_LEN);
+        memset(cnf->nmk, 0x5A, QCA_MME_KEY_LEN);
+        peer.stats.match++;
+        peer_commit();
+        break;
+    }
+    default:
+        break;
+    }
+
+    pthread_mutex_unlock(&peer.lock);
+}
+
+/* Answers go into the read buffer outside the model's lock */
+static void *peer_thread(void *arg)
+{
+    peer_answer_t a;
+    int64_t wait;
+    int tries;
+
+    (void)arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&peer.lock);
+        while (peer.count == 0) pthread_cond_wait(&peer.cond, &peer.lock);
+        a = peer.queue[peer.head];
+        pthread_mutex_unlock(&peer.lock);
+
+        wait = a.due - esp_timer_get_time();
+        if (wait > 0)
+            usleep((useconds_t)wait);
+
+        for (tries = 0; !qca7k_sim_rx_frame(a.frame, a.len); tries++)
+        {
+            if (tries == 100)
+            {
+                pthread_mutex_lock(&peer.lock);
+                peer.stats.dropped++;
+                pthread_mutex_unlock(&peer.lock);
+                break;
+            }
+            usleep(1000);
+        }
+
+        pthread_mutex_lock(&peer.lock);
+        peer.head = (peer.head + 1) % PEER_QUEUE;
+        peer.count--;
+        pthread_mutex_unlock(&peer.lock);
+    }
+    return NULL;
+}
+
+void qca_slac_peer_init(const qca_slac_peer_config_t *cfg)
+{
+    pthread_t thread;
+
+    peer.cfg = *cfg;
+    qca7k_sim_set_tx_cb(peer_tx, NULL);
+    pthread_create(&thread, NULL, peer_thread, NULL);
+    pthread_detach(thread);
+}
+
+void qca_slac_peer_get_stats(qca_slac_peer_stats_t *stats)
+{
+    pthread_mutex_lock(&peer.lock);
+    *stats = peer.stats;
+    pthread_mutex_unlock(&peer.lock);
+}
@@ -0,0 +1,40 @@
+/*====================================================================*
+ *
+ *   qca_slac_peer.h
+ *
+ *   Emulated EVSE for host builds.
+ *
+ *   Answers the PEV side of SLAC behind the QCA7000 model: every frame
+ *   the driver writes is offered to the peer, which answers
+ *   CM_SLAC_PARM.REQ, sends CM_ATTEN_CHAR.IND after the last
+ *   CM_MNBC_SOUND.IND and answers CM_SLAC_MATCH.REQ. Answers are
+ *   queued into the model's read buffer from a thread of its own
+ *   after a configurable think time, as a remote station would.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA_SLAC_PEER_HEADER
+#define QCA_SLAC_PEER_HEADER
+
+#include <stdint.h>
+
+typedef struct {
+    uint8_t evse_mac[6];
+    uint8_t num_sounds;  /* Asked for in CM_SLAC_PARM.CNF */
+    uint32_t delay_us;   /* Before every answer */
+} qca_slac_peer_config_t;
+
+typedef struct {
+    uint32_t parm;
+    uint32_t sounds;
+    uint32_t atten_char;
+    uint32_t match;
+    uint32_t dropped; /* Answers that found the read buffer full */
+} qca_slac_peer_stats_t;
+
+/* Take the model's TX callback and start the answer thread */
+void qca_slac_peer_init(const qca_slac_peer_config_t *cfg);
+
+void qca_slac_peer_get_stats(qca_slac_peer_stats_t *stats);
+
+#endif
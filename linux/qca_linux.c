@@ -0,0 +1,344 @@
+/*====================================================================*
+ *
+ *   qca_linux.c
+ *
+ *   Linux userspace backend.
+ *
+ *--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include "qca_linux.h"
+#include "qca_7k.h"
+#include "qca_buf.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+#include <linux/spi/spidev.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+static const char *TAG = "qca_linux";
+
+/*====================================================================*
+ *   spidev;
+ *--------------------------------------------------------------------*/
+
+typedef struct {
+    int fd;
+    uint32_t speed_hz;
+} qca_linux_spidev_t;
+
+/* Every QCA7k transaction is a command and a data transfer under one
+ * chip select; cs_change on the last piece of all but the final
+ * transaction releases chip select between them */
+static esp_err_t qca_linux_spidev_xfer(void *ctx, const qca_bus_xfer_t *xfers, size_t n)
+{
+    qca_linux_spidev_t *dev = ctx;
+    struct spi_ioc_transfer tr[2 * QCA_BUS_MAX_BATCH];
+    uint8_t cmd[QCA_BUS_MAX_BATCH][2];
+    size_t i, k = 0;
+
+    if (n > QCA_BUS_MAX_BATCH)
+        return ESP_ERR_INVALID_SIZE;
+
+    memset(tr, 0, sizeof(tr));
+    for (i = 0; i < n; i++)
+    {
+        cmd[i][0] = xfers[i].cmd >> 8;
+        cmd[i][1] = xfers[i].cmd & 0xFF;
+
+        tr[k].tx_buf   = (uintptr_t)cmd[i];
+        tr[k].len      = 2;
+        tr[k].speed_hz = dev->speed_hz;
+        k++;
+
+        if (xfers[i].len)
+        {
+            tr[k].tx_buf   = (uintptr_t)xfers[i].tx;
+            tr[k].rx_buf   = (uintptr_t)xfers[i].rx;
+            tr[k].len      = xfers[i].len;
+            tr[k].speed_hz = dev->speed_hz;
+            k++;
+        }
+
+        if (i + 1 < n)
+            tr[k - 1].cs_change = 1;
+    }
+
+    if (ioctl(dev->fd, SPI_IOC_MESSAGE(k), tr) < 0)
+    {
+        ESP_LOGE(TAG, "SPI_IOC_MESSAGE: %s", strerror(errno));
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t qca_linux_spidev_open(const char *path, uint32_t speed_hz, qca_bus_t *bus)
+{
+    qca_linux_spidev_t *dev;
+    uint8_t mode = SPI_MODE_3;
+    uint8_t bits = 8;
+    int fd;
+
+    fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        return ESP_FAIL;
+
+    if (ioctl(fd, SPI_IOC_WR_MODE, &mode) < 0 || ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0
+        || ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed_hz) < 0 || (dev = calloc(1, sizeof(*dev))) == NULL)
+    {
+        close(fd);
+        return ESP_FAIL;
+    }
+
+    dev->fd       = fd;
+    dev->speed_hz = speed_hz;
+    bus->xfer     = qca_linux_spidev_xfer;
+    bus->ctx      = dev;
+    return ESP_OK;
+}
+
+/*====================================================================*
+ *   gpio;
+ *--------------------------------------------------------------------*/
+
+static int qca_linux_gpio_chip(const char *chip)
+{
+    char path[64];
+
+    if (strchr(chip, '/') != NULL)
+        return open(chip, O_RDWR | O_CLOEXEC);
+
+    snprintf(path, sizeof(path), "/dev/%s", chip);
+    return open(path, O_RDWR | O_CLOEXEC);
+}
+
+int qca_linux_gpio_irq(const char *chip, unsigned line)
+{
+    struct gpioevent_request req = {0};
+    int fd = qca_linux_gpio_chip(chip);
+
+    if (fd < 0)
+        return -1;
+
+    req.lineoffset  = line;
+    req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    req.eventflags  = GPIOEVENT_REQUEST_RISING_EDGE;
+    strncpy(req.consumer_label, "qca7000-int", sizeof(req.consumer_label) - 1);
+
+    if (ioctl(fd, GPIO_GET_LINEEVENT_IOCTL, &req) < 0)
+        req.fd = -1;
+    close(fd);
+    return req.fd;
+}
+
+int qca_linux_gpio_out(const char *chip, unsigned line, int value)
+{
+    struct gpiohandle_request req = {0};
+    int fd = qca_linux_gpio_chip(chip);
+
+    if (fd < 0)
+        return -1;
+
+    req.lineoffsets[0]    = line;
+    req.lines             = 1;
+    req.flags             = GPIOHANDLE_REQUEST_OUTPUT;
+    req.default_values[0] = value;
+    strncpy(req.consumer_label, "qca7000-rst", sizeof(req.consumer_label) - 1);
+
+    if (ioctl(fd, GPIO_GET_LINEHANDLE_IOCTL, &req) < 0)
+        req.fd = -1;
+    close(fd);
+    return req.fd;
+}
+
+esp_err_t qca_linux_gpio_set(int fd, int value)
+{
+    struct gpiohandle_data data = {.values = {value}};
+
+    return ioctl(fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) < 0 ? ESP_FAIL : ESP_OK;
+}
+
+/*====================================================================*
+ *   tap;
+ *--------------------------------------------------------------------*/
+
+int qca_linux_tap_open(const char *name)
+{
+    struct ifreq ifr = {0};
+    int fd;
+
+    fd = open("/dev/net/tun", O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+    strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+    if (ioctl(fd, TUNSETIFF, &ifr) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*====================================================================*
+ *   event loop;
+ *--------------------------------------------------------------------*/
+
+esp_err_t qca_linux_init(qcaspi_t *qca, const qca_bus_t *bus)
+{
+    qca->bus    = *bus;
+    qca->sync   = QCASPI_SYNC_UNKNOWN;
+    qca->events = xEventGroupCreate();
+    if (qca->events == NULL || !qca_ring_init(&qca->txRing, QCASPI_TX_RING_DEPTH)
+        || !qca_ring_init(&qca->rxRing, QCASPI_RX_RING_DEPTH))
+        return ESP_ERR_NO_MEM;
+#if QCASPI_TX_MULTI_PRODUCER
+    portMUX_INITIALIZE(&qca->tx_lock);
+#endif
+    portMUX_INITIALIZE(&qca->irq_lock);
+    QcaFrmFsmInitSpi(&qca->lFrmHdl);
+    return ESP_OK;
+}
+
+/* Frames from frame_fd into the TX ring, straight into the descriptor
+ * buffer behind the QCA7k header. Return: false once the ring is full. */
+static bool qca_linux_frames_in(qcaspi_t *qca, int frame_fd)
+{
+    NetworkBufferDescriptor_t *txDesc;
+    ssize_t len;
+
+    while (qca_ring_free(&qca->txRing) > 0)
+    {
+        txDesc = calloc(1, sizeof(NetworkBufferDescriptor_t));
+        if (txDesc == NULL || (txDesc->pucEthernetBuffer = malloc(QCA_TX_BUF_SIZE(QCAFRM_ETHMAXLEN))) == NULL)
+        {
+            free(txDesc);
+            qca->stats.tx_errors++;
+            return true;
+        }
+
+        len = read(frame_fd, txDesc->pucEthernetBuffer + QCAFRM_HEADER_LEN, QCAFRM_ETHMAXLEN);
+        if (len < ETH_HLEN)
+        {
+            if (len >= 0)
+                qca->stats.tx_errors++;
+            qca_free_desc(txDesc);
+            if (len < 0)
+                return true;
+            continue;
+        }
+
+        /* qcaspi_tx_frame pads and frames it, see QcaFrmEncapsulate */
+        txDesc->xDataLength = len;
+        txDesc->xEntryTime  = esp_timer_get_time();
+        qca_ring_push(&qca->txRing, txDesc, NULL);
+    }
+    return false;
+}
+
+/* Received frames from the RX ring to frame_fd */
+static void qca_linux_frames_out(qcaspi_t *qca, int frame_fd)
+{
+    NetworkBufferDescriptor_t *rxDesc;
+
+    while ((rxDesc = qca_ring_pop(&qca->rxRing)) != NULL)
+    {
+        /* A full socket or TAP queue drops, as a full RX ring does */
+        if (write(frame_fd, rxDesc->pucEthernetBuffer, rxDesc->xDataLength) < 0)
+            qca->stats.rx_dropped++;
+        qca_free_desc(rxDesc);
+    }
+}
+
+int qca_linux_run(qcaspi_t *qca, int irq_fd, int frame_fd, volatile sig_atomic_t *stop)
+{
+    struct epoll_event ev, events[2];
+    uint8_t drain[64];
+    bool frames_in = true;
+    uint32_t notification;
+    int epfd, n, i, timeout;
+
+    fcntl(irq_fd, F_SETFL, fcntl(irq_fd, F_GETFL) | O_NONBLOCK);
+    fcntl(frame_fd, F_SETFL, fcntl(frame_fd, F_GETFL) | O_NONBLOCK);
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0)
+        return -1;
+
+    ev.events  = EPOLLIN;
+    ev.data.fd = irq_fd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, irq_fd, &ev) < 0)
+        goto fail;
+    ev.data.fd = frame_fd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, frame_fd, &ev) < 0)
+        goto fail;
+
+    qca->last_sync_check = xTaskGetTickCount();
+
+    while (!*stop)
+    {
+        /* Take frames again once the TX ring has room */
+        if (!frames_in && qca_ring_free(&qca->txRing) > 0)
+        {
+            ev.events  = EPOLLIN;
+            ev.data.fd = frame_fd;
+            epoll_ctl(epfd, EPOLL_CTL_MOD, frame_fd, &ev);
+            frames_in = true;
+        }
+
+        timeout = (int)(qcaspi_wait_ticks(qca) * portTICK_PERIOD_MS);
+        n       = epoll_wait(epfd, events, 2, timeout);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            goto fail;
+        }
+
+        notification = 0;
+        for (i = 0; i < n; i++)
+        {
+            if (events[i].data.fd == irq_fd)
+            {
+                /* GPIO line events and eventfd counters alike */
+                while (read(irq_fd, drain, sizeof(drain)) > 0) continue;
+                qca->irq_time = esp_timer_get_time();
+                notification |= QCAGP_INT_FLAG;
+            }
+            else if (!qca_linux_frames_in(qca, frame_fd))
+            {
+                /* Ring full: stop polling frame_fd, or the loop would spin */
+                ev.events  = 0;
+                ev.data.fd = frame_fd;
+                epoll_ctl(epfd, EPOLL_CTL_MOD, frame_fd, &ev);
+                frames_in = false;
+                notification |= QCAGP_TX_FLAG;
+            }
+            else
+            {
+                notification |= QCAGP_TX_FLAG;
+            }
+        }
+
+        qcaspi_service(qca, notification);
+        qca_linux_frames_out(qca, frame_fd);
+    }
+
+    close(epfd);
+    return 0;
+
+fail:
+    ESP_LOGE(TAG, "epoll: %s", strerror(errno));
+    close(epfd);
+    return -1;
+}
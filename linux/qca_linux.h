@@ -0,0 +1,66 @@
+/*====================================================================*
+ *
+ *   qca_linux.h
+ *
+ *   Linux userspace backend.
+ *
+ *   Runs the unmodified qca_spi.c and qca_7k.c in one thread around a
+ *   single epoll loop: SPI through /dev/spidev with every bus batch in
+ *   one SPI_IOC_MESSAGE ioctl, the QCA7000 interrupt as a GPIO line
+ *   event fd, and frames to and from a file descriptor that carries
+ *   one Ethernet frame per read and write, a TAP device or one end of
+ *   a SOCK_SEQPACKET socketpair.
+ *
+ *   Built against the host port (host/include), which provides the
+ *   FreeRTOS and ESP-IDF types the driver uses; no tasks are started.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA_LINUX_HEADER
+#define QCA_LINUX_HEADER
+
+#include "qca_spi.h"
+#include <signal.h>
+
+/*====================================================================*
+ *
+ *   qca_linux_spidev_open
+ *
+ *   Open a spidev node in mode 3, 8 bit words, at speed_hz and fill
+ *   bus with its transport.
+ *
+ *   Return: ESP_FAIL with errno set.
+ *
+ *--------------------------------------------------------------------*/
+
+esp_err_t qca_linux_spidev_open(const char *path, uint32_t speed_hz, qca_bus_t *bus);
+
+/* Rising edge events of a GPIO line as a readable fd, -1 with errno set */
+int qca_linux_gpio_irq(const char *chip, unsigned line);
+
+/* A GPIO line as output at value, -1 with errno set */
+int qca_linux_gpio_out(const char *chip, unsigned line, int value);
+esp_err_t qca_linux_gpio_set(int fd, int value);
+
+/* A TAP interface without packet info header, -1 with errno set */
+int qca_linux_tap_open(const char *name);
+
+/* Prepare qca for qca_linux_run: rings, framing and the given bus */
+esp_err_t qca_linux_init(qcaspi_t *qca, const qca_bus_t *bus);
+
+/*====================================================================*
+ *
+ *   qca_linux_run
+ *
+ *   Serve the QCA7000 until *stop is set. irq_fd becomes readable on
+ *   every interrupt (a GPIO line event fd or an eventfd), frame_fd
+ *   takes and gives one Ethernet frame per read and write. Both are
+ *   switched to non-blocking.
+ *
+ *   Return: 0 on stop, -1 with errno set on an epoll failure.
+ *
+ *--------------------------------------------------------------------*/
+
+int qca_linux_run(qcaspi_t *qca, int irq_fd, int frame_fd, volatile sig_atomic_t *stop);
+
+#endif
@@ -38,58 +38,121 @@
 #include "qca_7k.h"
 #include "byte_order.h"
 
-uint16_t qcaspi_read_register(qcaspi_t *qca, uint16_t reg)
+#define QCA7K_REG_INDEX(reg) ((reg) >> 8)
+
+_Static_assert(QCA7K_REG_INDEX(SPI_REG_ACTION_CTRL) < QCASPI_REGS, "QCASPI_REGS too small");
+
+static uint16_t QCA_IRAM_ATTR qcaspi_read_register_spi(qcaspi_t *qca, uint16_t reg)
 {
-    uint16_t rx_data[1] = {0};
+    uint16_t rx_data = 0;
+
+    qca_bus_xfer_t x = {.cmd = QCA7K_SPI_READ | QCA7K_SPI_INTERNAL | reg, .rx = &rx_data, .len = 2};
+
+    esp_err_t err = qca->bus.xfer(qca->bus.ctx, &x, 1);
+    ESP_ERROR_CHECK(err);
 
-    spi_transaction_t t = {0};
+    return __be16_to_cpu(rx_data);
+}
+
+static void QCA_IRAM_ATTR qcaspi_write_register_spi(qcaspi_t *qca, uint16_t reg, uint16_t value)
+{
+    uint16_t tx_data = __cpu_to_be16(value);
 
-    t.cmd       = (QCA7K_SPI_READ | QCA7K_SPI_INTERNAL | reg);
-    t.length    = 0;
-    t.tx_buffer = NULL;
-    t.rxlength  = 16;
-    t.rx_buffer = rx_data;
+    qca_bus_xfer_t x = {.cmd = QCA7K_SPI_WRITE | QCA7K_SPI_INTERNAL | reg, .tx = &tx_data, .len = 2};
 
-    esp_err_t err = spi_device_transmit(qca->handle, &t);
+    esp_err_t err = qca->bus.xfer(qca->bus.ctx, &x, 1);
     ESP_ERROR_CHECK(err);
+}
+
+/*====================================================================*
+ *
+ *   qcaspi_read_register
+ *
+ *   Read a register from the chip. Nothing is served from a shadow:
+ *   SPI_STATUS shares its address with SPI_CONFIG, so a cached value
+ *   at that address could be either.
+ *
+ *--------------------------------------------------------------------*/
 
-    // ESP_LOGI("qcaspi_read_reg", "CMD:%04X Value:%04X", t.cmd, rx_data[0]);
+uint16_t QCA_IRAM_ATTR qcaspi_read_register(qcaspi_t *qca, uint16_t reg)
+{
+    uint16_t value = qcaspi_read_register_spi(qca, reg);
+
+    qca->regs.stats[QCA7K_REG_INDEX(reg)].reads++;
+
+    if (reg == SPI_REG_WRBUF_SPC_AVA)
+        qca->regs.wrbuf_space = value;
 
-    return __be16_to_cpu(rx_data[0]);
+    return value;
 }
 
-void qcaspi_write_register(qcaspi_t *qca, uint16_t reg, uint16_t value)
+/*====================================================================*
+ *
+ *   qcaspi_write_register
+ *
+ *   Write a register. Writing 0 to the write-one-to-clear INTR_CAUSE
+ *   changes nothing and is skipped. Setting QCASPI_SLAVE_RESET_BIT
+ *   resets the chip and with it the write buffer estimate.
+ *
+ *--------------------------------------------------------------------*/
+
+void QCA_IRAM_ATTR qcaspi_write_register(qcaspi_t *qca, uint16_t reg, uint16_t value)
 {
-    uint16_t tx_cmd = __cpu_to_be16(value);
+    uint16_t i = QCA7K_REG_INDEX(reg);
 
-    spi_transaction_t t = {0};
+    if (QCASPI_REG_SHADOW && reg == SPI_REG_INTR_CAUSE && value == 0)
+    {
+        qca->regs.stats[i].writes_elided++;
+        return;
+    }
 
-    t.cmd       = (QCA7K_SPI_WRITE | QCA7K_SPI_INTERNAL | reg);
-    t.length    = 16;
-    t.tx_buffer = &tx_cmd;
-    t.rxlength  = 0;
-    t.rx_buffer = NULL;
+    qcaspi_write_register_spi(qca, reg, value);
+    qca->regs.stats[i].writes++;
 
-    esp_err_t err = spi_device_transmit(qca->handle, &t);
-    ESP_ERROR_CHECK(err);
+    if (reg == SPI_REG_SPI_CONFIG && (value & QCASPI_SLAVE_RESET_BIT))
+        qcaspi_invalidate_registers(qca);
+}
+
+/* The QCA7k restarted or may have: forget the write buffer estimate */
+void qcaspi_invalidate_registers(qcaspi_t *qca)
+{
+    qca->regs.wrbuf_space = 0;
+}
+
+/*====================================================================*
+ *
+ *   qcaspi_wrbuf_space
+ *
+ *   Free bytes in the QCA7k write buffer. The chip only ever frees
+ *   space, so the last read less the bursts written since is a lower
+ *   bound; SPI_REG_WRBUF_SPC_AVA is only read when that bound does not
+ *   cover needed.
+ *
+ *--------------------------------------------------------------------*/
 
-    // ESP_LOGI("qcaspi_write_reg", "CMD:%04X Value:%04X", t.cmd, tx_cmd);
+uint16_t QCA_IRAM_ATTR qcaspi_wrbuf_space(qcaspi_t *qca, uint16_t needed)
+{
+    if (QCASPI_REG_SHADOW && qca->regs.wrbuf_space >= needed)
+    {
+        qca->regs.stats[QCA7K_REG_INDEX(SPI_REG_WRBUF_SPC_AVA)].reads_elided++;
+        return qca->regs.wrbuf_space;
+    }
+
+    return qcaspi_read_register(qca, SPI_REG_WRBUF_SPC_AVA);
 }
 
-int qcaspi_tx_cmd(qcaspi_t *qca, uint16_t cmd)
+/* A burst of len bytes went into the write buffer */
+void QCA_IRAM_ATTR qcaspi_wrbuf_consume(qcaspi_t *qca, uint16_t len)
 {
-    spi_transaction_t t = {0};
+    qca->regs.wrbuf_space = (qca->regs.wrbuf_space > len) ? qca->regs.wrbuf_space - len : 0;
+}
 
-    t.cmd       = cmd;
-    t.length    = 0;
-    t.tx_buffer = NULL;
-    t.rxlength  = 0;
-    t.rx_buffer = NULL;
+int QCA_IRAM_ATTR qcaspi_tx_cmd(qcaspi_t *qca, uint16_t cmd)
+{
+    qca_bus_xfer_t x = {.cmd = cmd};
 
-    esp_err_t err = spi_device_transmit(qca->handle, &t);
+    esp_err_t err = qca->bus.xfer(qca->bus.ctx, &x, 1);
     ESP_ERROR_CHECK(err);
 
-    // ESP_LOG_BUFFER_HEX("qcaspi_cmd_tx", &cmd, 2);
-
     return 0;
 }
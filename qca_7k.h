@@ -74,6 +74,9 @@
 
 uint16_t qcaspi_read_register(qcaspi_t *qca, uint16_t reg);
 void qcaspi_write_register(qcaspi_t *qca, uint16_t reg, uint16_t value);
+void qcaspi_invalidate_registers(qcaspi_t *qca);
+uint16_t qcaspi_wrbuf_space(qcaspi_t *qca, uint16_t needed);
+void qcaspi_wrbuf_consume(qcaspi_t *qca, uint16_t len);
 int qcaspi_tx_cmd(qcaspi_t *qca, uint16_t cmd);
 
 #endif
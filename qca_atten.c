@@ -0,0 +1,407 @@
+/*====================================================================*
+ *
+ *   qca_atten.c
+ *
+ *   SLAC attenuation profile aggregation for the EVSE side.
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca_atten.h"
+#include "byte_order.h"
+#include "qca_driver.h"
+#include <string.h>
+
+/* 32 bit words holding the AAG groups of a profile, four to a word */
+#define QCA_ATTEN_WORDS ((QCA_MME_AAG_GROUPS + 3) / 4)
+
+/* The even and odd bytes of a word, each in a 16 bit lane */
+#define QCA_ATTEN_LANES 0x00FF00FFu
+
+typedef struct {
+    bool used;
+    bool closed; /* Window over, late sounds of the run are not counted again */
+    uint8_t pev_mac[QCA_MME_ETH_ALEN];
+    uint8_t run_id[QCA_MME_RUN_ID_LEN];
+    uint16_t expected; /* Sounds of the PEV, up to 256 from a CM_MNBC_SOUND.IND cnt; 0 if unknown */
+    uint8_t received;  /* Profiles added, the session closes at UINT8_MAX */
+    int64_t deadline;
+
+    /* sum[0][i] holds groups 4i and 4i+2, sum[1][i] groups 4i+1 and
+     * 4i+3; UINT8_MAX profiles of 255 dB still fit a lane */
+    uint32_t sum[2][QCA_ATTEN_WORDS];
+} qca_atten_session_t;
+
+static struct {
+    volatile bool running; /* Written under atten_lock */
+    bool hooked; /* qca_atten_rx is in the RX hook chain */
+    uint8_t local_mac[QCA_MME_ETH_ALEN];
+    qca_atten_cb_t cb;
+    void *ctx;
+    qca_rx_hook_t next_hook;
+    esp_timer_handle_t timer;
+    bool timer_running; /* Armed, or its callback is running */
+    uint32_t open;
+    uint32_t calls; /* Callbacks decided under atten_lock and not yet returned */
+    qca_atten_session_t sessions[QCA_ATTEN_SESSIONS];
+    qca_atten_stats_t stats;
+} atten;
+
+static portMUX_TYPE atten_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Caller holds atten_lock */
+static qca_atten_session_t *qca_atten_find(const uint8_t *pev_mac)
+{
+    int i;
+
+    for (i = 0; i < QCA_ATTEN_SESSIONS; i++)
+        if (atten.sessions[i].used && memcmp(atten.sessions[i].pev_mac, pev_mac, QCA_MME_ETH_ALEN) == 0)
+            return &atten.sessions[i];
+    return NULL;
+}
+
+/*====================================================================*
+ *
+ *   qca_atten_open
+ *
+ *   Start a session for the sounds of pev_mac in run run_id, or keep
+ *   the one already open for that run. A new RunID from the same PEV
+ *   starts over. Caller holds atten_lock.
+ *
+ *   Return: the session, NULL if the table is full, the window of the
+ *   run is already closed or the aggregator is stopped.
+ *
+ *--------------------------------------------------------------------*/
+
+static qca_atten_session_t *qca_atten_open(const uint8_t *pev_mac, const uint8_t *run_id, uint16_t expected,
+                                           uint32_t timeout_ms, bool *arm)
+{
+    qca_atten_session_t *s = NULL;
+    int i;
+
+    /* Checked under the lock, so nothing arms the timer after qca_atten_deinit */
+    if (!atten.running)
+        return NULL;
+
+    /* The PEV's last session, open or closed, is reused for its next run */
+    for (i = 0; i < QCA_ATTEN_SESSIONS && s == NULL; i++)
+        if ((atten.sessions[i].used || atten.sessions[i].closed)
+            && memcmp(atten.sessions[i].pev_mac, pev_mac, QCA_MME_ETH_ALEN) == 0)
+            s = &atten.sessions[i];
+
+    if (s != NULL && memcmp(s->run_id, run_id, QCA_MME_RUN_ID_LEN) == 0)
+        return s->used ? s : NULL;
+
+    for (i = 0; i < QCA_ATTEN_SESSIONS && s == NULL; i++)
+        if (!atten.sessions[i].used)
+            s = &atten.sessions[i];
+
+    if (s == NULL)
+    {
+        atten.stats.table_full++;
+        return NULL;
+    }
+
+    if (!s->used)
+        atten.open++;
+
+    memset(s, 0, sizeof(*s));
+    s->used     = true;
+    s->expected = expected;
+    s->deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    memcpy(s->pev_mac, pev_mac, QCA_MME_ETH_ALEN);
+    memcpy(s->run_id, run_id, QCA_MME_RUN_ID_LEN);
+    atten.stats.sessions++;
+
+    /* Armed by the caller after the lock; only the one that finds the
+     * timer idle arms it, see qca_atten_tick */
+    if (!atten.timer_running)
+    {
+        atten.timer_running = true;
+        *arm                = true;
+    }
+    return s;
+}
+
+/* Caller holds atten_lock */
+static void qca_atten_close(qca_atten_session_t *s)
+{
+    s->used   = false;
+    s->closed = true;
+    atten.open--;
+}
+
+/* Add one profile's groups, four per word; groups past num_groups add 0 */
+static void QCA_IRAM_ATTR qca_atten_add(qca_atten_session_t *s, const uint8_t *aag, uint8_t num_groups)
+{
+    uint32_t w[QCA_ATTEN_WORDS] = {0};
+    int i;
+
+    /* The AAG field is unaligned in the packed MME */
+    memcpy(w, aag, (num_groups < QCA_MME_AAG_GROUPS) ? num_groups : QCA_MME_AAG_GROUPS);
+
+    for (i = 0; i < QCA_ATTEN_WORDS; i++)
+    {
+        s->sum[0][i] += w[i] & QCA_ATTEN_LANES;
+        s->sum[1][i] += (w[i] >> 8) & QCA_ATTEN_LANES;
+    }
+    s->received++;
+}
+
+/* Build the CM_ATTEN_CHAR.IND of a closed session, averages rounded */
+static void qca_atten_result(const qca_atten_session_t *s, qca_mme_atten_char_ind_t *ind)
+{
+    uint32_t sum;
+    int g;
+
+    memset(ind, 0, sizeof(*ind));
+    memcpy(ind->av.hdr.dest, s->pev_mac, QCA_MME_ETH_ALEN);
+    memcpy(ind->av.hdr.src, atten.local_mac, QCA_MME_ETH_ALEN);
+    ind->av.hdr.ethertype = __cpu_to_be16(QCA_MME_ETHERTYPE);
+    ind->av.hdr.mmv       = QCA_MME_MMV_AV_1_1;
+    ind->av.hdr.mmtype    = __cpu_to_le16(QCA_MMTYPE_CM_ATTEN_CHAR | QCA_MMTYPE_IND);
+
+    memcpy(ind->source_address, s->pev_mac, QCA_MME_ETH_ALEN);
+    memcpy(ind->run_id, s->run_id, QCA_MME_RUN_ID_LEN);
+    ind->num_sounds = s->received;
+    ind->num_groups = QCA_MME_AAG_GROUPS;
+
+    if (s->received == 0)
+        return;
+
+    /* Group g sits in byte g % 4 of word g / 4: odd bytes in sum[1],
+     * the upper two in the upper lane */
+    for (g = 0; g < QCA_MME_AAG_GROUPS; g++)
+    {
+        sum         = (s->sum[g & 1][g / 4] >> ((g & 2) * 8)) & 0xFFFF;
+        ind->aag[g] = (uint8_t)((sum + s->received / 2) / s->received);
+    }
+}
+
+static void qca_atten_tick(void *arg)
+{
+    qca_atten_session_t expired[QCA_ATTEN_SESSIONS];
+    qca_mme_atten_char_ind_t ind;
+    int64_t now = esp_timer_get_time();
+    int n       = 0;
+    int i;
+    bool rearm;
+
+    portENTER_CRITICAL(&atten_lock);
+    for (i = 0; i < QCA_ATTEN_SESSIONS; i++)
+    {
+        if (atten.sessions[i].used && now >= atten.sessions[i].deadline)
+        {
+            expired[n++] = atten.sessions[i];
+            qca_atten_close(&atten.sessions[i]);
+        }
+    }
+    atten.stats.timeouts += n;
+    atten.calls += n;
+
+    /* Lapses once no session is open, or after qca_atten_deinit, which
+     * closes them all. Until armed again, timer_running keeps
+     * qca_atten_open from arming it too. */
+    rearm               = atten.running && atten.open > 0;
+    atten.timer_running = rearm;
+    portEXIT_CRITICAL(&atten_lock);
+
+    if (rearm)
+        esp_timer_start_once(atten.timer, QCA_ATTEN_TICK_MS * 1000);
+
+    /* Callbacks run unlocked, qca_atten_deinit waits for them */
+    for (i = 0; i < n; i++)
+    {
+        qca_atten_result(&expired[i], &ind);
+        atten.cb(atten.ctx, &ind);
+    }
+
+    if (n > 0)
+    {
+        portENTER_CRITICAL(&atten_lock);
+        atten.calls -= n;
+        portEXIT_CRITICAL(&atten_lock);
+    }
+}
+
+static bool QCA_IRAM_ATTR qca_atten_rx(NetworkBufferDescriptor_t *rxDesc)
+{
+    const uint8_t *frame = rxDesc->pucEthernetBuffer;
+    size_t len           = rxDesc->xDataLength;
+    uint16_t mmtype      = qca_mme_type(frame, len);
+    const qca_mme_start_atten_char_ind_t *start;
+    const qca_mme_mnbc_sound_ind_t *sound;
+    const qca_mme_atten_profile_ind_t *profile;
+    qca_atten_session_t *s, done;
+    qca_mme_atten_char_ind_t ind;
+    bool consumed = false, complete = false, arm = false;
+
+    /* Left in the chain by a deinit out of order */
+    if (!atten.running)
+        return atten.next_hook != NULL && atten.next_hook(rxDesc);
+
+    switch (mmtype)
+    {
+    case QCA_MMTYPE_CM_START_ATTEN_CHAR | QCA_MMTYPE_IND:
+        start = qca_mme_parse(frame, len, mmtype, sizeof(*start));
+        if (start == NULL)
+            break;
+        portENTER_CRITICAL(&atten_lock);
+        qca_atten_open(start->av.hdr.src, start->run_id, start->num_sounds,
+                       start->time_out ? start->time_out * 100 : QCA_ATTEN_TIMEOUT_MS, &arm);
+        portEXIT_CRITICAL(&atten_lock);
+        break;
+
+    case QCA_MMTYPE_CM_MNBC_SOUND | QCA_MMTYPE_IND:
+        sound = qca_mme_parse(frame, len, mmtype, sizeof(*sound));
+        if (sound == NULL)
+            break;
+        /* Without a START_ATTEN_CHAR, the countdown of the first sound heard tells how many are left */
+        portENTER_CRITICAL(&atten_lock);
+        consumed = qca_atten_open(sound->av.hdr.src, sound->run_id, (uint16_t)sound->cnt + 1, QCA_ATTEN_TIMEOUT_MS,
+                                  &arm)
+                   != NULL;
+        portEXIT_CRITICAL(&atten_lock);
+        break;
+
+    case QCA_MMTYPE_CM_ATTEN_PROFILE | QCA_MMTYPE_IND:
+        profile = qca_mme_parse(frame, len, mmtype, sizeof(*profile));
+        if (profile == NULL)
+            break;
+        portENTER_CRITICAL(&atten_lock);
+        if ((s = qca_atten_find(profile->pev_mac)) != NULL)
+        {
+            qca_atten_add(s, profile->aag, profile->num_groups);
+            atten.stats.profiles++;
+            consumed = true;
+            /* One more would overflow received and the sum lanes */
+            if ((s->expected != 0 && s->received >= s->expected) || s->received == UINT8_MAX)
+            {
+                done     = *s;
+                complete = true;
+                qca_atten_close(s);
+                atten.stats.complete++;
+                atten.calls++;
+            }
+        }
+        else
+        {
+            atten.stats.unmatched++;
+        }
+        portEXIT_CRITICAL(&atten_lock);
+        break;
+
+    default:
+        break;
+    }
+
+    if (arm)
+        esp_timer_start_once(atten.timer, QCA_ATTEN_TICK_MS * 1000);
+
+    if (complete)
+    {
+        qca_atten_result(&done, &ind);
+        atten.cb(atten.ctx, &ind);
+
+        portENTER_CRITICAL(&atten_lock);
+        atten.calls--;
+        portEXIT_CRITICAL(&atten_lock);
+    }
+
+    if (consumed)
+    {
+        qca_free_desc(rxDesc);
+        return true;
+    }
+    return atten.next_hook != NULL && atten.next_hook(rxDesc);
+}
+
+esp_err_t qca_atten_init(const uint8_t *local_mac, qca_atten_cb_t cb, void *ctx)
+{
+    const esp_timer_create_args_t args = {
+        .callback        = qca_atten_tick,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name            = "qca_atten",
+    };
+    esp_err_t err;
+
+    if (cb == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if (atten.running)
+        return ESP_ERR_INVALID_STATE;
+
+    /* Created once and never deleted: a tick or frame that decided to
+     * arm it before qca_atten_deinit may still start it afterwards */
+    if (atten.timer == NULL)
+    {
+        err = esp_timer_create(&args, &atten.timer);
+        if (err != ESP_OK)
+            return err;
+    }
+
+    portENTER_CRITICAL(&atten_lock);
+    memset(atten.sessions, 0, sizeof(atten.sessions));
+    memset(&atten.stats, 0, sizeof(atten.stats));
+    memcpy(atten.local_mac, local_mac, QCA_MME_ETH_ALEN);
+    atten.cb            = cb;
+    atten.ctx           = ctx;
+    atten.open          = 0;
+    atten.timer_running = false;
+    atten.running       = true;
+    portEXIT_CRITICAL(&atten_lock);
+
+    /* Still chained after a deinit out of order */
+    if (!atten.hooked)
+    {
+        atten.next_hook = qca.rx_hook;
+        qca.rx_hook     = qca_atten_rx;
+        atten.hooked    = true;
+    }
+
+    return ESP_OK;
+}
+
+void qca_atten_deinit(void)
+{
+    if (!atten.running)
+        return;
+
+    /* A hook installed later chains to ours, leave it in place */
+    if (qca.rx_hook == qca_atten_rx)
+    {
+        qca.rx_hook  = atten.next_hook;
+        atten.hooked = false;
+    }
+
+    /* With no session open and running cleared, no further tick or
+     * frame decides to arm the timer or to call cb */
+    portENTER_CRITICAL(&atten_lock);
+    atten.running       = false;
+    atten.timer_running = false;
+    atten.open          = 0;
+    memset(atten.sessions, 0, sizeof(atten.sessions));
+    portEXIT_CRITICAL(&atten_lock);
+
+    /* Disarm it if the last tick left it armed. One started in the
+     * window after this finds nothing open and lapses. */
+    esp_timer_stop(atten.timer);
+
+    /* Wait for callbacks decided before the lock above */
+    for (;;)
+    {
+        bool idle;
+
+        portENTER_CRITICAL(&atten_lock);
+        idle = atten.calls == 0;
+        portEXIT_CRITICAL(&atten_lock);
+        if (idle)
+            break;
+        vTaskDelay(1);
+    }
+}
+
+void qca_atten_get_stats(qca_atten_stats_t *stats)
+{
+    portENTER_CRITICAL(&atten_lock);
+    *stats = atten.stats;
+    portEXIT_CRITICAL(&atten_lock);
+}
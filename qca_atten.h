@@ -0,0 +1,86 @@
+/*====================================================================*
+ *
+ *   qca_atten.h
+ *
+ *   SLAC attenuation profile aggregation for the EVSE side.
+ *
+ *   During sounding every PEV sends CM_START_ATTEN_CHAR.IND and then
+ *   num_sounds CM_MNBC_SOUND.IND, and the local QCA7000 answers each
+ *   sound it heard with a CM_ATTEN_PROFILE.IND carrying 58 group
+ *   attenuations. Hooked into the RX path, the aggregator opens a
+ *   session per PEV MAC and RunID on the START_ATTEN_CHAR, adds up the
+ *   profiles in the SPI thread as they arrive and drops them and the
+ *   sounds instead of queueing them. When the last sound is in, or
+ *   time_out has passed, the averages come out as a finished
+ *   CM_ATTEN_CHAR.IND for the PEV.
+ *
+ *   Sums are kept in 16 bit lanes, two to a 32 bit word, and a profile
+ *   is added four groups per word load: 30 word adds rather than 58
+ *   byte loads and adds.
+ *
+ *   CM_START_ATTEN_CHAR.IND is still passed on to qca_recv.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA_ATTEN_HEADER
+#define QCA_ATTEN_HEADER
+
+#include "qca_mme.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* PEVs sounding at once */
+#ifndef QCA_ATTEN_SESSIONS
+#define QCA_ATTEN_SESSIONS 4
+#endif
+
+/* Window for sounds without a CM_START_ATTEN_CHAR.IND before them */
+#ifndef QCA_ATTEN_TIMEOUT_MS
+#define QCA_ATTEN_TIMEOUT_MS 600
+#endif
+
+/* Window close check interval while sessions are open */
+#ifndef QCA_ATTEN_TICK_MS
+#define QCA_ATTEN_TICK_MS 10
+#endif
+
+/*--------------------------------------------------------------------*
+ *   Called from the SPI thread once the last sound is in, or from the
+ *   esp_timer task when the window closes short. ind is the finished
+ *   CM_ATTEN_CHAR.IND to the PEV, valid during the call: num_sounds
+ *   holds the profiles averaged, 0 if none arrived. Copy it out to the
+ *   task that sends it rather than sending from here.
+ *--------------------------------------------------------------------*/
+
+typedef void (*qca_atten_cb_t)(void *ctx, const qca_mme_atten_char_ind_t *ind);
+
+typedef struct {
+    uint32_t sessions;  /* Opened by START_ATTEN_CHAR or a first sound */
+    uint32_t profiles;  /* Added up */
+    uint32_t complete;  /* Closed with all sounds in */
+    uint32_t timeouts;  /* Closed by time_out with sounds missing */
+    uint32_t unmatched; /* Profiles for no open session, passed on to qca_recv */
+    uint32_t table_full;
+} qca_atten_stats_t;
+
+/*====================================================================*
+ *
+ *   qca_atten_init
+ *
+ *   Create the window timer on first use and hook the aggregator into
+ *   the RX path.
+ *   local_mac is the source of the CM_ATTEN_CHAR.IND handed to cb.
+ *
+ *--------------------------------------------------------------------*/
+
+esp_err_t qca_atten_init(const uint8_t *local_mac, qca_atten_cb_t cb, void *ctx);
+
+/* Unhook and drop open sessions without calling back, then wait for
+ * a cb already under way; do not call it from cb. The timer is kept
+ * for the next qca_atten_init. Stop hooks started after the aggregator
+ * first, see qca_rx_hook_t. */
+void qca_atten_deinit(void);
+
+void qca_atten_get_stats(qca_atten_stats_t *stats);
+
+#endif
@@ -0,0 +1,142 @@
+/*====================================================================*
+ *
+ *   qca_bench.c
+ *
+ *   On-target micro benchmarks for the driver data path.
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca_bench.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "qca_ring.h"
+#include <inttypes.h>
+
+static const char *TAG = "qca-bench";
+
+#define QCA_BENCH_DEPTH 32
+
+typedef struct {
+    uint32_t items;
+    QueueHandle_t queue;
+    qca_ring_t ring;
+    _Atomic(TaskHandle_t) waiter;
+    SemaphoreHandle_t done;
+    int64_t start;
+    int64_t end;
+} qca_bench_ctx_t;
+
+static void bench_queue_producer(void *arg)
+{
+    qca_bench_ctx_t *ctx = arg;
+    uintptr_t item;
+
+    for (item = 1; item <= ctx->items; item++) xQueueSend(ctx->queue, &item, portMAX_DELAY);
+
+    xSemaphoreGive(ctx->done);
+    vTaskDelete(NULL);
+}
+
+static void bench_queue_consumer(void *arg)
+{
+    qca_bench_ctx_t *ctx = arg;
+    uintptr_t item;
+    uint32_t n;
+
+    for (n = 0; n < ctx->items; n++) xQueueReceive(ctx->queue, &item, portMAX_DELAY);
+
+    ctx->end = esp_timer_get_time();
+    xSemaphoreGive(ctx->done);
+    vTaskDelete(NULL);
+}
+
+/* Same wakeup protocol as qca_tx_push/qca_recv_batch */
+static void bench_ring_producer(void *arg)
+{
+    qca_bench_ctx_t *ctx = arg;
+    TaskHandle_t waiter;
+    uintptr_t item;
+    bool was_empty;
+
+    for (item = 1; item <= ctx->items; item++)
+    {
+        while (!qca_ring_push(&ctx->ring, (void *)item, &was_empty)) taskYIELD();
+
+        if (was_empty && (waiter = atomic_load(&ctx->waiter)) != NULL)
+            xTaskNotifyGive(waiter);
+    }
+
+    xSemaphoreGive(ctx->done);
+    vTaskDelete(NULL);
+}
+
+static void bench_ring_consumer(void *arg)
+{
+    qca_bench_ctx_t *ctx = arg;
+    void *items[QCA_BENCH_DEPTH];
+    uint32_t n = 0;
+    uint32_t got;
+
+    while (n < ctx->items)
+    {
+        got = qca_ring_pop_n(&ctx->ring, items, QCA_BENCH_DEPTH);
+        if (got == 0)
+        {
+            atomic_store(&ctx->waiter, xTaskGetCurrentTaskHandle());
+            got = qca_ring_pop_n(&ctx->ring, items, QCA_BENCH_DEPTH);
+            if (got == 0)
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            atomic_store(&ctx->waiter, NULL);
+        }
+        n += got;
+    }
+
+    ctx->end = esp_timer_get_time();
+    xSemaphoreGive(ctx->done);
+    vTaskDelete(NULL);
+}
+
+static void bench_run(qca_bench_ctx_t *ctx, const char *name, TaskFunction_t producer, TaskFunction_t consumer,
+                      BaseType_t producer_core)
+{
+    ctx->start = esp_timer_get_time();
+    xTaskCreatePinnedToCore(consumer, "bench_rx", 2048, ctx, tskIDLE_PRIORITY + 8, NULL, APP_CPU_NUM);
+    xTaskCreatePinnedToCore(producer, "bench_tx", 2048, ctx, tskIDLE_PRIORITY + 8, NULL, producer_core);
+
+    xSemaphoreTake(ctx->done, portMAX_DELAY);
+    xSemaphoreTake(ctx->done, portMAX_DELAY);
+
+    ESP_LOGI(TAG, "%-5s %s core: %lu items in %" PRId64 " us, %" PRId64 " ns/item", name,
+             producer_core == APP_CPU_NUM ? "same " : "cross", (unsigned long)ctx->items, ctx->end - ctx->start,
+             (ctx->end - ctx->start) * 1000 / ctx->items);
+}
+
+void qca_bench_rings(uint32_t items)
+{
+    qca_bench_ctx_t ctx = {0};
+    BaseType_t cores[] = {APP_CPU_NUM, PRO_CPU_NUM};
+    int i;
+
+    ctx.items = items;
+    ctx.done  = xSemaphoreCreateCounting(2, 0);
+    ctx.queue = xQueueCreate(QCA_BENCH_DEPTH, sizeof(uintptr_t));
+    if (ctx.done == NULL || ctx.queue == NULL || !qca_ring_init(&ctx.ring, QCA_BENCH_DEPTH))
+    {
+        ESP_LOGE(TAG, "Out of memory");
+        return;
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+        bench_run(&ctx, "queue", bench_queue_producer, bench_queue_consumer, cores[i]);
+        bench_run(&ctx, "ring", bench_ring_producer, bench_ring_consumer, cores[i]);
+    }
+
+    vQueueDelete(ctx.queue);
+    vSemaphoreDelete(ctx.done);
+    free(ctx.ring.slots);
+}
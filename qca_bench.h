@@ -0,0 +1,27 @@
+/*====================================================================*
+ *
+ *   qca_bench.h
+ *
+ *   On-target micro benchmarks for the driver data path.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA_BENCH_HEADER
+#define QCA_BENCH_HEADER
+
+#include <stdint.h>
+
+/*====================================================================*
+ *
+ *   qca_bench_rings
+ *
+ *   Move items descriptor pointers from a producer task to a consumer
+ *   task through a FreeRTOS queue and through a qca_ring_t, with both
+ *   tasks on the same core and on different cores, and log the cost
+ *   per item. Blocks the caller until all four runs are done.
+ *
+ *--------------------------------------------------------------------*/
+
+void qca_bench_rings(uint32_t items);
+
+#endif
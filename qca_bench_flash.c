@@ -0,0 +1,239 @@
+/*====================================================================*
+ *
+ *   qca_bench_flash.c
+ *
+ *   Driver latency under flash load.
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca_bench_flash.h"
+#include "byte_order.h"
+#include "esp_partition.h"
+#include "qca_driver.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "qca-bench-flash";
+
+#define QCA_BENCH_FLASH_SECTOR 4096
+
+/* Time for the last test frames to be written before a phase is closed */
+#define QCA_BENCH_FLASH_DRAIN_MS 100
+
+static const char *const qca_bench_flash_phases[QCA_BENCH_FLASH_PHASES] = {"quiet", "loaded"};
+static const char *const qca_bench_flash_paths[QCA_BENCH_FLASH_PATHS]   = {"TX", "RX"};
+
+static struct {
+    volatile bool running;
+    volatile bool load; /* The loader keeps going while set */
+    qca_rx_hook_t next_hook;
+
+    const esp_partition_t *part;
+    const uint8_t *evict;
+    esp_partition_mmap_handle_t map;
+    uint8_t *sector;
+    volatile uint32_t flash_ops;
+    SemaphoreHandle_t loader_done;
+
+    uint32_t *samples[QCA_BENCH_FLASH_PATHS];
+    uint32_t count[QCA_BENCH_FLASH_PATHS];
+} bench;
+
+static portMUX_TYPE bench_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void qca_bench_flash_sample(qca_bench_flash_path_t path, int64_t us)
+{
+    portENTER_CRITICAL(&bench_lock);
+    if (bench.running && bench.count[path] < QCA_BENCH_FLASH_SAMPLES)
+        bench.samples[path][bench.count[path]++] = (uint32_t)us;
+    portEXIT_CRITICAL(&bench_lock);
+}
+
+static void qca_bench_flash_tx_report(const NetworkBufferDescriptor_t *txDesc)
+{
+    const uint8_t *frame = txDesc->pucEthernetBuffer + QCAFRM_HEADER_LEN;
+
+    if (((frame[12] << 8) | frame[13]) == QCA_BENCH_FLASH_ETHERTYPE)
+        qca_bench_flash_sample(QCA_BENCH_FLASH_TX, txDesc->xDoneTime - txDesc->xEntryTime);
+}
+
+/* SPI thread, in front of the hook that was installed before the run */
+static bool qca_bench_flash_rx(NetworkBufferDescriptor_t *rxDesc)
+{
+    qca_bench_flash_sample(QCA_BENCH_FLASH_RX, rxDesc->xDoneTime - rxDesc->xEntryTime);
+
+    return bench.next_hook != NULL && bench.next_hook(rxDesc);
+}
+
+/* Other core: cache off for every erase and write, then evicted */
+static void qca_bench_flash_loader(void *arg)
+{
+    volatile uint32_t sink = 0;
+    uint32_t i;
+
+    (void)arg;
+    while (bench.load)
+    {
+        esp_partition_erase_range(bench.part, 0, QCA_BENCH_FLASH_SECTOR);
+        esp_partition_write(bench.part, 0, bench.sector, QCA_BENCH_FLASH_SECTOR);
+        for (i = 0; i < QCA_BENCH_FLASH_EVICT; i += 16) sink += bench.evict[i];
+        bench.flash_ops++;
+    }
+
+    xSemaphoreGive(bench.loader_done);
+    vTaskDelete(NULL);
+}
+
+static int qca_bench_flash_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Nearest rank */
+static uint32_t qca_bench_flash_rank(const uint32_t *sorted, uint32_t n, uint32_t pct)
+{
+    uint32_t rank = (uint32_t)(((uint64_t)n * pct + 99) / 100);
+
+    return sorted[(rank ? rank : 1) - 1];
+}
+
+static void qca_bench_flash_pct(qca_bench_flash_path_t path, qca_bench_flash_pct_t *pct)
+{
+    uint32_t n = bench.count[path];
+
+    memset(pct, 0, sizeof(*pct));
+    if (n == 0)
+        return;
+
+    qsort(bench.samples[path], n, sizeof(uint32_t), qca_bench_flash_cmp);
+    pct->count  = n;
+    pct->p50_us = qca_bench_flash_rank(bench.samples[path], n, 50);
+    pct->p90_us = qca_bench_flash_rank(bench.samples[path], n, 90);
+    pct->p99_us = qca_bench_flash_rank(bench.samples[path], n, 99);
+    pct->max_us = bench.samples[path][n - 1];
+}
+
+/* Send test frames for one phase and close it */
+static void qca_bench_flash_phase(const qca_bench_flash_config_t *cfg, qca_bench_flash_phase_t phase,
+                                  qca_bench_flash_report_t *r)
+{
+    uint8_t frame[QCAFRM_ETHMAXLEN] = {0};
+    uint16_t len                    = cfg->frame_len;
+    int64_t start;
+    int path;
+
+    if (len < QCAFRM_ETHMINLEN)
+        len = QCAFRM_ETHMINLEN;
+    if (len > QCAFRM_ETHMAXLEN)
+        len = QCAFRM_ETHMAXLEN;
+    memcpy(frame, cfg->dest, 6);
+    memcpy(frame + 6, cfg->src, 6);
+    frame[12] = QCA_BENCH_FLASH_ETHERTYPE >> 8;
+    frame[13] = QCA_BENCH_FLASH_ETHERTYPE & 0xFF;
+
+    portENTER_CRITICAL(&bench_lock);
+    memset(bench.count, 0, sizeof(bench.count));
+    bench.running = true;
+    portEXIT_CRITICAL(&bench_lock);
+
+    start = esp_timer_get_time();
+    while (esp_timer_get_time() - start < (int64_t)cfg->duration_ms * 1000)
+    {
+        qca_send(frame, len);
+        vTaskDelay(pdMS_TO_TICKS(cfg->interval_ms));
+    }
+    vTaskDelay(pdMS_TO_TICKS(QCA_BENCH_FLASH_DRAIN_MS));
+
+    portENTER_CRITICAL(&bench_lock);
+    bench.running = false;
+    portEXIT_CRITICAL(&bench_lock);
+
+    for (path = 0; path < QCA_BENCH_FLASH_PATHS; path++)
+    {
+        qca_bench_flash_pct(path, &r->pct[phase][path]);
+        ESP_LOGI(TAG, "%-6s %s n %5u  p50 %6u  p90 %6u  p99 %6u  max %6u us", qca_bench_flash_phases[phase],
+                 qca_bench_flash_paths[path], r->pct[phase][path].count, r->pct[phase][path].p50_us,
+                 r->pct[phase][path].p90_us, r->pct[phase][path].p99_us, r->pct[phase][path].max_us);
+    }
+}
+
+static void qca_bench_flash_free(void)
+{
+    int path;
+
+    for (path = 0; path < QCA_BENCH_FLASH_PATHS; path++)
+    {
+        free(bench.samples[path]);
+        bench.samples[path] = NULL;
+    }
+    free(bench.sector);
+    bench.sector = NULL;
+    if (bench.evict != NULL)
+        esp_partition_munmap(bench.map);
+    bench.evict = NULL;
+    if (bench.loader_done != NULL)
+        vSemaphoreDelete(bench.loader_done);
+    bench.loader_done = NULL;
+}
+
+esp_err_t qca_bench_flash(const qca_bench_flash_config_t *cfg, qca_bench_flash_report_t *report)
+{
+    qca_bench_flash_report_t r = {.iram_hot_path = QCASPI_IRAM_HOT_PATH};
+    const void *evict;
+    int path;
+
+    if (cfg->duration_ms == 0 || cfg->interval_ms == 0)
+        return ESP_ERR_INVALID_ARG;
+    if (bench.running || qca.sync != QCASPI_SYNC_READY)
+        return ESP_ERR_INVALID_STATE;
+
+    bench.part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, cfg->partition);
+    if (bench.part == NULL || bench.part->size < QCA_BENCH_FLASH_SECTOR + QCA_BENCH_FLASH_EVICT)
+        return ESP_ERR_NOT_FOUND;
+
+    bench.loader_done = xSemaphoreCreateBinary();
+    bench.sector      = malloc(QCA_BENCH_FLASH_SECTOR);
+    for (path = 0; path < QCA_BENCH_FLASH_PATHS; path++)
+        bench.samples[path] = malloc(QCA_BENCH_FLASH_SAMPLES * sizeof(uint32_t));
+    if (bench.loader_done == NULL || bench.sector == NULL || bench.samples[QCA_BENCH_FLASH_TX] == NULL
+        || bench.samples[QCA_BENCH_FLASH_RX] == NULL
+        || esp_partition_mmap(bench.part, QCA_BENCH_FLASH_SECTOR, QCA_BENCH_FLASH_EVICT, ESP_PARTITION_MMAP_DATA,
+                              &evict, &bench.map)
+               != ESP_OK)
+    {
+        qca_bench_flash_free();
+        return ESP_ERR_NO_MEM;
+    }
+    bench.evict = evict;
+    memset(bench.sector, 0xA5, QCA_BENCH_FLASH_SECTOR);
+
+    ESP_LOGI(TAG, "IRAM hot path %d, %u ms per phase, %u byte frame every %u ms", QCASPI_IRAM_HOT_PATH,
+             cfg->duration_ms, cfg->frame_len, cfg->interval_ms);
+
+    bench.next_hook = qca.rx_hook;
+    qca.rx_hook     = qca_bench_flash_rx;
+    qca_set_tx_report_cb(qca_bench_flash_tx_report);
+
+    qca_bench_flash_phase(cfg, QCA_BENCH_FLASH_QUIET, &r);
+
+    bench.flash_ops = 0;
+    bench.load      = true;
+    xTaskCreatePinnedToCore(qca_bench_flash_loader, "bench_flash", 2048, NULL, tskIDLE_PRIORITY + 5, NULL,
+                            PRO_CPU_NUM);
+    qca_bench_flash_phase(cfg, QCA_BENCH_FLASH_LOADED, &r);
+    bench.load = false;
+    xSemaphoreTake(bench.loader_done, portMAX_DELAY);
+    r.flash_ops = bench.flash_ops;
+    ESP_LOGI(TAG, "%u sector erase/write cycles", r.flash_ops);
+
+    qca_set_tx_report_cb(NULL);
+    qca.rx_hook = bench.next_hook;
+
+    qca_bench_flash_free();
+    if (report != NULL)
+        *report = r;
+
+    return ESP_OK;
+}
@@ -0,0 +1,95 @@
+/*====================================================================*
+ *
+ *   qca_bench_flash.h
+ *
+ *   Driver latency under flash load.
+ *
+ *   Sends test frames at a fixed interval for a quiet phase and then
+ *   for a phase in which a task on the other core keeps erasing and
+ *   writing a sector of a scratch data partition (flash cache off) and
+ *   streaming through the rest of it (cache evicted). For both phases
+ *   it logs p50/p90/p99/max of
+ *
+ *     TX  qca_send to burst written to the QCA7000
+ *     RX  QCA7000 interrupt to frame decoded in the SPI thread
+ *
+ *   RX samples every received frame, so it needs traffic from the
+ *   other node, e.g. qca_perf in QCA_PERF_TX mode. Run it once built
+ *   with and once without QCASPI_IRAM_HOT_PATH and compare the maxima;
+ *   the first log line names the build.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA_BENCH_FLASH_HEADER
+#define QCA_BENCH_FLASH_HEADER
+
+#include "qca_spi.h"
+
+/* IEEE 802 local experimental ethertype 2, qca_perf uses the first */
+#define QCA_BENCH_FLASH_ETHERTYPE 0x88B6
+
+/* Samples kept per path and phase */
+#ifndef QCA_BENCH_FLASH_SAMPLES
+#define QCA_BENCH_FLASH_SAMPLES 4096
+#endif
+
+/* Bytes streamed through the cache after every sector write */
+#ifndef QCA_BENCH_FLASH_EVICT
+#define QCA_BENCH_FLASH_EVICT (64 * 1024)
+#endif
+
+typedef enum
+{
+    QCA_BENCH_FLASH_TX = 0, /* qca_send to written */
+    QCA_BENCH_FLASH_RX,     /* Interrupt to decoded */
+    QCA_BENCH_FLASH_PATHS,
+} qca_bench_flash_path_t;
+
+typedef enum
+{
+    QCA_BENCH_FLASH_QUIET = 0,
+    QCA_BENCH_FLASH_LOADED,
+    QCA_BENCH_FLASH_PHASES,
+} qca_bench_flash_phase_t;
+
+typedef struct {
+    const char *partition; /* Label of a data partition it may erase, at least 4 KB + QCA_BENCH_FLASH_EVICT */
+    uint32_t duration_ms;  /* Per phase */
+    uint32_t interval_ms;  /* Between test frames */
+    uint16_t frame_len;
+    uint8_t dest[6];
+    uint8_t src[6];
+} qca_bench_flash_config_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t p50_us;
+    uint32_t p90_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+} qca_bench_flash_pct_t;
+
+typedef struct {
+    bool iram_hot_path; /* QCASPI_IRAM_HOT_PATH of this build */
+    uint32_t flash_ops; /* Sector erase and write cycles in the loaded phase */
+    qca_bench_flash_pct_t pct[QCA_BENCH_FLASH_PHASES][QCA_BENCH_FLASH_PATHS];
+} qca_bench_flash_report_t;
+
+/*====================================================================*
+ *
+ *   qca_bench_flash
+ *
+ *   Run both phases, log the percentiles and fill report if not NULL.
+ *   Blocks the caller until done. Takes the TX report callback and
+ *   chains itself in front of the RX hook for the run.
+ *
+ *   Return: ESP_ERR_INVALID_ARG      No duration or interval
+ *           ESP_ERR_NOT_FOUND        No such partition, or too small
+ *           ESP_ERR_INVALID_STATE    Already running or not synced
+ *           ESP_ERR_NO_MEM           No room for the samples
+ *
+ *--------------------------------------------------------------------*/
+
+esp_err_t qca_bench_flash(const qca_bench_flash_config_t *cfg, qca_bench_flash_report_t *report);
+
+#endif
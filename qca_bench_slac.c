@@ -0,0 +1,374 @@
+/*====================================================================*
+ *
+ *   qca_bench_slac.c
+ *
+ *   SLAC round trip benchmark.
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca_bench_slac.h"
+#include "byte_order.h"
+#include "freertos/semphr.h"
+#include "qca_driver.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "qca-bench-slac";
+
+/* CM_MNBC_SOUND.IND samples kept per session, C_EV_match_MNBC */
+#define QCA_BENCH_SLAC_SOUNDS 10
+
+#define QCA_BENCH_SLAC_START_ATTENS 3
+
+static const uint8_t qca_bench_slac_bcast[QCA_MME_ETH_ALEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+static const char *const qca_bench_slac_names[QCA_BENCH_SLAC_LEGS] = {
+    "SLAC_PARM", "START_ATTEN_CHAR", "MNBC_SOUND", "ATTEN_CHAR", "ATTEN_CHAR.RSP", "SLAC_MATCH", "session",
+};
+
+static struct {
+    volatile bool running;
+    qca_bench_slac_config_t cfg;
+    uint8_t run_id[QCA_MME_RUN_ID_LEN];
+    uint8_t evse_mac[QCA_MME_ETH_ALEN];
+    uint8_t num_sounds;
+
+    uint16_t expect; /* MMTYPE of the awaited answer, 0 for none */
+    int64_t rx_time;
+    SemaphoreHandle_t answer;
+
+    uint32_t *samples[QCA_BENCH_SLAC_LEGS];
+    uint32_t count[QCA_BENCH_SLAC_LEGS];
+    uint32_t cap[QCA_BENCH_SLAC_LEGS];
+} bench;
+
+static portMUX_TYPE bench_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void qca_bench_slac_sample(qca_bench_slac_leg_t leg, int64_t us)
+{
+    portENTER_CRITICAL(&bench_lock);
+    if (bench.running && bench.count[leg] < bench.cap[leg])
+        bench.samples[leg][bench.count[leg]++] = (uint32_t)us;
+    portEXIT_CRITICAL(&bench_lock);
+}
+
+/* TX report: indications are done once written to the QCA7000 */
+static void qca_bench_slac_tx_report(const NetworkBufferDescriptor_t *txDesc)
+{
+    int64_t us = txDesc->xDoneTime - txDesc->xEntryTime;
+
+    switch (qca_mme_type(txDesc->pucEthernetBuffer + QCAFRM_HEADER_LEN, txDesc->xDataLength))
+    {
+    case QCA_MMTYPE_CM_START_ATTEN_CHAR | QCA_MMTYPE_IND:
+        qca_bench_slac_sample(QCA_BENCH_SLAC_START_ATTEN, us);
+        break;
+    case QCA_MMTYPE_CM_MNBC_SOUND | QCA_MMTYPE_IND:
+        qca_bench_slac_sample(QCA_BENCH_SLAC_SOUND, us);
+        break;
+    case QCA_MMTYPE_CM_ATTEN_CHAR | QCA_MMTYPE_RSP:
+        qca_bench_slac_sample(QCA_BENCH_SLAC_ATTEN_RSP, us);
+        break;
+    default:
+        break;
+    }
+}
+
+bool qca_bench_slac_rx(NetworkBufferDescriptor_t *rxDesc)
+{
+    const uint8_t *frame = rxDesc->pucEthernetBuffer;
+    const uint8_t *run_id;
+    uint16_t mmtype;
+
+    if (!bench.running)
+        return false;
+
+    mmtype = qca_mme_type(frame, rxDesc->xDataLength);
+    if (mmtype == 0 || mmtype != bench.expect)
+        return false;
+
+    switch (mmtype)
+    {
+    case QCA_MMTYPE_CM_SLAC_PARM | QCA_MMTYPE_CNF: {
+        const qca_mme_slac_parm_cnf_t *cnf = QCA_MME_CAST(rxDesc, mmtype, qca_mme_slac_parm_cnf_t);
+        if (cnf == NULL)
+            return false;
+        run_id = cnf->run_id;
+        break;
+    }
+    case QCA_MMTYPE_CM_ATTEN_CHAR | QCA_MMTYPE_IND: {
+        const qca_mme_atten_char_ind_t *ind = QCA_MME_CAST(rxDesc, mmtype, qca_mme_atten_char_ind_t);
+        if (ind == NULL)
+            return false;
+        run_id = ind->run_id;
+        break;
+    }
+    case QCA_MMTYPE_CM_SLAC_MATCH | QCA_MMTYPE_CNF: {
+        const qca_mme_slac_match_cnf_t *cnf = QCA_MME_CAST(rxDesc, mmtype, qca_mme_slac_match_cnf_t);
+        if (cnf == NULL)
+            return false;
+        run_id = cnf->run_id;
+        break;
+    }
+    default:
+        return false;
+    }
+
+    if (memcmp(run_id, bench.run_id, QCA_MME_RUN_ID_LEN) != 0)
+        return false;
+
+    if (mmtype == (QCA_MMTYPE_CM_SLAC_PARM | QCA_MMTYPE_CNF))
+    {
+        const qca_mme_slac_parm_cnf_t *cnf = (const qca_mme_slac_parm_cnf_t *)frame;
+
+        memcpy(bench.evse_mac, cnf->av.hdr.src, QCA_MME_ETH_ALEN);
+        bench.num_sounds = cnf->num_sounds;
+    }
+
+    portENTER_CRITICAL(&bench_lock);
+    if (bench.expect == mmtype)
+    {
+        bench.expect  = 0;
+        bench.rx_time = esp_timer_get_time();
+        xSemaphoreGive(bench.answer);
+    }
+    portEXIT_CRITICAL(&bench_lock);
+
+    qca_free_desc(rxDesc);
+    return true;
+}
+
+static void qca_bench_slac_hdr(qca_mme_av_hdr_t *av, uint16_t mmtype, const uint8_t *dest)
+{
+    memcpy(av->hdr.dest, dest, QCA_MME_ETH_ALEN);
+    memcpy(av->hdr.src, bench.cfg.pev_mac, QCA_MME_ETH_ALEN);
+    av->hdr.ethertype = __cpu_to_be16(QCA_MME_ETHERTYPE);
+    av->hdr.mmv       = QCA_MME_MMV_AV_1_1;
+    av->hdr.mmtype    = __cpu_to_le16(mmtype);
+}
+
+/* Return: esp_timer us right before qca_send, -1 if the TX ring stayed full */
+static int64_t qca_bench_slac_send(void *msg, size_t len)
+{
+    int64_t now;
+    int tries;
+
+    for (tries = 0; tries < QCA_BENCH_SLAC_TIMEOUT_MS; tries++)
+    {
+        now = esp_timer_get_time();
+        if (qca_send(msg, len) == ESP_OK)
+            return now;
+        vTaskDelay(1);
+    }
+    return -1;
+}
+
+static void qca_bench_slac_expect(uint16_t mmtype)
+{
+    portENTER_CRITICAL(&bench_lock);
+    bench.expect = mmtype;
+    portEXIT_CRITICAL(&bench_lock);
+}
+
+/* Return: esp_timer us the answer was received, -1 on timeout */
+static int64_t qca_bench_slac_await(void)
+{
+    int64_t rx_time = -1;
+
+    if (xSemaphoreTake(bench.answer, pdMS_TO_TICKS(QCA_BENCH_SLAC_TIMEOUT_MS)) == pdTRUE)
+    {
+        portENTER_CRITICAL(&bench_lock);
+        rx_time = bench.rx_time;
+        portEXIT_CRITICAL(&bench_lock);
+        return rx_time;
+    }
+
+    /* Stop waiting, then drop an answer that raced the timeout */
+    qca_bench_slac_expect(0);
+    xSemaphoreTake(bench.answer, 0);
+    return -1;
+}
+
+static bool qca_bench_slac_session(uint32_t session)
+{
+    qca_mme_slac_parm_req_t parm             = {0};
+    qca_mme_start_atten_char_ind_t start     = {0};
+    qca_mme_mnbc_sound_ind_t sound           = {0};
+    qca_mme_atten_char_rsp_t rsp             = {0};
+    qca_mme_slac_match_req_t match           = {0};
+    int64_t t_start, t_sound = -1, t_sent, t_rx;
+    uint8_t i;
+
+    t_start = esp_timer_get_time();
+    memcpy(bench.run_id, &t_start, sizeof(t_start));
+    bench.run_id[0] ^= (uint8_t)session;
+
+    /* CM_SLAC_PARM */
+    qca_bench_slac_hdr(&parm.av, QCA_MMTYPE_CM_SLAC_PARM | QCA_MMTYPE_REQ, qca_bench_slac_bcast);
+    memcpy(parm.run_id, bench.run_id, QCA_MME_RUN_ID_LEN);
+    qca_bench_slac_expect(QCA_MMTYPE_CM_SLAC_PARM | QCA_MMTYPE_CNF);
+    if ((t_start = qca_bench_slac_send(&parm, sizeof(parm))) < 0 || (t_rx = qca_bench_slac_await()) < 0)
+        return false;
+    qca_bench_slac_sample(QCA_BENCH_SLAC_PARM, t_rx - t_start);
+
+    /* Sounding, CM_ATTEN_CHAR.IND can only follow the last sound */
+    qca_bench_slac_expect(QCA_MMTYPE_CM_ATTEN_CHAR | QCA_MMTYPE_IND);
+
+    qca_bench_slac_hdr(&start.av, QCA_MMTYPE_CM_START_ATTEN_CHAR | QCA_MMTYPE_IND, qca_bench_slac_bcast);
+    start.num_sounds = bench.num_sounds;
+    start.time_out   = 6; /* 600 ms */
+    start.resp_type  = 1;
+    memcpy(start.forwarding_sta, bench.cfg.pev_mac, QCA_MME_ETH_ALEN);
+    memcpy(start.run_id, bench.run_id, QCA_MME_RUN_ID_LEN);
+    for (i = 0; i < QCA_BENCH_SLAC_START_ATTENS; i++)
+        if (qca_bench_slac_send(&start, sizeof(start)) < 0)
+            return false;
+
+    qca_bench_slac_hdr(&sound.av, QCA_MMTYPE_CM_MNBC_SOUND | QCA_MMTYPE_IND, qca_bench_slac_bcast);
+    memcpy(sound.run_id, bench.run_id, QCA_MME_RUN_ID_LEN);
+    for (i = 0; i < bench.num_sounds; i++)
+    {
+        if (i > 0 && bench.cfg.sound_interval_ms)
+            vTaskDelay(pdMS_TO_TICKS(bench.cfg.sound_interval_ms));
+        sound.cnt = bench.num_sounds - 1 - i;
+        if ((t_sound = qca_bench_slac_send(&sound, sizeof(sound))) < 0)
+            return false;
+    }
+
+    if ((t_rx = qca_bench_slac_await()) < 0)
+        return false;
+    if (t_sound >= 0)
+        qca_bench_slac_sample(QCA_BENCH_SLAC_ATTEN_CHAR, t_rx - t_sound);
+
+    qca_bench_slac_hdr(&rsp.av, QCA_MMTYPE_CM_ATTEN_CHAR | QCA_MMTYPE_RSP, bench.evse_mac);
+    memcpy(rsp.source_address, bench.cfg.pev_mac, QCA_MME_ETH_ALEN);
+    memcpy(rsp.run_id, bench.run_id, QCA_MME_RUN_ID_LEN);
+    if (qca_bench_slac_send(&rsp, sizeof(rsp)) < 0)
+        return false;
+
+    /* CM_SLAC_MATCH */
+    qca_bench_slac_hdr(&match.av, QCA_MMTYPE_CM_SLAC_MATCH | QCA_MMTYPE_REQ, bench.evse_mac);
+    match.mvf_length = __cpu_to_le16(sizeof(match) - offsetof(qca_mme_slac_match_req_t, pev_id));
+    memcpy(match.pev_mac, bench.cfg.pev_mac, QCA_MME_ETH_ALEN);
+    memcpy(match.evse_mac, bench.evse_mac, QCA_MME_ETH_ALEN);
+    memcpy(match.run_id, bench.run_id, QCA_MME_RUN_ID_LEN);
+    qca_bench_slac_expect(QCA_MMTYPE_CM_SLAC_MATCH | QCA_MMTYPE_CNF);
+    if ((t_sent = qca_bench_slac_send(&match, sizeof(match))) < 0 || (t_rx = qca_bench_slac_await()) < 0)
+        return false;
+    qca_bench_slac_sample(QCA_BENCH_SLAC_MATCH, t_rx - t_sent);
+    qca_bench_slac_sample(QCA_BENCH_SLAC_SESSION, t_rx - t_start);
+
+    return true;
+}
+
+static int qca_bench_slac_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Nearest rank */
+static uint32_t qca_bench_slac_rank(const uint32_t *sorted, uint32_t n, uint32_t pct)
+{
+    uint32_t rank = (uint32_t)(((uint64_t)n * pct + 99) / 100);
+
+    return sorted[(rank ? rank : 1) - 1];
+}
+
+static void qca_bench_slac_pct(qca_bench_slac_leg_t leg, qca_bench_slac_pct_t *pct)
+{
+    uint32_t n = bench.count[leg];
+
+    memset(pct, 0, sizeof(*pct));
+    if (n == 0)
+        return;
+
+    qsort(bench.samples[leg], n, sizeof(uint32_t), qca_bench_slac_cmp);
+    pct->count  = n;
+    pct->p50_us = qca_bench_slac_rank(bench.samples[leg], n, 50);
+    pct->p90_us = qca_bench_slac_rank(bench.samples[leg], n, 90);
+    pct->p99_us = qca_bench_slac_rank(bench.samples[leg], n, 99);
+    pct->max_us = bench.samples[leg][n - 1];
+}
+
+static void qca_bench_slac_free(void)
+{
+    int leg;
+
+    for (leg = 0; leg < QCA_BENCH_SLAC_LEGS; leg++)
+    {
+        free(bench.samples[leg]);
+        bench.samples[leg] = NULL;
+    }
+    if (bench.answer != NULL)
+        vSemaphoreDelete(bench.answer);
+    bench.answer = NULL;
+}
+
+esp_err_t qca_bench_slac(const qca_bench_slac_config_t *cfg, qca_bench_slac_report_t *report)
+{
+    qca_bench_slac_report_t r = {0};
+    uint32_t session;
+    int leg;
+
+    if (cfg->sessions == 0)
+        return ESP_ERR_INVALID_ARG;
+    if (bench.running || qca.sync != QCASPI_SYNC_READY)
+        return ESP_ERR_INVALID_STATE;
+
+    memset(bench.count, 0, sizeof(bench.count));
+    bench.cfg    = *cfg;
+    bench.expect = 0;
+    bench.answer = xSemaphoreCreateBinary();
+    for (leg = 0; leg < QCA_BENCH_SLAC_LEGS; leg++)
+    {
+        bench.cap[leg] = cfg->sessions;
+        if (leg == QCA_BENCH_SLAC_START_ATTEN)
+            bench.cap[leg] *= QCA_BENCH_SLAC_START_ATTENS;
+        else if (leg == QCA_BENCH_SLAC_SOUND)
+            bench.cap[leg] *= QCA_BENCH_SLAC_SOUNDS;
+        bench.samples[leg] = malloc(bench.cap[leg] * sizeof(uint32_t));
+        if (bench.samples[leg] == NULL || bench.answer == NULL)
+        {
+            qca_bench_slac_free();
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    bench.running = true;
+    qca_set_tx_report_cb(qca_bench_slac_tx_report);
+
+    r.sessions = cfg->sessions;
+    for (session = 0; session < cfg->sessions; session++)
+    {
+        if (!qca_bench_slac_session(session))
+        {
+            r.failed++;
+            qca_bench_slac_expect(0);
+        }
+    }
+
+    qca_set_tx_report_cb(NULL);
+    portENTER_CRITICAL(&bench_lock);
+    bench.running = false;
+    portEXIT_CRITICAL(&bench_lock);
+
+    ESP_LOGI(TAG, "%u sessions, %u failed", r.sessions, r.failed);
+    for (leg = 0; leg < QCA_BENCH_SLAC_LEGS; leg++)
+    {
+        qca_bench_slac_pct(leg, &r.leg[leg]);
+        ESP_LOGI(TAG, "%-16s n %6u  p50 %6u  p90 %6u  p99 %6u  max %6u us", qca_bench_slac_names[leg],
+                 r.leg[leg].count, r.leg[leg].p50_us, r.leg[leg].p90_us, r.leg[leg].p99_us, r.leg[leg].max_us);
+    }
+
+    qca_bench_slac_free();
+    if (report != NULL)
+        *report = r;
+
+    return ESP_OK;
+}
+
+const char *qca_bench_slac_leg_name(qca_bench_slac_leg_t leg)
+{
+    return (leg < QCA_BENCH_SLAC_LEGS) ? qca_bench_slac_names[leg] : "?";
+}
@@ -0,0 +1,98 @@
+/*====================================================================*
+ *
+ *   qca_bench_slac.h
+ *
+ *   SLAC round trip benchmark.
+ *
+ *   Runs the PEV side of a scripted SLAC exchange session after
+ *   session and measures every leg as the application sees it, from
+ *   qca_send to qca_recv:
+ *
+ *     CM_SLAC_PARM.REQ        -> CM_SLAC_PARM.CNF
+ *     CM_START_ATTEN_CHAR.IND x3, CM_MNBC_SOUND.IND xN
+ *     last CM_MNBC_SOUND.IND  -> CM_ATTEN_CHAR.IND
+ *     CM_ATTEN_CHAR.RSP
+ *     CM_SLAC_MATCH.REQ       -> CM_SLAC_MATCH.CNF
+ *
+ *   Indications without an answer are measured from qca_send until
+ *   they are written to the QCA7000. The EVSE side is a real EVSE, or
+ *   on a host the emulated peer in host/qca_slac_peer.c behind the
+ *   QCA7000 model, see tools/qca_slac_bench.c.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA_BENCH_SLAC_HEADER
+#define QCA_BENCH_SLAC_HEADER
+
+#include "qca_mme.h"
+
+/* One wait for an EVSE answer */
+#ifndef QCA_BENCH_SLAC_TIMEOUT_MS
+#define QCA_BENCH_SLAC_TIMEOUT_MS 1000
+#endif
+
+typedef enum
+{
+    QCA_BENCH_SLAC_PARM = 0,     /* CM_SLAC_PARM.REQ sent to .CNF received */
+    QCA_BENCH_SLAC_START_ATTEN,  /* CM_START_ATTEN_CHAR.IND sent to written */
+    QCA_BENCH_SLAC_SOUND,        /* CM_MNBC_SOUND.IND sent to written */
+    QCA_BENCH_SLAC_ATTEN_CHAR,   /* Last CM_MNBC_SOUND.IND sent to CM_ATTEN_CHAR.IND received */
+    QCA_BENCH_SLAC_ATTEN_RSP,    /* CM_ATTEN_CHAR.RSP sent to written */
+    QCA_BENCH_SLAC_MATCH,        /* CM_SLAC_MATCH.REQ sent to .CNF received */
+    QCA_BENCH_SLAC_SESSION,      /* CM_SLAC_PARM.REQ sent to CM_SLAC_MATCH.CNF received */
+    QCA_BENCH_SLAC_LEGS,
+} qca_bench_slac_leg_t;
+
+typedef struct {
+    uint32_t sessions;
+    uint32_t sound_interval_ms; /* Between CM_MNBC_SOUND.INDs, 0 for back to back */
+    uint8_t pev_mac[QCA_MME_ETH_ALEN];
+} qca_bench_slac_config_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t p50_us;
+    uint32_t p90_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+} qca_bench_slac_pct_t;
+
+typedef struct {
+    uint32_t sessions;
+    uint32_t failed; /* An answer missing or late, the session was given up */
+    qca_bench_slac_pct_t leg[QCA_BENCH_SLAC_LEGS];
+} qca_bench_slac_report_t;
+
+/*====================================================================*
+ *
+ *   qca_bench_slac
+ *
+ *   Run cfg->sessions SLAC sessions back to back, log the latency
+ *   percentiles of every leg and fill report if not NULL. Blocks the
+ *   caller until done. Takes the TX report callback for the run.
+ *
+ *   Return: ESP_ERR_INVALID_ARG      No sessions
+ *           ESP_ERR_INVALID_STATE    Already running or not synced
+ *           ESP_ERR_NO_MEM           No room for the samples
+ *
+ *--------------------------------------------------------------------*/
+
+esp_err_t qca_bench_slac(const qca_bench_slac_config_t *cfg, qca_bench_slac_report_t *report);
+
+/*====================================================================*
+ *
+ *   qca_bench_slac_rx
+ *
+ *   Offer a received frame to the benchmark, from the task that calls
+ *   qca_recv.
+ *
+ *   Return: true if it was an answer of the running session, which is
+ *   then consumed.
+ *
+ *--------------------------------------------------------------------*/
+
+bool qca_bench_slac_rx(NetworkBufferDescriptor_t *rxDesc);
+
+const char *qca_bench_slac_leg_name(qca_bench_slac_leg_t leg);
+
+#endif
@@ -0,0 +1,284 @@
+/*====================================================================*
+ *
+ *   qca_bridge.c
+ *
+ *   Two port L2 bridge between the PLC link and a second interface.
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca_bridge.h"
+#include "qca_driver.h"
+#include "qca_mme.h"
+#include <string.h>
+
+/* qca_bridge_input sends from the port task */
+#if !QCASPI_TX_MULTI_PRODUCER
+#error "qca_bridge needs QCASPI_TX_MULTI_PRODUCER"
+#endif
+
+typedef enum
+{
+    QCA_BRIDGE_FORWARD = 0,
+    QCA_BRIDGE_FILTER,
+    QCA_BRIDGE_LOCAL,
+    QCA_BRIDGE_SHARE, /* Forward a clone, the original stays local */
+} qca_bridge_verdict_t;
+
+typedef struct {
+    uint8_t mac[QCA_BRIDGE_ETH_ALEN];
+    uint8_t side;
+    bool used;
+    TickType_t seen;
+} qca_bridge_entry_t;
+
+static struct {
+    volatile bool running;
+    bool hooked; /* qca_bridge_rx is in the RX hook chain */
+    qca_bridge_config_t cfg;
+    bool has_local_mac;
+    qca_rx_hook_t next_hook;
+    qca_bridge_entry_t table[QCA_BRIDGE_MACS];
+    qca_bridge_stats_t stats;
+} bridge;
+
+static portMUX_TYPE bridge_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool QCA_IRAM_ATTR qca_bridge_aged(const qca_bridge_entry_t *e, TickType_t now)
+{
+    return (now - e->seen) >= pdMS_TO_TICKS(QCA_BRIDGE_AGE_MS);
+}
+
+/* Called with bridge_lock held. Return: NULL if unknown or aged out. */
+static qca_bridge_entry_t *QCA_IRAM_ATTR qca_bridge_find(const uint8_t *mac, TickType_t now)
+{
+    int i;
+
+    for (i = 0; i < QCA_BRIDGE_MACS; i++)
+        if (bridge.table[i].used && memcmp(bridge.table[i].mac, mac, QCA_BRIDGE_ETH_ALEN) == 0)
+            return qca_bridge_aged(&bridge.table[i], now) ? NULL : &bridge.table[i];
+    return NULL;
+}
+
+/* Called with bridge_lock held */
+static void QCA_IRAM_ATTR qca_bridge_learn(const uint8_t *mac, qca_bridge_side_t side, TickType_t now)
+{
+    qca_bridge_entry_t *e, *oldest;
+    int i;
+
+    if (mac[0] & 0x01)
+        return;
+
+    if ((e = qca_bridge_find(mac, now)) != NULL)
+    {
+        if (e->side != side)
+        {
+            e->side = side;
+            bridge.stats.moved++;
+        }
+        e->seen = now;
+        return;
+    }
+
+    /* A free or aged slot, else the station heard from longest ago */
+    oldest = &bridge.table[0];
+    for (i = 0; i < QCA_BRIDGE_MACS; i++)
+    {
+        e = &bridge.table[i];
+        if (!e->used || qca_bridge_aged(e, now) || memcmp(e->mac, mac, QCA_BRIDGE_ETH_ALEN) == 0)
+            break;
+        if ((int32_t)(e->seen - oldest->seen) < 0)
+            oldest = e;
+    }
+    if (i == QCA_BRIDGE_MACS)
+    {
+        e = oldest;
+        bridge.stats.evicted++;
+    }
+
+    memcpy(e->mac, mac, QCA_BRIDGE_ETH_ALEN);
+    e->side = side;
+    e->seen = now;
+    e->used = true;
+    bridge.stats.learned++;
+}
+
+static qca_bridge_verdict_t QCA_IRAM_ATTR qca_bridge_classify(const uint8_t *frame, qca_bridge_side_t side)
+{
+    uint16_t ethertype = (uint16_t)((frame[12] << 8) | frame[13]);
+    TickType_t now     = xTaskGetTickCount();
+    qca_bridge_entry_t *e;
+    qca_bridge_verdict_t verdict;
+
+    portENTER_CRITICAL(&bridge_lock);
+
+    qca_bridge_learn(frame + QCA_BRIDGE_ETH_ALEN, side, now);
+
+    if (bridge.has_local_mac && memcmp(frame, bridge.cfg.local_mac, QCA_BRIDGE_ETH_ALEN) == 0)
+        verdict = QCA_BRIDGE_LOCAL;
+    else if (side == QCA_BRIDGE_PLC && bridge.cfg.local_mme && ethertype == QCA_MME_ETHERTYPE)
+        verdict = QCA_BRIDGE_LOCAL;
+    else if (frame[0] & 0x01)
+        verdict = bridge.cfg.local_bcast ? QCA_BRIDGE_SHARE : QCA_BRIDGE_FORWARD;
+    else
+        verdict = ((e = qca_bridge_find(frame, now)) != NULL && e->side == side) ? QCA_BRIDGE_FILTER
+                                                                                 : QCA_BRIDGE_FORWARD;
+
+    switch (verdict)
+    {
+    case QCA_BRIDGE_FORWARD:
+        bridge.stats.forwarded[side]++;
+        break;
+    case QCA_BRIDGE_FILTER:
+        bridge.stats.filtered[side]++;
+        break;
+    case QCA_BRIDGE_LOCAL:
+        bridge.stats.local[side]++;
+        break;
+    case QCA_BRIDGE_SHARE:
+        bridge.stats.shared[side]++;
+        break;
+    }
+
+    portEXIT_CRITICAL(&bridge_lock);
+    return verdict;
+}
+
+static void qca_bridge_dropped(qca_bridge_side_t side)
+{
+    portENTER_CRITICAL(&bridge_lock);
+    bridge.stats.dropped[side]++;
+    portEXIT_CRITICAL(&bridge_lock);
+}
+
+/* desc is passed on or freed */
+static void qca_bridge_to_plc(NetworkBufferDescriptor_t *desc)
+{
+    if (qca_send_desc(desc) != ESP_OK)
+    {
+        qca_free_desc(desc);
+        qca_bridge_dropped(QCA_BRIDGE_PORT);
+    }
+}
+
+static void QCA_IRAM_ATTR qca_bridge_to_port(NetworkBufferDescriptor_t *desc)
+{
+    if (bridge.cfg.port_tx(bridge.cfg.port_ctx, desc) != ESP_OK)
+    {
+        qca_free_desc(desc);
+        qca_bridge_dropped(QCA_BRIDGE_PLC);
+    }
+}
+
+/* SPI thread, behind the hook that was installed before */
+static bool QCA_IRAM_ATTR qca_bridge_rx(NetworkBufferDescriptor_t *rxDesc)
+{
+    NetworkBufferDescriptor_t *clone;
+
+    if (bridge.next_hook != NULL && bridge.next_hook(rxDesc))
+        return true;
+    if (!bridge.running || rxDesc->xDataLength < ETH_HLEN)
+        return false;
+
+    switch (qca_bridge_classify(rxDesc->pucEthernetBuffer, QCA_BRIDGE_PLC))
+    {
+    case QCA_BRIDGE_LOCAL:
+        return false;
+    case QCA_BRIDGE_FILTER:
+        qca_free_desc(rxDesc);
+        return true;
+    case QCA_BRIDGE_SHARE:
+        if ((clone = qca_clone_desc(rxDesc)) == NULL)
+        {
+            qca_bridge_dropped(QCA_BRIDGE_PLC);
+            return false;
+        }
+        qca_bridge_to_port(clone);
+        return false;
+    default:
+        qca_bridge_to_port(rxDesc);
+        return true;
+    }
+}
+
+esp_err_t qca_bridge_start(const qca_bridge_config_t *cfg)
+{
+    static const uint8_t none[QCA_BRIDGE_ETH_ALEN] = {0};
+
+    if (cfg->port_tx == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if (bridge.running)
+        return ESP_ERR_INVALID_STATE;
+
+    portENTER_CRITICAL(&bridge_lock);
+    memset(bridge.table, 0, sizeof(bridge.table));
+    memset(&bridge.stats, 0, sizeof(bridge.stats));
+    bridge.cfg           = *cfg;
+    bridge.has_local_mac = memcmp(cfg->local_mac, none, QCA_BRIDGE_ETH_ALEN) != 0;
+    portEXIT_CRITICAL(&bridge_lock);
+
+    /* Still chained after a stop out of order */
+    if (!bridge.hooked)
+    {
+        bridge.next_hook = qca.rx_hook;
+        qca.rx_hook      = qca_bridge_rx;
+        bridge.hooked    = true;
+    }
+    bridge.running = true;
+
+    return ESP_OK;
+}
+
+void qca_bridge_stop(void)
+{
+    if (!bridge.running)
+        return;
+
+    /* A hook installed later chains to ours, leave it in place */
+    if (qca.rx_hook == qca_bridge_rx)
+    {
+        qca.rx_hook   = bridge.next_hook;
+        bridge.hooked = false;
+    }
+    bridge.running = false;
+}
+
+bool qca_bridge_input(NetworkBufferDescriptor_t *desc)
+{
+    NetworkBufferDescriptor_t *clone;
+
+    if (!bridge.running)
+        return false;
+    if (desc->xDataLength < ETH_HLEN || desc->xDataLength > QCAFRM_ETHMAXLEN)
+    {
+        qca_free_desc(desc);
+        qca_bridge_dropped(QCA_BRIDGE_PORT);
+        return true;
+    }
+
+    switch (qca_bridge_classify(desc->pucEthernetBuffer, QCA_BRIDGE_PORT))
+    {
+    case QCA_BRIDGE_LOCAL:
+        return false;
+    case QCA_BRIDGE_FILTER:
+        qca_free_desc(desc);
+        return true;
+    case QCA_BRIDGE_SHARE:
+        if ((clone = qca_clone_desc(desc)) == NULL)
+        {
+            qca_bridge_dropped(QCA_BRIDGE_PORT);
+            return false;
+        }
+        qca_bridge_to_plc(clone);
+        return false;
+    default:
+        qca_bridge_to_plc(desc);
+        return true;
+    }
+}
+
+void qca_bridge_get_stats(qca_bridge_stats_t *stats)
+{
+    portENTER_CRITICAL(&bridge_lock);
+    *stats = bridge.stats;
+    portEXIT_CRITICAL(&bridge_lock);
+}
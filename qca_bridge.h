@@ -0,0 +1,110 @@
+/*====================================================================*
+ *
+ *   qca_bridge.h
+ *
+ *   Two port L2 bridge between the PLC link and a second interface.
+ *
+ *   Frames change sides by handing over their descriptor, not by
+ *   copying:
+ *     - PLC to port: the SPI thread passes the descriptor of a received
+ *       frame to the port's transmit function, it is never queued for
+ *       qca_recv.
+ *     - port to PLC: the port driver receives into a qca_alloc_desc
+ *       descriptor, whose headroom takes the QCA7k header, and passes
+ *       it to qca_bridge_input, which queues it with qca_send_desc.
+ *
+ *   Source MACs are learned per side in a small table; a frame whose
+ *   destination was last seen on its own side is filtered, everything
+ *   else crosses. Frames to local_mac, and with local_mme HomePlug AV
+ *   MMEs from the PLC, stay with the local host. With local_bcast
+ *   broadcast and multicast frames cross and stay, on a clone of the
+ *   descriptor that shares the buffer.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA_BRIDGE_HEADER
+#define QCA_BRIDGE_HEADER
+
+#include "qca_spi.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Learned stations, the oldest goes when full */
+#ifndef QCA_BRIDGE_MACS
+#define QCA_BRIDGE_MACS 32
+#endif
+
+/* A station not heard from for this long is forgotten */
+#ifndef QCA_BRIDGE_AGE_MS
+#define QCA_BRIDGE_AGE_MS 300000
+#endif
+
+#define QCA_BRIDGE_ETH_ALEN 6
+
+typedef enum
+{
+    QCA_BRIDGE_PLC = 0,
+    QCA_BRIDGE_PORT,
+    QCA_BRIDGE_SIDES,
+} qca_bridge_side_t;
+
+/* Takes desc on ESP_OK and frees it with qca_free_desc once sent; on an
+ * error the bridge frees it. The frame may be shared, see qca_buf.h.
+ * Called from the SPI thread. */
+typedef esp_err_t (*qca_bridge_port_tx_t)(void *ctx, NetworkBufferDescriptor_t *desc);
+
+typedef struct {
+    qca_bridge_port_tx_t port_tx;
+    void *port_ctx;
+    uint8_t local_mac[QCA_BRIDGE_ETH_ALEN]; /* Frames to it stay local, all zero for none */
+    bool local_mme;                         /* HomePlug AV MMEs from the PLC stay local */
+    bool local_bcast;                       /* Broadcast and multicast also stay local */
+} qca_bridge_config_t;
+
+/* Indexed by ingress side */
+typedef struct {
+    uint32_t forwarded[QCA_BRIDGE_SIDES];
+    uint32_t filtered[QCA_BRIDGE_SIDES]; /* Destination on the ingress side */
+    uint32_t local[QCA_BRIDGE_SIDES];    /* Left to the local host */
+    uint32_t shared[QCA_BRIDGE_SIDES];   /* Broadcast and multicast with local_bcast */
+    uint32_t dropped[QCA_BRIDGE_SIDES];  /* Egress full or out of memory */
+    uint32_t learned;
+    uint32_t moved;   /* A station showed up on the other side */
+    uint32_t evicted; /* Table full, the oldest station was forgotten */
+} qca_bridge_stats_t;
+
+/*====================================================================*
+ *
+ *   qca_bridge_start
+ *
+ *   Forget all stations and start bridging. The bridge chains itself
+ *   behind an RX hook installed before, e.g. by qca_mme_corr_init,
+ *   which sees every frame first.
+ *
+ *   Return: ESP_ERR_INVALID_ARG      No port_tx
+ *           ESP_ERR_INVALID_STATE    Already running
+ *
+ *--------------------------------------------------------------------*/
+
+esp_err_t qca_bridge_start(const qca_bridge_config_t *cfg);
+
+/* Stop bridging. Stop hooks started after the bridge first, see qca_rx_hook_t. */
+void qca_bridge_stop(void);
+
+/*====================================================================*
+ *
+ *   qca_bridge_input
+ *
+ *   Offer a frame received on the port into a qca_alloc_desc
+ *   descriptor.
+ *
+ *   Return: true if the bridge took desc, false if the frame is for the
+ *   local host and the caller keeps it.
+ *
+ *--------------------------------------------------------------------*/
+
+bool qca_bridge_input(NetworkBufferDescriptor_t *desc);
+
+void qca_bridge_get_stats(qca_bridge_stats_t *stats);
+
+#endif
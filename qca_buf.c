@@ -0,0 +1,164 @@
+/*====================================================================*
+ *
+ *   qca_buf.c
+ *
+ *   Reference counted frame buffers with head- and tailroom.
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca_buf.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define QCA_BUF_MAX (sizeof(qca_buf_t) + QCA_TX_BUF_SIZE(QCAFRM_ETHMAXLEN))
+
+static _Atomic(uint32_t) buf_bytes;
+static _Atomic(uint32_t) buf_bytes_peak;
+static _Atomic(uint32_t) buf_count;
+static _Atomic(uint32_t) buf_alloc_failures;
+
+/* Count bytes taken from the heap, keeping the peak */
+static void QCA_IRAM_ATTR qca_buf_take(uint32_t bytes)
+{
+    uint32_t now  = atomic_fetch_add_explicit(&buf_bytes, bytes, memory_order_relaxed) + bytes;
+    uint32_t peak = atomic_load_explicit(&buf_bytes_peak, memory_order_relaxed);
+
+    while (now > peak
+           && !atomic_compare_exchange_weak_explicit(&buf_bytes_peak, &peak, now, memory_order_relaxed,
+                                                     memory_order_relaxed)) {}
+}
+
+static void QCA_IRAM_ATTR qca_buf_give(uint32_t bytes)
+{
+    atomic_fetch_sub_explicit(&buf_bytes, bytes, memory_order_relaxed);
+}
+
+/* Return: the allocation size of the class that holds need bytes */
+static size_t QCA_IRAM_ATTR qca_buf_class(size_t need)
+{
+    size_t size = QCA_BUF_CLASS_MIN;
+
+    while (size < need) size <<= 1;
+    return (size > QCA_BUF_MAX) ? QCA_BUF_MAX : size;
+}
+
+bool QCA_IRAM_ATTR qca_buf_full_class(size_t len)
+{
+    return qca_buf_class(sizeof(qca_buf_t) + QCA_TX_BUF_SIZE(len)) == QCA_BUF_MAX;
+}
+
+NetworkBufferDescriptor_t *QCA_IRAM_ATTR qca_alloc_desc(size_t len)
+{
+    NetworkBufferDescriptor_t *desc;
+    qca_buf_t *buf;
+    size_t size;
+
+    if (len > QCAFRM_ETHMAXLEN)
+        return NULL;
+
+    desc = calloc(1, sizeof(NetworkBufferDescriptor_t));
+    if (desc == NULL)
+    {
+        atomic_fetch_add_explicit(&buf_alloc_failures, 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    size = qca_buf_class(sizeof(qca_buf_t) + QCA_TX_BUF_SIZE(len));
+    buf  = malloc(size);
+    if (buf == NULL)
+    {
+        atomic_fetch_add_explicit(&buf_alloc_failures, 1, memory_order_relaxed);
+        free(desc);
+        return NULL;
+    }
+
+    atomic_init(&buf->refs, 1);
+    buf->size = size - sizeof(qca_buf_t);
+    atomic_fetch_add_explicit(&buf_count, 1, memory_order_relaxed);
+    qca_buf_take(sizeof(NetworkBufferDescriptor_t) + size);
+
+    desc->pxBuffer          = buf;
+    desc->pucEthernetBuffer = buf->data + QCA_BUF_HEADROOM;
+    desc->xDataLength       = len;
+
+    return desc;
+}
+
+NetworkBufferDescriptor_t *qca_clone_desc(const NetworkBufferDescriptor_t *desc)
+{
+    NetworkBufferDescriptor_t *clone;
+
+    if (desc->pxBuffer == NULL)
+    {
+        clone = qca_alloc_desc(desc->xDataLength);
+        if (clone == NULL)
+            return NULL;
+        memcpy(clone->pucEthernetBuffer, desc->pucEthernetBuffer, desc->xDataLength);
+        clone->xEntryTime = desc->xEntryTime;
+        clone->xDoneTime  = desc->xDoneTime;
+        return clone;
+    }
+
+    clone = malloc(sizeof(NetworkBufferDescriptor_t));
+    if (clone == NULL)
+    {
+        atomic_fetch_add_explicit(&buf_alloc_failures, 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    *clone = *desc;
+    atomic_fetch_add_explicit(&desc->pxBuffer->refs, 1, memory_order_relaxed);
+    qca_buf_take(sizeof(NetworkBufferDescriptor_t));
+
+    return clone;
+}
+
+bool qca_desc_shared(const NetworkBufferDescriptor_t *desc)
+{
+    return desc->pxBuffer != NULL && atomic_load_explicit(&desc->pxBuffer->refs, memory_order_acquire) > 1;
+}
+
+size_t QCA_IRAM_ATTR qca_desc_headroom(const NetworkBufferDescriptor_t *desc)
+{
+    if (desc->pxBuffer == NULL)
+        return 0;
+    return desc->pucEthernetBuffer - desc->pxBuffer->data;
+}
+
+size_t QCA_IRAM_ATTR qca_desc_tailroom(const NetworkBufferDescriptor_t *desc)
+{
+    if (desc->pxBuffer == NULL)
+        return 0;
+    return desc->pxBuffer->size - qca_desc_headroom(desc) - desc->xDataLength;
+}
+
+void QCA_IRAM_ATTR qca_free_desc(NetworkBufferDescriptor_t *desc)
+{
+    qca_buf_t *buf = desc->pxBuffer;
+
+    /* The last holder frees, and sees every write the others made */
+    if (buf == NULL)
+    {
+        free(desc->pucEthernetBuffer);
+    }
+    else
+    {
+        qca_buf_give(sizeof(NetworkBufferDescriptor_t));
+        if (atomic_fetch_sub_explicit(&buf->refs, 1, memory_order_acq_rel) == 1)
+        {
+            qca_buf_give(sizeof(qca_buf_t) + buf->size);
+            atomic_fetch_sub_explicit(&buf_count, 1, memory_order_relaxed);
+            free(buf);
+        }
+    }
+
+    free(desc);
+}
+
+void qca_buf_get_stats(qca_buf_stats_t *stats)
+{
+    stats->bytes          = atomic_load_explicit(&buf_bytes, memory_order_relaxed);
+    stats->bytes_peak     = atomic_load_explicit(&buf_bytes_peak, memory_order_relaxed);
+    stats->buffers        = atomic_load_explicit(&buf_count, memory_order_relaxed);
+    stats->alloc_failures = atomic_load_explicit(&buf_alloc_failures, memory_order_relaxed);
+}
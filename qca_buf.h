@@ -0,0 +1,97 @@
+/*====================================================================*
+ *
+ *   qca_buf.h
+ *
+ *   Reference counted frame buffers with head- and tailroom.
+ *
+ *   A qca_buf_t holds one frame behind QCA_BUF_HEADROOM bytes and is
+ *   shared by every descriptor that points into it. Received frames
+ *   land in one, so the same bytes can be:
+ *     - handed to several consumers, each with its own descriptor from
+ *       qca_clone_desc; the frame is read only while it is shared;
+ *     - sent again with qca_send_desc, which writes the QCA7k header
+ *       and footer around the frame instead of copying it.
+ *   qca_free_desc drops one descriptor and the buffer with the last.
+ *   Descriptors without a qca_buf_t (the caller's buffer of
+ *   qca_send_async) keep their single owner.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA_BUF_HEADER
+#define QCA_BUF_HEADER
+
+#include "qca_spi.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Frame offset in a buffer: room for the QCA7k header */
+#define QCA_BUF_HEADROOM QCAFRM_HEADER_LEN
+
+/* Buffers come in size classes of QCA_BUF_CLASS_MIN << n bytes, and one
+ * that just holds a full size frame, so that freed buffers of a class
+ * fit the next ones instead of fragmenting the heap */
+#ifndef QCA_BUF_CLASS_MIN
+#define QCA_BUF_CLASS_MIN 128
+#endif
+
+/* Heap held by frames, bytes as requested from malloc */
+typedef struct {
+    uint32_t bytes;          /* Buffers and their descriptors now */
+    uint32_t bytes_peak;     /* Most bytes held at once */
+    uint32_t buffers;        /* Buffers now */
+    uint32_t alloc_failures; /* qca_alloc_desc and qca_clone_desc calls without memory */
+} qca_buf_stats_t;
+
+struct qca_buf {
+    _Atomic(uint32_t) refs; /* Descriptors pointing into data */
+    uint16_t size;         /* Bytes of data */
+    uint8_t data[];
+};
+
+/*====================================================================*
+ *
+ *   qca_alloc_desc
+ *
+ *   A descriptor on a new buffer for a frame of up to len bytes at
+ *   QCA_BUF_HEADROOM, with the tailroom qca_send_desc needs to pad
+ *   and frame it, rounded up to its size class. xDataLength is set to
+ *   len, the content is undefined.
+ *
+ *   Return: NULL when out of memory or len > QCAFRM_ETHMAXLEN.
+ *
+ *--------------------------------------------------------------------*/
+
+NetworkBufferDescriptor_t *qca_alloc_desc(size_t len);
+
+/*====================================================================*
+ *
+ *   qca_clone_desc
+ *
+ *   A second descriptor on the frame of a received or qca_alloc_desc
+ *   descriptor, sharing its buffer. A descriptor without a qca_buf_t
+ *   is copied into a new buffer instead.
+ *
+ *   Return: NULL when out of memory.
+ *
+ *--------------------------------------------------------------------*/
+
+NetworkBufferDescriptor_t *qca_clone_desc(const NetworkBufferDescriptor_t *desc);
+
+/* Other descriptors point into the buffer, the frame must not be written */
+bool qca_desc_shared(const NetworkBufferDescriptor_t *desc);
+
+/* A frame of len bytes needs a buffer of the full size class */
+bool qca_buf_full_class(size_t len);
+
+/* Bytes in front of and behind the frame, 0 without a qca_buf_t */
+size_t qca_desc_headroom(const NetworkBufferDescriptor_t *desc);
+size_t qca_desc_tailroom(const NetworkBufferDescriptor_t *desc);
+
+/* Free the descriptor and, with the last reference, its buffer */
+void qca_free_desc(NetworkBufferDescriptor_t *desc);
+
+/* Frame memory so far. Descriptors without a qca_buf_t are not counted. */
+void qca_buf_get_stats(qca_buf_stats_t *stats);
+
+#endif
@@ -0,0 +1,46 @@
+/*====================================================================*
+ *
+ *   qca_bus.h
+ *
+ *   SPI transport under qca_7k.c and qca_spi.c.
+ *
+ *   Every QCA7000 SPI transaction is a 16 bit command followed by data
+ *   in one direction. A transport runs a batch of them back to back,
+ *   each under its own chip select, so e.g. the buffer size write and
+ *   the burst read behind it cost one call: ESP-IDF through
+ *   spi_device_transmit (qca_bus_esp.c), Linux spidev through a single
+ *   SPI_IOC_MESSAGE ioctl (linux/qca_linux.c).
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA_BUS_HEADER
+#define QCA_BUS_HEADER
+
+#include "driver/spi_master.h"
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#include "qca_iram.h"
+
+/* Longest batch the driver issues */
+#define QCA_BUS_MAX_BATCH 2
+
+typedef struct {
+    uint16_t cmd;
+    const void *tx; /* len bytes written after the command, or NULL */
+    void *rx;       /* len bytes read after the command, or NULL */
+    uint16_t len;
+} qca_bus_xfer_t;
+
+typedef esp_err_t (*qca_bus_xfer_fn_t)(void *ctx, const qca_bus_xfer_t *xfers, size_t n);
+
+typedef struct {
+    qca_bus_xfer_fn_t xfer;
+    void *ctx;
+} qca_bus_t;
+
+/* ESP-IDF transport, ctx is the spi_device_handle_t */
+esp_err_t qca_bus_esp_xfer(void *ctx, const qca_bus_xfer_t *xfers, size_t n);
+
+#endif
@@ -0,0 +1,32 @@
+/*====================================================================*
+ *
+ *   qca_bus_esp.c
+ *
+ *   ESP-IDF SPI master transport.
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca_bus.h"
+
+esp_err_t QCA_IRAM_ATTR qca_bus_esp_xfer(void *ctx, const qca_bus_xfer_t *xfers, size_t n)
+{
+    spi_device_handle_t handle = (spi_device_handle_t)ctx;
+    esp_err_t err              = ESP_OK;
+    size_t i;
+
+    for (i = 0; i < n && err == ESP_OK; i++)
+    {
+        spi_transaction_t t = {0};
+
+        /* Half duplex: the data phase either writes or reads */
+        t.cmd       = xfers[i].cmd;
+        t.length    = xfers[i].tx ? xfers[i].len * 8 : 0;
+        t.tx_buffer = xfers[i].tx;
+        t.rxlength  = xfers[i].rx ? xfers[i].len * 8 : 0;
+        t.rx_buffer = xfers[i].rx;
+
+        err = spi_device_transmit(handle, &t);
+    }
+
+    return err;
+}
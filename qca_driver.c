@@ -8,34 +8,233 @@ qcaspi_t qca = {0};
 extern void qcaspi_spi_thread(void *data);
 extern void qca_network_thread(void *data);
 static void qca_reset(void);
-static void qca_wait_sync(void);
+static void qca_reset_release(void *arg);
 
-void qca_send(void *data, size_t len)
+static NetworkBufferDescriptor_t *qca_tx_desc_create(const void *data, size_t len)
 {
-    if (len < QCAFRM_ETHMINLEN)
-        len = QCAFRM_ETHMINLEN;
+    size_t frame_len = (len < QCAFRM_ETHMINLEN) ? QCAFRM_ETHMINLEN : len;
 
-    NetworkBufferDescriptor_t *txDesc = NULL;
-    txDesc                            = malloc(sizeof(NetworkBufferDescriptor_t));
-    txDesc->pucEthernetBuffer         = malloc(len + QCAFRM_FRAME_OVERHEAD);
-    txDesc->xDataLength               = len;
+    NetworkBufferDescriptor_t *txDesc = qca_alloc_desc(frame_len);
+    if (txDesc == NULL)
+        return NULL;
+
+    /* TX descriptors point at the QCA7k header, which goes into the headroom */
+    txDesc->pucEthernetBuffer -= QCAFRM_HEADER_LEN;
+
+    txDesc->xEntryTime = esp_timer_get_time();
     memcpy(txDesc->pucEthernetBuffer + QCAFRM_HEADER_LEN, data, len);
+    memset(txDesc->pucEthernetBuffer + QCAFRM_HEADER_LEN + len, 0, frame_len - len);
+
+    return txDesc;
+}
+
+static size_t QCA_IRAM_ATTR qca_tx_push(NetworkBufferDescriptor_t **txDesc, size_t n)
+{
+    bool was_empty;
+
+#if QCASPI_TX_MULTI_PRODUCER
+    portENTER_CRITICAL(&qca.tx_lock);
+#endif
+    n = qca_ring_push_n(&qca.txRing, (void *const *)txDesc, n, &was_empty);
+#if QCASPI_TX_MULTI_PRODUCER
+    portEXIT_CRITICAL(&qca.tx_lock);
+#endif
+
+    /* The SPI thread drains the ring on every wakeup, so it only needs a
+     * kick when the ring goes from empty to non-empty */
+    if (was_empty)
+        xTaskNotify(qca.task_handle, QCAGP_TX_FLAG, eSetBits);
+
+    return n;
+}
+
+esp_err_t qca_send(void *data, size_t len)
+{
+    return qca_send_deadline(data, len, 0);
+}
+
+esp_err_t qca_send_deadline(void *data, size_t len, int64_t deadline)
+{
+    if (len > QCAFRM_ETHMAXLEN)
+        return ESP_ERR_INVALID_SIZE;
+
+    NetworkBufferDescriptor_t *txDesc = qca_tx_desc_create(data, len);
 
     if (qca.task_handle == NULL)
         ESP_LOGE(TAG, "Task Handle NULL");
 
-    xQueueSend(qca.txQueue, &txDesc, 0);
-    xTaskNotify(qca.task_handle, QCAGP_TX_FLAG, eSetBits);
+    if (txDesc == NULL)
+    {
+        qca.stats.tx_errors++;
+        return ESP_ERR_NO_MEM;
+    }
+
+    txDesc->xDeadline = deadline;
+    if (qca_tx_push(&txDesc, 1) != 1)
+    {
+        qca.stats.tx_dropped++;
+        qca_free_desc(txDesc);
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t qca_send_async(uint8_t *buf, size_t len, qca_tx_complete_cb_t on_complete, void *ctx)
+{
+    if (buf == NULL || on_complete == NULL || len > QCAFRM_ETHMAXLEN)
+        return ESP_ERR_INVALID_ARG;
+
+    NetworkBufferDescriptor_t *txDesc = calloc(1, sizeof(NetworkBufferDescriptor_t));
+    if (txDesc == NULL)
+    {
+        qca.stats.tx_errors++;
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* Short frames are padded in place by qcaspi_tx_frame, see QCA_TX_BUF_SIZE */
+    txDesc->pucEthernetBuffer = buf;
+    txDesc->xDataLength       = len;
+    txDesc->xEntryTime        = esp_timer_get_time();
+    txDesc->pxTxComplete      = on_complete;
+    txDesc->pvTxContext       = ctx;
+
+    /* Ring full: hand the buffer straight back, the caller decides whether to retry */
+    if (qca_tx_push(&txDesc, 1) != 1)
+    {
+        qca.stats.tx_dropped++;
+        free(txDesc);
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t qca_send_desc(NetworkBufferDescriptor_t *desc)
+{
+    size_t len = desc->xDataLength;
+
+    if (len > QCAFRM_ETHMAXLEN)
+        return ESP_ERR_INVALID_SIZE;
+
+    /* A static descriptor's buffer is laid out as the one of qca_send_async,
+     * QCA_TX_BUF_SIZE(len) bytes from the QCA7k header on */
+    if (desc->xStatic)
+    {
+        if (desc->pxTxComplete == NULL)
+            return ESP_ERR_INVALID_ARG;
+    }
+    else
+    {
+        if (qca_desc_headroom(desc) < QCAFRM_HEADER_LEN
+            || qca_desc_tailroom(desc) + len + QCAFRM_HEADER_LEN < QCA_TX_BUF_SIZE(len))
+            return ESP_ERR_INVALID_SIZE;
+        desc->pxTxComplete = NULL;
+        desc->pvTxContext  = NULL;
+    }
+
+    /* TX descriptors point at the QCA7k header, which goes into the headroom */
+    desc->pucEthernetBuffer -= QCAFRM_HEADER_LEN;
+
+    desc->xEntryTime = esp_timer_get_time();
+    desc->xDeadline  = 0;
+
+    if (qca_tx_push(&desc, 1) != 1)
+    {
+        desc->pucEthernetBuffer += QCAFRM_HEADER_LEN;
+        qca.stats.tx_dropped++;
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+size_t qca_send_batch(const qca_frame_t *frames, size_t n)
+{
+    NetworkBufferDescriptor_t *txDesc[QCASPI_TX_RING_DEPTH];
+    size_t i;
+
+    /* Only take what fits, so no descriptor is left behind on a full ring.
+     * Not under tx_lock, so only an estimate: qca_tx_push frees the rest. */
+    uint32_t space = qca_ring_free(&qca.txRing);
+    if (n > space)
+        n = space;
+
+    for (i = 0; i < n; i++)
+    {
+        if (frames[i].len > QCAFRM_ETHMAXLEN || (txDesc[i] = qca_tx_desc_create(frames[i].data, frames[i].len)) == NULL)
+            break;
+    }
+    n = i;
+
+    /* One ring update and at most one wakeup for the whole batch */
+    size_t sent = qca_tx_push(txDesc, n);
+
+    for (i = sent; i < n; i++) qca_free_desc(txDesc[i]);
+
+    return sent;
+}
+
+size_t QCA_IRAM_ATTR qca_recv_batch(NetworkBufferDescriptor_t **descs, size_t max, TickType_t timeout)
+{
+    TickType_t start = xTaskGetTickCount();
+    TickType_t waited;
+    uint32_t n;
+
+    for (;;)
+    {
+        n = qca_ring_pop_n(&qca.rxRing, (void **)descs, max);
+        if (n || max == 0)
+            return n;
+
+        /* Publish ourselves before the re-check, so a frame pushed in between
+         * either shows up here or sees the waiter and notifies us */
+        atomic_store(&qca.rx_waiter, xTaskGetCurrentTaskHandle());
+        n = qca_ring_pop_n(&qca.rxRing, (void **)descs, max);
+        if (n)
+        {
+            atomic_store(&qca.rx_waiter, NULL);
+            return n;
+        }
+
+        waited = xTaskGetTickCount() - start;
+        if (timeout != portMAX_DELAY && waited >= timeout)
+        {
+            atomic_store(&qca.rx_waiter, NULL);
+            return 0;
+        }
+
+        ulTaskNotifyTake(pdTRUE, timeout == portMAX_DELAY ? portMAX_DELAY : timeout - waited);
+        atomic_store(&qca.rx_waiter, NULL);
+    }
+}
+
+NetworkBufferDescriptor_t *qca_recv(TickType_t timeout)
+{
+    NetworkBufferDescriptor_t *rxDesc = NULL;
+
+    qca_recv_batch(&rxDesc, 1, timeout);
+    return rxDesc;
+}
+
+void qca_set_tx_report_cb(qca_tx_report_cb_t cb)
+{
+    qca.tx_report_cb = cb;
 }
 
 static void IRAM_ATTR qca_irq_handler(void *arg)
 {
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    int64_t now                         = esp_timer_get_time();
+
+    portENTER_CRITICAL_ISR(&qca.irq_lock);
+    qca.irq_time = now;
+    portEXIT_CRITICAL_ISR(&qca.irq_lock);
     xTaskNotifyFromISR(qca.task_handle, QCAGP_INT_FLAG, eSetBits, &xHigherPriorityTaskWoken);
     portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
 
-void qca_ll_init(void)
+esp_err_t qca_ll_init_async(qca_ready_cb_t cb, void *ctx)
 {
     spi_bus_config_t qca_bus = {
         .miso_io_num     = QCASPI_MISO,
@@ -43,7 +242,7 @@ void qca_ll_init(void)
         .sclk_io_num     = QCASPI_SCLK,
         .quadwp_io_num   = -1,
         .quadhd_io_num   = -1,
-        .max_transfer_sz = 2048,
+        .max_transfer_sz = QCASPI_MAX_TRANSFER_SZ,
     };
 
     spi_device_interface_config_t qca_dev = {
@@ -55,8 +254,18 @@ void qca_ll_init(void)
         .flags          = SPI_DEVICE_HALFDUPLEX,
     };
 
+    const esp_timer_create_args_t reset_timer_args = {
+        .callback        = qca_reset_release,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name            = "qca_reset",
+    };
+
+    qca.boot.init = esp_timer_get_time();
+
     ESP_ERROR_CHECK(spi_bus_initialize(SPI2_HOST, &qca_bus, SPI_DMA_CH_AUTO));
     ESP_ERROR_CHECK(spi_bus_add_device(SPI2_HOST, &qca_dev, &qca.handle));
+    qca.bus.xfer = qca_bus_esp_xfer;
+    qca.bus.ctx  = qca.handle;
 
     gpio_config_t io_conf = {0};
     io_conf.intr_type     = GPIO_INTR_POSEDGE;
@@ -67,37 +276,139 @@ void qca_ll_init(void)
 
     gpio_config(&io_conf);
 
-    gpio_install_isr_service(0);
+    gpio_install_isr_service(QCA_INTR_FLAGS);
 
-    qca.sync    = QCASPI_SYNC_UNKNOWN;
-    qca.txQueue = xQueueCreate(25, sizeof(NetworkBufferDescriptor_t *));
-    qca.rxQueue = xQueueCreate(25, sizeof(NetworkBufferDescriptor_t *));
-    QcaFrmFsmInit(&qca.lFrmHdl);
+    qca.sync      = QCASPI_SYNC_UNKNOWN;
+    qca.ready_cb  = cb;
+    qca.ready_ctx = ctx;
+    qca.events    = xEventGroupCreate();
+    if (qca.events == NULL)
+        return ESP_ERR_NO_MEM;
+    ESP_ERROR_CHECK(qca_ring_init(&qca.txRing, QCASPI_TX_RING_DEPTH) ? ESP_OK : ESP_ERR_NO_MEM);
+    ESP_ERROR_CHECK(qca_ring_init(&qca.rxRing, QCASPI_RX_RING_DEPTH) ? ESP_OK : ESP_ERR_NO_MEM);
+#if QCASPI_TX_MULTI_PRODUCER
+    portMUX_INITIALIZE(&qca.tx_lock);
+#endif
+    portMUX_INITIALIZE(&qca.irq_lock);
+    QcaFrmFsmInitSpi(&qca.lFrmHdl);
+    ESP_ERROR_CHECK(esp_timer_create(&reset_timer_args, &qca.reset_timer));
 
-    /* QCA7000 reset pin setup */
+    /* QCA7000 reset pin setup, held in reset until the ISR is in place */
     gpio_reset_pin(QCASPI_RST);
     gpio_set_direction(QCASPI_RST, GPIO_MODE_OUTPUT);
     qca_reset();
 
     ESP_LOGI(TAG, "QCA Driver Init Success.");
-    xTaskCreatePinnedToCore(qcaspi_spi_thread, "qca_spi", 4096, &qca, tskIDLE_PRIORITY + 10, &qca.task_handle,
-                            APP_CPU_NUM);
-    xTaskCreatePinnedToCore(qca_network_thread, "qca_network", 4096, &qca, tskIDLE_PRIORITY + 8, NULL, APP_CPU_NUM);
+    qca_task_create(qcaspi_spi_thread, "qca_spi", QCASPI_STACK_SIZE, tskIDLE_PRIORITY + 10, &qca.task_handle);
+    qca_task_create(qca_network_thread, "qca_network", QCA_NETWORK_STACK_SIZE, tskIDLE_PRIORITY + 8, NULL);
 
+    /* The SPI thread exists, so the CPU_ON interrupt after reset cannot be missed */
     gpio_isr_handler_add(QCASPI_INT, qca_irq_handler, NULL);
+
+    /* Released from the esp_timer task, nobody waits for it */
+    ESP_ERROR_CHECK(esp_timer_start_once(qca.reset_timer, QCASPI_RESET_HOLD_MS * 1000));
+
+    return ESP_OK;
+}
+
+void qca_ll_init(void)
+{
+    ESP_ERROR_CHECK(qca_ll_init_async(NULL, NULL));
     /* Wait for sync. */
-    qca_wait_sync();
+    qca_wait_ready(portMAX_DELAY);
     ESP_LOGI(TAG, "QCA Driver Sync.");
 }
 
-void qca_reset(void)
+bool qca_wait_ready(TickType_t timeout)
+{
+    return xEventGroupWaitBits(qca.events, QCASPI_EVT_READY, pdFALSE, pdTRUE, timeout) & QCASPI_EVT_READY;
+}
+
+const qca_boot_times_t *qca_get_boot_times(void)
+{
+    return &qca.boot;
+}
+
+const qca_stats_t *qca_get_stats(void)
+{
+    return &qca.stats;
+}
+
+/*====================================================================*
+ *
+ *   qca_task_create
+ *
+ *   Start a driver task on the application core with &qca as its
+ *   argument, and keep it for qca_get_resource_report.
+ *
+ *--------------------------------------------------------------------*/
+
+BaseType_t qca_task_create(TaskFunction_t fn, const char *name, uint32_t stack_size, UBaseType_t prio,
+                           TaskHandle_t *handle)
+{
+    qca_task_t *task = NULL;
+    TaskHandle_t created;
+    BaseType_t ret;
+    int i;
+
+    for (i = 0; i < QCA_TASKS && task == NULL; i++)
+        if (qca.tasks[i].name == NULL)
+            task = &qca.tasks[i];
+
+    /* The caller's handle is set before the task runs, as by FreeRTOS */
+    if (handle == NULL)
+        handle = &created;
+
+    ret = xTaskCreatePinnedToCore(fn, name, stack_size, &qca, prio, handle, APP_CPU_NUM);
+    if (ret == pdPASS && task != NULL)
+    {
+        task->name       = name;
+        task->handle     = *handle;
+        task->stack_size = stack_size;
+    }
+    return ret;
+}
+
+static void qca_ring_report(qca_ring_t *ring, qca_ring_report_t *report)
+{
+    report->depth = qca_ring_depth(ring);
+    report->count = qca_ring_count(ring);
+    report->peak  = ring->peak;
+}
+
+void qca_get_resource_report(qca_resource_report_t *report)
+{
+    int i;
+
+    memset(report, 0, sizeof(*report));
+
+    for (i = 0; i < QCA_TASKS; i++)
+    {
+        if (qca.tasks[i].name == NULL)
+            continue;
+        report->tasks[i].name       = qca.tasks[i].name;
+        report->tasks[i].stack_size = qca.tasks[i].stack_size;
+        report->tasks[i].stack_free = uxTaskGetStackHighWaterMark(qca.tasks[i].handle);
+    }
+
+    qca_ring_report(&qca.txRing, &report->tx_ring);
+    qca_ring_report(&qca.rxRing, &report->rx_ring);
+    qca_buf_get_stats(&report->frames);
+
+    report->fixed_bytes = sizeof(qca) + (report->tx_ring.depth + report->rx_ring.depth) * sizeof(void *);
+    if (qca.handle != NULL)
+        report->xfer_size = QCASPI_MAX_TRANSFER_SZ;
+    report->xfer_peak = qca.spi_xfer_peak;
+}
+
+static void qca_reset(void)
 {
     gpio_set_level(QCASPI_RST, 0);
-    vTaskDelay(100);
-    gpio_set_level(QCASPI_RST, 1);
+    qca.boot.reset_asserted = esp_timer_get_time();
 }
 
-void qca_wait_sync(void)
+static void qca_reset_release(void *arg)
 {
-    while (qca.sync != QCASPI_SYNC_READY) { vTaskDelay(pdMS_TO_TICKS(500)); }
+    gpio_set_level(QCASPI_RST, 1);
+    qca.boot.reset_released = esp_timer_get_time();
 }
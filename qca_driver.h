@@ -4,10 +4,12 @@
 #include "driver/spi_master.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
 #include "freertos/queue.h"
 #include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "qca_7k.h"
+#include "qca_buf.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -21,8 +23,71 @@
 #define QCASPI_INT       GPIO_NUM_9
 #define QCASPI_CLK_SPEED 12000000
 
+/* How long the QCA7000 is held in reset at start up */
+#ifndef QCASPI_RESET_HOLD_MS
+#define QCASPI_RESET_HOLD_MS 100
+#endif
+
+/* Largest SPI transfer the bus is set up for, the DMA descriptors
+ * ESP-IDF reserves cover this many bytes */
+#ifndef QCASPI_MAX_TRANSFER_SZ
+#define QCASPI_MAX_TRANSFER_SZ 2048
+#endif
+
+/* Task stacks in bytes, qca_get_resource_report shows what they use */
+#ifndef QCASPI_STACK_SIZE
+#define QCASPI_STACK_SIZE 4096
+#endif
+#ifndef QCA_NETWORK_STACK_SIZE
+#define QCA_NETWORK_STACK_SIZE 4096
+#endif
+
+/* One frame of a qca_send_batch() call, copied into a new TX descriptor */
+typedef struct {
+    const void *data;
+    size_t len;
+} qca_frame_t;
+
+/* Stack use of a driver task */
+typedef struct {
+    const char *name;    /* NULL for unused entries */
+    uint32_t stack_size; /* Bytes given at creation */
+    uint32_t stack_free; /* Fewest bytes left unused so far */
+} qca_task_report_t;
+
+/* Fill of a descriptor ring */
+typedef struct {
+    uint32_t depth;
+    uint32_t count; /* Entries now */
+    uint32_t peak;  /* Most entries so far */
+} qca_ring_report_t;
+
+typedef struct {
+    qca_task_report_t tasks[QCA_TASKS];
+    qca_ring_report_t tx_ring;
+    qca_ring_report_t rx_ring;
+    qca_buf_stats_t frames; /* Frames in flight, anywhere between qca_send and qca_recv callers */
+    uint32_t fixed_bytes;   /* Driver state and ring slots, allocated once */
+    uint32_t xfer_size;     /* QCASPI_MAX_TRANSFER_SZ, 0 on the UART */
+    uint32_t xfer_peak;     /* Longest SPI burst so far */
+} qca_resource_report_t;
+
 extern qcaspi_t qca;
 
 void qca_ll_init(void);
-void qca_send(void *data, size_t len);
+esp_err_t qca_ll_init_async(qca_ready_cb_t cb, void *ctx);
+bool qca_wait_ready(TickType_t timeout);
+const qca_boot_times_t *qca_get_boot_times(void);
+const qca_stats_t *qca_get_stats(void);
+void qca_get_resource_report(qca_resource_report_t *report);
+BaseType_t qca_task_create(TaskFunction_t fn, const char *name, uint32_t stack_size, UBaseType_t prio,
+                           TaskHandle_t *handle);
+esp_err_t qca_send(void *data, size_t len);
+esp_err_t qca_send_deadline(void *data, size_t len, int64_t deadline);
+esp_err_t qca_send_async(uint8_t *buf, size_t len, qca_tx_complete_cb_t on_complete, void *ctx);
+esp_err_t qca_send_desc(NetworkBufferDescriptor_t *desc);
+size_t qca_send_batch(const qca_frame_t *frames, size_t n);
+size_t qca_recv_batch(NetworkBufferDescriptor_t **descs, size_t max, TickType_t timeout);
+NetworkBufferDescriptor_t *qca_recv(TickType_t timeout);
+void qca_set_tx_report_cb(qca_tx_report_cb_t cb);
 void qca_network_thread(void *data);
@@ -0,0 +1,284 @@
+/*====================================================================*
+ *
+ *   qca_frame.hpp
+ *
+ *   Header only C++ layer over the driver's descriptor API.
+ *
+ *   qca::Frame owns one NetworkBufferDescriptor_t and frees it, buffer
+ *   and all, when it goes out of scope. It is moved, never copied, and
+ *   is exactly one pointer, so handing it around costs what passing the
+ *   descriptor did. Sharing a frame is explicit: share() clones the
+ *   descriptor onto the same reference counted buffer (qca_buf.h).
+ *
+ *   qca::Link receives into and sends from Frames, moving ownership
+ *   across without copies: a received frame goes back out through the
+ *   headroom of its own buffer.
+ *
+ *   qca::eth and qca::mme read header fields straight from a frame's
+ *   bytes; they are constexpr and compile to plain loads.
+ *
+ *   Needs C++20 for std::span and C++23 (gnu++2b) for <stdatomic.h>,
+ *   which the C headers of the driver include.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA_FRAME_HPP
+#define QCA_FRAME_HPP
+
+#include <stdatomic.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+/* The C headers assert their layouts with C11's keyword */
+#ifndef _Static_assert
+#define _Static_assert static_assert
+#define QCA_FRAME_STATIC_ASSERT
+#endif
+
+/* The driver state is named like the namespace, C++ code reads it
+ * through qca_get_stats and qca_get_boot_times */
+#define qca qca_driver_state
+extern "C" {
+#include "qca_driver.h"
+#include "qca_mme.h"
+}
+#undef qca
+
+#ifdef QCA_FRAME_STATIC_ASSERT
+#undef _Static_assert
+#undef QCA_FRAME_STATIC_ASSERT
+#endif
+
+namespace qca
+{
+
+using Bytes        = std::span<const uint8_t>;
+using MutableBytes = std::span<uint8_t>;
+
+/*====================================================================*
+ *   Ethernet header;
+ *--------------------------------------------------------------------*/
+
+namespace eth
+{
+
+inline constexpr size_t alen = 6;
+inline constexpr size_t hlen = ETH_HLEN;
+
+/* All accessors expect at least hlen bytes */
+constexpr std::span<const uint8_t, alen> dest(Bytes f)
+{
+    return f.first<alen>();
+}
+
+constexpr std::span<const uint8_t, alen> src(Bytes f)
+{
+    return f.subspan<alen, alen>();
+}
+
+constexpr uint16_t ethertype(Bytes f)
+{
+    return static_cast<uint16_t>((f[12] << 8) | f[13]);
+}
+
+constexpr bool is_multicast(Bytes f)
+{
+    return (f[0] & 0x01) != 0;
+}
+
+constexpr bool is_broadcast(Bytes f)
+{
+    return (f[0] & f[1] & f[2] & f[3] & f[4] & f[5]) == 0xFF;
+}
+
+constexpr Bytes payload(Bytes f)
+{
+    return f.subspan(hlen);
+}
+
+} // namespace eth
+
+/*====================================================================*
+ *   HomePlug AV MME header;
+ *--------------------------------------------------------------------*/
+
+namespace mme
+{
+
+inline constexpr size_t hlen = sizeof(qca_mme_hdr_t);
+
+constexpr bool is_mme(Bytes f)
+{
+    return f.size() >= hlen && eth::ethertype(f) == QCA_MME_ETHERTYPE;
+}
+
+/* The rest expect is_mme(f) */
+constexpr uint8_t mmv(Bytes f)
+{
+    return f[14];
+}
+
+/* MMTYPE is little endian on the wire */
+constexpr uint16_t mmtype(Bytes f)
+{
+    return static_cast<uint16_t>(f[15] | (f[16] << 8));
+}
+
+constexpr uint16_t base(uint16_t mmtype)
+{
+    return mmtype & static_cast<uint16_t>(~QCA_MMTYPE_MODE);
+}
+
+constexpr uint16_t mode(uint16_t mmtype)
+{
+    return mmtype & QCA_MMTYPE_MODE;
+}
+
+/* The frame as message layout T if it is an MME of that MMTYPE and long
+ * enough, in place as qca_mme_parse; nullptr otherwise */
+template <typename T>
+const T *as(Bytes f, uint16_t type)
+{
+    if (f.size() < sizeof(T) || !is_mme(f) || mmtype(f) != type)
+        return nullptr;
+    return reinterpret_cast<const T *>(f.data());
+}
+
+} // namespace mme
+
+/*====================================================================*
+ *
+ *   Frame
+ *
+ *   Owns one descriptor. Received and allocated frames sit in a
+ *   reference counted buffer with QCA7k headroom, see qca_buf.h.
+ *
+ *--------------------------------------------------------------------*/
+
+class Frame
+{
+  public:
+    constexpr Frame() noexcept = default;
+
+    /* Take over desc, which may be NULL */
+    explicit constexpr Frame(NetworkBufferDescriptor_t *desc) noexcept : desc_(desc) {}
+
+    Frame(Frame &&other) noexcept : desc_(std::exchange(other.desc_, nullptr)) {}
+
+    Frame &operator=(Frame &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            desc_ = std::exchange(other.desc_, nullptr);
+        }
+        return *this;
+    }
+
+    Frame(const Frame &)            = delete;
+    Frame &operator=(const Frame &) = delete;
+
+    ~Frame() { reset(); }
+
+    /* A frame of len bytes to fill and send, empty when out of memory */
+    static Frame alloc(size_t len) noexcept { return Frame(qca_alloc_desc(len)); }
+
+    /* A second handle on the same bytes, read only while both live; a
+     * frame without a shared buffer is copied. Empty when out of memory. */
+    Frame share() const noexcept { return Frame(desc_ != nullptr ? qca_clone_desc(desc_) : nullptr); }
+
+    explicit operator bool() const noexcept { return desc_ != nullptr; }
+    bool shared() const noexcept { return qca_desc_shared(desc_); }
+
+    Bytes bytes() const noexcept { return {desc_->pucEthernetBuffer, desc_->xDataLength}; }
+
+    /* Writable only while not shared() */
+    MutableBytes data() noexcept { return {desc_->pucEthernetBuffer, desc_->xDataLength}; }
+
+    size_t size() const noexcept { return desc_->xDataLength; }
+
+    /* Shorten, or grow into the tailroom. Return: false if it does not fit */
+    bool resize(size_t len) noexcept
+    {
+        if (len > desc_->xDataLength + qca_desc_tailroom(desc_))
+            return false;
+        desc_->xDataLength = len;
+        return true;
+    }
+
+    /* RX: qca_irq_handler entry and decode, esp_timer us */
+    int64_t entry_time() const noexcept { return desc_->xEntryTime; }
+    int64_t done_time() const noexcept { return desc_->xDoneTime; }
+
+    NetworkBufferDescriptor_t *get() const noexcept { return desc_; }
+
+    /* Give up ownership, the caller frees with qca_free_desc */
+    NetworkBufferDescriptor_t *release() noexcept { return std::exchange(desc_, nullptr); }
+
+    void reset(NetworkBufferDescriptor_t *desc = nullptr) noexcept
+    {
+        if (NetworkBufferDescriptor_t *old = std::exchange(desc_, desc))
+            qca_free_desc(old);
+    }
+
+  private:
+    NetworkBufferDescriptor_t *desc_ = nullptr;
+};
+
+static_assert(sizeof(Frame) == sizeof(NetworkBufferDescriptor_t *), "Frame must stay a bare pointer");
+
+/*====================================================================*
+ *
+ *   Link
+ *
+ *   The PLC link as driven by qca_ll_init or qca_uart_init.
+ *
+ *--------------------------------------------------------------------*/
+
+class Link
+{
+  public:
+    static bool wait_ready(TickType_t timeout = portMAX_DELAY) noexcept { return qca_wait_ready(timeout); }
+
+    /* Empty on timeout */
+    static Frame recv(TickType_t timeout = portMAX_DELAY) noexcept { return Frame(qca_recv(timeout)); }
+
+    /* Up to out.size() frames. Return: how many, 0 on timeout */
+    static size_t recv(std::span<Frame> out, TickType_t timeout = portMAX_DELAY) noexcept
+    {
+        NetworkBufferDescriptor_t *descs[QCASPI_RX_RING_DEPTH];
+        size_t n = qca_recv_batch(descs, out.size() < QCASPI_RX_RING_DEPTH ? out.size() : QCASPI_RX_RING_DEPTH,
+                                  timeout);
+
+        for (size_t i = 0; i < n; i++) out[i].reset(descs[i]);
+        return n;
+    }
+
+    /* Send the frame in place, the driver frees it once written. On an
+     * error, e.g. ESP_ERR_NO_MEM on a full TX ring, f keeps it. */
+    static esp_err_t send(Frame &&f) noexcept
+    {
+        if (!f)
+            return ESP_ERR_INVALID_ARG;
+
+        esp_err_t err = qca_send_desc(f.get());
+        if (err == ESP_OK)
+            f.release();
+        return err;
+    }
+
+    /* Send a copy of bytes */
+    static esp_err_t send(Bytes bytes) noexcept
+    {
+        return qca_send(const_cast<uint8_t *>(bytes.data()), bytes.size());
+    }
+
+    static const qca_stats_t &stats() noexcept { return *qca_get_stats(); }
+};
+
+} // namespace qca
+
+#endif
@@ -9,6 +9,7 @@
 
 #include "qca_framing.h"
 #include "byte_order.h"
+#include <string.h>
 
 /*====================================================================*
  *
@@ -20,7 +21,7 @@
  *
  *--------------------------------------------------------------------*/
 
-int32_t QcaFrmCreateHeader(uint8_t *buf, uint16_t len)
+int32_t QCA_IRAM_ATTR QcaFrmCreateHeader(uint8_t *buf, uint16_t len)
 {
     len = __cpu_to_le16(len);
 
@@ -46,13 +47,38 @@ int32_t QcaFrmCreateHeader(uint8_t *buf, uint16_t len)
  *
  *--------------------------------------------------------------------*/
 
-int32_t QcaFrmCreateFooter(uint8_t *buf)
+int32_t QCA_IRAM_ATTR QcaFrmCreateFooter(uint8_t *buf)
 {
     buf[0] = 0x55;
     buf[1] = 0x55;
     return QCAFRM_FOOTER_LEN;
 }
 
+/*====================================================================*
+ *
+ *   QcaFrmEncapsulate
+ *
+ *   Pads a frame to the Ethernet minimum and frames it for the QCA7K.
+ *
+ *   Return: The frame length after padding.
+ *
+ *--------------------------------------------------------------------*/
+
+uint16_t QCA_IRAM_ATTR QcaFrmEncapsulate(uint8_t *buf, uint16_t len)
+{
+    /* The frame starts behind the QCA7k header */
+    if (len < QCAFRM_ETHMINLEN)
+    {
+        memset(buf + QCAFRM_HEADER_LEN + len, 0, QCAFRM_ETHMINLEN - len);
+        len = QCAFRM_ETHMINLEN;
+    }
+
+    QcaFrmCreateHeader(buf, len);
+    QcaFrmCreateFooter(buf + QCAFRM_HEADER_LEN + len);
+
+    return len;
+}
+
 /*====================================================================*
  *
  *   QcaFrmAddQID
@@ -63,7 +89,7 @@ int32_t QcaFrmCreateFooter(uint8_t *buf)
  *
  *--------------------------------------------------------------------*/
 
-int32_t QcaFrmAddQID(uint8_t *buf, uint8_t qid)
+int32_t QCA_IRAM_ATTR QcaFrmAddQID(uint8_t *buf, uint8_t qid)
 {
     buf[0] = 0x00;
     buf[1] = qid;
@@ -80,17 +106,34 @@ int32_t QcaFrmAddQID(uint8_t *buf, uint8_t qid)
 
 void QcaFrmFsmInit(QcaFrmHdl *frmHdl)
 {
-    frmHdl->state  = QCAFRM_WAIT_AA1;
+    frmHdl->init   = QCAFRM_WAIT_AA1;
+    frmHdl->state  = frmHdl->init;
+    frmHdl->offset = 0;
+    frmHdl->len    = 0;
+}
+
+void QcaFrmFsmInitSpi(QcaFrmHdl *frmHdl)
+{
+    frmHdl->init   = QCAFRM_HW_LEN0;
+    frmHdl->state  = frmHdl->init;
     frmHdl->offset = 0;
     frmHdl->len    = 0;
 }
 
-uint16_t QcaFrmBytesRequired(QcaFrmHdl *frmHdl)
+uint16_t QCA_IRAM_ATTR QcaFrmBytesRequired(QcaFrmHdl *frmHdl)
 {
     switch (frmHdl->state)
     {
-    case QCAFRM_WAIT_AA1:
+    case QCAFRM_HW_LEN0:
         return QCAFRM_TOTAL_HEADER_LEN;
+    case QCAFRM_HW_LEN1:
+        return QCAFRM_TOTAL_HEADER_LEN - 1;
+    case QCAFRM_HW_LEN2:
+        return QCAFRM_TOTAL_HEADER_LEN - 2;
+    case QCAFRM_HW_LEN3:
+        return QCAFRM_TOTAL_HEADER_LEN - 3;
+    case QCAFRM_WAIT_AA1:
+        return QCAFRM_HEADER_LEN;
     case QCAFRM_WAIT_AA2:
         return QCAFRM_HEADER_LEN - 1;
     case QCAFRM_WAIT_AA3:
@@ -120,6 +163,10 @@ QcaFrmAction QcaFrmGetAction(QcaFrmHdl *frmHdl)
 {
     switch (frmHdl->state)
     {
+    case QCAFRM_HW_LEN0:
+    case QCAFRM_HW_LEN1:
+    case QCAFRM_HW_LEN2:
+    case QCAFRM_HW_LEN3:
     case QCAFRM_WAIT_AA1:
     case QCAFRM_WAIT_AA2:
     case QCAFRM_WAIT_AA3:
@@ -153,12 +200,30 @@ QcaFrmAction QcaFrmGetAction(QcaFrmHdl *frmHdl)
  *
  *--------------------------------------------------------------------*/
 
-int32_t QcaFrmFsmDecode(QcaFrmHdl *frmHdl, uint8_t recvByte, uint8_t *buffer)
+int32_t QCA_IRAM_ATTR QcaFrmFsmDecode(QcaFrmHdl *frmHdl, uint8_t recvByte, uint8_t *buffer)
 {
     int32_t ret = QCAFRM_GATHER;
 
     switch (frmHdl->state)
     {
+    /* 4 bytes hardware length, big endian. Frames are far below 64k, so
+     * the upper two bytes are 0; the length itself is not needed. */
+    case QCAFRM_HW_LEN0:
+    case QCAFRM_HW_LEN1:
+        if (recvByte != 0x00)
+        {
+            ret           = QCAFRM_NOHEAD;
+            frmHdl->state = frmHdl->init;
+        }
+        else
+        {
+            frmHdl->state--;
+        }
+        break;
+    case QCAFRM_HW_LEN2:
+    case QCAFRM_HW_LEN3:
+        frmHdl->state--;
+        break;
     /* 4 bytes header pattern */
     case QCAFRM_COMPLETE:
     case QCAFRM_WAIT_AA1:
@@ -173,7 +238,7 @@ int32_t QcaFrmFsmDecode(QcaFrmHdl *frmHdl, uint8_t recvByte, uint8_t *buffer)
         if (recvByte != 0xAA)
         {
             ret           = QCAFRM_NOHEAD;
-            frmHdl->state = QCAFRM_WAIT_AA1;
+            frmHdl->state = frmHdl->init;
         }
         else
         {
@@ -196,7 +261,7 @@ int32_t QcaFrmFsmDecode(QcaFrmHdl *frmHdl, uint8_t recvByte, uint8_t *buffer)
         if (frmHdl->len > QCAFRM_ETHMAXLEN || frmHdl->len < QCAFRM_ETHMINLEN)
         {
             ret           = QCAFRM_INVLEN;
-            frmHdl->state = QCAFRM_WAIT_AA1;
+            frmHdl->state = frmHdl->init;
         }
         else
         {
@@ -214,7 +279,7 @@ int32_t QcaFrmFsmDecode(QcaFrmHdl *frmHdl, uint8_t recvByte, uint8_t *buffer)
         if (recvByte != 0x55)
         {
             ret           = QCAFRM_NOTAIL;
-            frmHdl->state = QCAFRM_WAIT_AA1;
+            frmHdl->state = frmHdl->init;
         }
         else
         {
@@ -225,7 +290,7 @@ int32_t QcaFrmFsmDecode(QcaFrmHdl *frmHdl, uint8_t recvByte, uint8_t *buffer)
         if (recvByte != 0x55)
         {
             ret           = QCAFRM_NOTAIL;
-            frmHdl->state = QCAFRM_WAIT_AA1;
+            frmHdl->state = frmHdl->init;
         }
         else
         {
@@ -239,6 +304,59 @@ int32_t QcaFrmFsmDecode(QcaFrmHdl *frmHdl, uint8_t recvByte, uint8_t *buffer)
     return ret;
 }
 
+/*====================================================================*
+ *
+ *   QcaFrmFsmDecodeBuf
+ *
+ *   QcaFrmFsmDecode over a buffer. Bytes between frames are skipped
+ *   and the Ethernet frame is copied in one piece, so only header and
+ *   footer go through the state machine byte by byte.
+ *
+ *--------------------------------------------------------------------*/
+
+int32_t QCA_IRAM_ATTR QcaFrmFsmDecodeBuf(QcaFrmHdl *frmHdl, const uint8_t *data, uint16_t len, uint16_t *used,
+                                         uint8_t *buffer)
+{
+    int32_t ret = QCAFRM_GATHER;
+    const uint8_t *aa;
+    uint16_t pos = 0;
+    uint16_t n;
+
+    while (pos < len && ret == QCAFRM_GATHER)
+    {
+        switch (QcaFrmGetAction(frmHdl))
+        {
+        case QCAFRM_COPY_FRAME:
+            n = frmHdl->state - QCAFRM_FOOTER_LEN;
+            if (n > len - pos)
+                n = len - pos;
+            memcpy(buffer + frmHdl->offset, data + pos, n);
+            frmHdl->offset += n;
+            frmHdl->state -= n;
+            pos += n;
+            break;
+
+        default:
+            /* Hunting for a header: jump to the next 0xAA */
+            if (frmHdl->state == QCAFRM_WAIT_AA1 || frmHdl->state == QCAFRM_COMPLETE)
+            {
+                aa = memchr(data + pos, 0xAA, len - pos);
+                if (aa == NULL)
+                {
+                    pos = len;
+                    break;
+                }
+                pos = aa - data;
+            }
+            ret = QcaFrmFsmDecode(frmHdl, data[pos++], buffer);
+            break;
+        }
+    }
+
+    *used = pos;
+    return ret;
+}
+
 /*====================================================================*
  *
  *--------------------------------------------------------------------*/
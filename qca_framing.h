@@ -37,6 +37,8 @@
 /* Standard includes. */
 #include <stdint.h>
 
+#include "qca_iram.h"
+
 /*====================================================================*
  *   constants
  *--------------------------------------------------------------------*/
@@ -99,6 +101,7 @@
 
 typedef enum
 {
+    /*  4 bytes hardware length in front of every frame read over SPI */
     QCAFRM_HW_LEN0 = 0x8000,
     QCAFRM_HW_LEN1 = QCAFRM_HW_LEN0 - 1,
     QCAFRM_HW_LEN2 = QCAFRM_HW_LEN1 - 1,
@@ -155,6 +158,9 @@ typedef struct {
     /*  Current decoding state */
     QcaFrmState state;
 
+    /*  Start state: QCAFRM_HW_LEN0 for SPI, QCAFRM_WAIT_AA1 otherwise */
+    QcaFrmState init;
+
     /* Offset in buffer (borrowed for length too) */
     int16_t offset;
 
@@ -186,6 +192,21 @@ int32_t QcaFrmCreateHeader(uint8_t *buf, uint16_t len);
 
 int32_t QcaFrmCreateFooter(uint8_t *buf);
 
+/*====================================================================*
+ *
+ *   QcaFrmEncapsulate
+ *
+ *   Pads the len byte frame behind the QCA7K header in buf to
+ *   QCAFRM_ETHMINLEN and writes the header and footer around it. buf
+ *   holds QCA_TX_BUF_SIZE(len) bytes.
+ *
+ *   Return: The frame length after padding, without the header and
+ *   footer.
+ *
+ *--------------------------------------------------------------------*/
+
+uint16_t QcaFrmEncapsulate(uint8_t *buf, uint16_t len);
+
 /*====================================================================*
  *
  *   QcaFrmAddQID
@@ -205,10 +226,14 @@ int32_t QcaFrmAddQID(uint8_t *buf, uint8_t qid);
  *   Initialize the framing handle. To be called at initialization for new
  *   QcaFrmHdl allocated.
  *
+ *   QcaFrmFsmInit is for byte streams that start with the 0xAA header,
+ *   QcaFrmFsmInitSpi for the QCA7k read buffer, where every frame is
+ *   preceded by its 4 bytes hardware length.
  *
  *--------------------------------------------------------------------*/
 
 void QcaFrmFsmInit(QcaFrmHdl *frmHdl);
+void QcaFrmFsmInitSpi(QcaFrmHdl *frmHdl);
 
 uint16_t QcaFrmBytesRequired(QcaFrmHdl *frmHdl);
 QcaFrmAction QcaFrmGetAction(QcaFrmHdl *frmHdl);
@@ -230,4 +255,18 @@ QcaFrmAction QcaFrmGetAction(QcaFrmHdl *frmHdl);
 
 int32_t QcaFrmFsmDecode(QcaFrmHdl *frmHdl, uint8_t recvByte, uint8_t *buf);
 
+/*====================================================================*
+ *
+ *   QcaFrmFsmDecodeBuf
+ *
+ *   QcaFrmFsmDecode over len bytes of data, for byte streams read in
+ *   chunks. Stops after the first complete frame or error, so the
+ *   caller can take the frame and call again with the rest.
+ *
+ * Return:   As QcaFrmFsmDecode, *used is the number of bytes consumed.
+ *
+ *--------------------------------------------------------------------*/
+
+int32_t QcaFrmFsmDecodeBuf(QcaFrmHdl *frmHdl, const uint8_t *data, uint16_t len, uint16_t *used, uint8_t *buffer);
+
 #endif
@@ -0,0 +1,41 @@
+/*====================================================================*
+ *
+ *   qca_iram.h
+ *
+ *   Placement of the RX/TX hot path.
+ *
+ *   With QCASPI_IRAM_HOT_PATH set, everything the SPI thread runs per
+ *   frame (interrupt service, register access, burst reads and writes,
+ *   framing, the descriptor rings, the RX filter) is placed in IRAM and
+ *   the constant data it reads in DRAM, and the QCA7000 interrupt is
+ *   allocated with ESP_INTR_FLAG_IRAM. The interrupt is then taken and
+ *   time stamped while the flash cache is off, and the SPI thread does
+ *   not refill the cache with its own code after a flash write or a
+ *   large flash read evicted it. Off by default, it takes IRAM the
+ *   application may need.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA_IRAM_HEADER
+#define QCA_IRAM_HEADER
+
+#include "esp_attr.h"
+
+#ifndef QCASPI_IRAM_HOT_PATH
+#define QCASPI_IRAM_HOT_PATH 0
+#endif
+
+#if QCASPI_IRAM_HOT_PATH
+/* Switch jump tables would go to flash rodata */
+#define QCA_IRAM_ATTR  IRAM_ATTR __attribute__((optimize("no-jump-tables")))
+#define QCA_DRAM_ATTR  DRAM_ATTR
+#define QCA_INLINE     static inline __attribute__((always_inline))
+#define QCA_INTR_FLAGS ESP_INTR_FLAG_IRAM
+#else
+#define QCA_IRAM_ATTR
+#define QCA_DRAM_ATTR
+#define QCA_INLINE     static inline
+#define QCA_INTR_FLAGS 0
+#endif
+
+#endif
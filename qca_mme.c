@@ -0,0 +1,106 @@
+/*====================================================================*
+ *
+ *   qca_mme.c
+ *
+ *   HomePlug GreenPHY and Qualcomm vendor MME parsing in place and
+ *   prebuilt TX templates.
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca_mme.h"
+#include "byte_order.h"
+#include "qca_driver.h"
+#include <stdlib.h>
+#include <string.h>
+
+uint16_t qca_mme_type(const uint8_t *frame, size_t len)
+{
+    const qca_mme_hdr_t *hdr = (const qca_mme_hdr_t *)frame;
+
+    if (len < sizeof(qca_mme_hdr_t) || hdr->ethertype != __cpu_to_be16(QCA_MME_ETHERTYPE))
+        return 0;
+
+    return __le16_to_cpu(hdr->mmtype);
+}
+
+const void *qca_mme_parse(const uint8_t *frame, size_t len, uint16_t mmtype, size_t size)
+{
+    if (len < size || qca_mme_type(frame, len) != mmtype)
+        return NULL;
+
+    return frame;
+}
+
+static void qca_mme_tmpl_done(void *ctx, qca_tx_status_t status)
+{
+    qca_mme_tmpl_t *tmpl = ctx;
+
+    tmpl->status = status;
+    atomic_store(&tmpl->busy, false);
+}
+
+esp_err_t qca_mme_tmpl_init(qca_mme_tmpl_t *tmpl, uint16_t mmtype, size_t size, const uint8_t *dest,
+                            const uint8_t *src)
+{
+    static const uint8_t oui[] = QCA_MME_OUI_QCA;
+
+    if (size < sizeof(qca_mme_hdr_t) || size > QCAFRM_ETHMAXLEN)
+        return ESP_ERR_INVALID_SIZE;
+
+    tmpl->buf = calloc(1, QCA_TX_BUF_SIZE(size));
+    if (tmpl->buf == NULL)
+        return ESP_ERR_NO_MEM;
+
+    tmpl->len    = size;
+    tmpl->status = QCA_TX_SENT;
+    atomic_init(&tmpl->busy, false);
+
+    memset(&tmpl->desc, 0, sizeof(tmpl->desc));
+    tmpl->desc.xStatic      = true;
+    tmpl->desc.pxTxComplete = qca_mme_tmpl_done;
+    tmpl->desc.pvTxContext  = tmpl;
+
+    qca_mme_hdr_t *hdr = QCA_MME_TMPL(tmpl, qca_mme_hdr_t);
+    memcpy(hdr->dest, dest, QCA_MME_ETH_ALEN);
+    memcpy(hdr->src, src, QCA_MME_ETH_ALEN);
+    hdr->ethertype = __cpu_to_be16(QCA_MME_ETHERTYPE);
+    hdr->mmtype    = __cpu_to_le16(mmtype);
+
+    if (mmtype >= QCA_MMTYPE_VS_BASE)
+    {
+        hdr->mmv = QCA_MME_MMV_AV_1_0;
+        if (size >= sizeof(qca_mme_vs_hdr_t))
+            memcpy(QCA_MME_TMPL(tmpl, qca_mme_vs_hdr_t)->oui, oui, sizeof(oui));
+    }
+    else
+    {
+        hdr->mmv = QCA_MME_MMV_AV_1_1;
+    }
+
+    return ESP_OK;
+}
+
+void qca_mme_tmpl_free(qca_mme_tmpl_t *tmpl)
+{
+    free(tmpl->buf);
+    tmpl->buf = NULL;
+}
+
+esp_err_t qca_mme_tmpl_send(qca_mme_tmpl_t *tmpl)
+{
+    bool idle = false;
+    esp_err_t err;
+
+    if (!atomic_compare_exchange_strong(&tmpl->busy, &idle, true))
+        return ESP_ERR_INVALID_STATE;
+
+    /* qca_send_desc moves it back onto the QCA7k header */
+    tmpl->desc.pucEthernetBuffer = tmpl->buf + QCAFRM_HEADER_LEN;
+    tmpl->desc.xDataLength       = tmpl->len;
+
+    err = qca_send_desc(&tmpl->desc);
+    if (err != ESP_OK)
+        atomic_store(&tmpl->busy, false);
+
+    return err;
+}
@@ -0,0 +1,297 @@
+/*====================================================================*
+ *
+ *   qca_mme.h
+ *
+ *   HomePlug GreenPHY and Qualcomm vendor management message (MME)
+ *   layouts.
+ *
+ *   Received MMEs are parsed in place: qca_mme_parse checks type and
+ *   length and returns the frame itself cast to the message layout.
+ *   Transmitted MMEs are built once into a template that carries the
+ *   QCA7k headroom, so only the variable fields change per send and
+ *   the buffer goes out through qca_send_async without a copy.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA_MME_HEADER
+#define QCA_MME_HEADER
+
+#include "qca_spi.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*====================================================================*
+ *   constants;
+ *--------------------------------------------------------------------*/
+
+#define QCA_MME_ETH_ALEN  6
+#define QCA_MME_ETHERTYPE 0x88E1 /* HomePlug AV / GreenPHY */
+
+#define QCA_MME_MMV_AV_1_0 0x00 /* Vendor MMEs, no fragmentation info */
+#define QCA_MME_MMV_AV_1_1 0x01
+
+#define QCA_MME_OUI_QCA {0x00, 0xB0, 0x52}
+
+/* MMTYPE low bits */
+#define QCA_MMTYPE_REQ  0x0000
+#define QCA_MMTYPE_CNF  0x0001
+#define QCA_MMTYPE_IND  0x0002
+#define QCA_MMTYPE_RSP  0x0003
+#define QCA_MMTYPE_MODE 0x0003
+
+/* Vendor specific MMTYPEs start here */
+#define QCA_MMTYPE_VS_BASE 0xA000
+
+/* MMTYPE bases */
+#define QCA_MMTYPE_CM_SET_KEY          0x6008
+#define QCA_MMTYPE_CM_SLAC_PARM        0x6064
+#define QCA_MMTYPE_CM_START_ATTEN_CHAR 0x6068
+#define QCA_MMTYPE_CM_ATTEN_CHAR       0x606C
+#define QCA_MMTYPE_CM_MNBC_SOUND       0x6074
+#define QCA_MMTYPE_CM_SLAC_MATCH       0x607C
+#define QCA_MMTYPE_CM_ATTEN_PROFILE    0x6084
+#define QCA_MMTYPE_VS_OP_ATTR          0xA068
+
+#define QCA_MME_RUN_ID_LEN  8
+#define QCA_MME_STATION_LEN 17
+#define QCA_MME_NID_LEN     7
+#define QCA_MME_KEY_LEN     16
+#define QCA_MME_AAG_GROUPS  58
+
+/*====================================================================*
+ *   headers;
+ *--------------------------------------------------------------------*/
+
+typedef struct __attribute__((packed)) {
+    uint8_t dest[QCA_MME_ETH_ALEN];
+    uint8_t src[QCA_MME_ETH_ALEN];
+    uint16_t ethertype; /* Big endian */
+    uint8_t mmv;
+    uint16_t mmtype; /* Little endian */
+} qca_mme_hdr_t;
+
+/* HomePlug AV 1.1 header, followed by the message */
+typedef struct __attribute__((packed)) {
+    qca_mme_hdr_t hdr;
+    uint8_t fmi[2]; /* Fragment info, always 0 for SLAC */
+} qca_mme_av_hdr_t;
+
+/* Qualcomm vendor header, followed by the message */
+typedef struct __attribute__((packed)) {
+    qca_mme_hdr_t hdr;
+    uint8_t oui[3];
+} qca_mme_vs_hdr_t;
+
+/*====================================================================*
+ *   messages;
+ *--------------------------------------------------------------------*/
+
+typedef struct __attribute__((packed)) {
+    qca_mme_vs_hdr_t vs;
+    uint32_t cookie;
+    uint8_t report_type;
+} qca_mme_op_attr_req_t;
+
+typedef struct __attribute__((packed)) {
+    qca_mme_vs_hdr_t vs;
+    uint16_t status;
+    uint32_t cookie;
+    uint8_t report_type;
+    uint16_t size;
+    uint8_t attr[];
+} qca_mme_op_attr_cnf_t;
+
+typedef struct __attribute__((packed)) {
+    qca_mme_av_hdr_t av;
+    uint8_t application_type;
+    uint8_t security_type;
+    uint8_t run_id[QCA_MME_RUN_ID_LEN];
+} qca_mme_slac_parm_req_t;
+
+typedef struct __attribute__((packed)) {
+    qca_mme_av_hdr_t av;
+    uint8_t msound_target[QCA_MME_ETH_ALEN];
+    uint8_t num_sounds;
+    uint8_t time_out;
+    uint8_t resp_type;
+    uint8_t forwarding_sta[QCA_MME_ETH_ALEN];
+    uint8_t application_type;
+    uint8_t security_type;
+    uint8_t run_id[QCA_MME_RUN_ID_LEN];
+} qca_mme_slac_parm_cnf_t;
+
+typedef struct __attribute__((packed)) {
+    qca_mme_av_hdr_t av;
+    uint8_t application_type;
+    uint8_t security_type;
+    uint8_t num_sounds;
+    uint8_t time_out;
+    uint8_t resp_type;
+    uint8_t forwarding_sta[QCA_MME_ETH_ALEN];
+    uint8_t run_id[QCA_MME_RUN_ID_LEN];
+} qca_mme_start_atten_char_ind_t;
+
+typedef struct __attribute__((packed)) {
+    qca_mme_av_hdr_t av;
+    uint8_t application_type;
+    uint8_t security_type;
+    uint8_t sender_id[QCA_MME_STATION_LEN];
+    uint8_t cnt;
+    uint8_t run_id[QCA_MME_RUN_ID_LEN];
+    uint8_t rsvd[8];
+    uint8_t rnd[16];
+} qca_mme_mnbc_sound_ind_t;
+
+typedef struct __attribute__((packed)) {
+    qca_mme_av_hdr_t av;
+    uint8_t pev_mac[QCA_MME_ETH_ALEN];
+    uint8_t num_groups;
+    uint8_t rsvd;
+    uint8_t aag[QCA_MME_AAG_GROUPS];
+} qca_mme_atten_profile_ind_t;
+
+typedef struct __attribute__((packed)) {
+    qca_mme_av_hdr_t av;
+    uint8_t application_type;
+    uint8_t security_type;
+    uint8_t source_address[QCA_MME_ETH_ALEN];
+    uint8_t run_id[QCA_MME_RUN_ID_LEN];
+    uint8_t source_id[QCA_MME_STATION_LEN];
+    uint8_t resp_id[QCA_MME_STATION_LEN];
+    uint8_t num_sounds;
+    uint8_t num_groups;
+    uint8_t aag[QCA_MME_AAG_GROUPS];
+} qca_mme_atten_char_ind_t;
+
+typedef struct __attribute__((packed)) {
+    qca_mme_av_hdr_t av;
+    uint8_t application_type;
+    uint8_t security_type;
+    uint8_t source_address[QCA_MME_ETH_ALEN];
+    uint8_t run_id[QCA_MME_RUN_ID_LEN];
+    uint8_t source_id[QCA_MME_STATION_LEN];
+    uint8_t resp_id[QCA_MME_STATION_LEN];
+    uint8_t result;
+} qca_mme_atten_char_rsp_t;
+
+typedef struct __attribute__((packed)) {
+    qca_mme_av_hdr_t av;
+    uint8_t application_type;
+    uint8_t security_type;
+    uint16_t mvf_length; /* Little endian */
+    uint8_t pev_id[QCA_MME_STATION_LEN];
+    uint8_t pev_mac[QCA_MME_ETH_ALEN];
+    uint8_t evse_id[QCA_MME_STATION_LEN];
+    uint8_t evse_mac[QCA_MME_ETH_ALEN];
+    uint8_t run_id[QCA_MME_RUN_ID_LEN];
+    uint8_t rsvd[8];
+} qca_mme_slac_match_req_t;
+
+typedef struct __attribute__((packed)) {
+    qca_mme_av_hdr_t av;
+    uint8_t application_type;
+    uint8_t security_type;
+    uint16_t mvf_length; /* Little endian */
+    uint8_t pev_id[QCA_MME_STATION_LEN];
+    uint8_t pev_mac[QCA_MME_ETH_ALEN];
+    uint8_t evse_id[QCA_MME_STATION_LEN];
+    uint8_t evse_mac[QCA_MME_ETH_ALEN];
+    uint8_t run_id[QCA_MME_RUN_ID_LEN];
+    uint8_t rsvd[8];
+    uint8_t nid[QCA_MME_NID_LEN];
+    uint8_t rsvd2;
+    uint8_t nmk[QCA_MME_KEY_LEN];
+} qca_mme_slac_match_cnf_t;
+
+typedef struct __attribute__((packed)) {
+    qca_mme_av_hdr_t av;
+    uint8_t key_type;
+    uint32_t my_nonce;
+    uint32_t your_nonce;
+    uint8_t pid;
+    uint16_t prn;
+    uint8_t pmn;
+    uint8_t cco_capability;
+    uint8_t nid[QCA_MME_NID_LEN];
+    uint8_t new_eks;
+    uint8_t new_key[QCA_MME_KEY_LEN];
+} qca_mme_set_key_req_t;
+
+typedef struct __attribute__((packed)) {
+    qca_mme_av_hdr_t av;
+    uint8_t result;
+    uint32_t my_nonce;
+    uint32_t your_nonce;
+    uint8_t pid;
+    uint16_t prn;
+    uint8_t pmn;
+    uint8_t cco_capability;
+} qca_mme_set_key_cnf_t;
+
+/* Layouts are fixed by the HomePlug GreenPHY spec */
+_Static_assert(sizeof(qca_mme_hdr_t) == 17, "MME header");
+_Static_assert(sizeof(qca_mme_slac_parm_req_t) == 29, "CM_SLAC_PARM.REQ");
+_Static_assert(sizeof(qca_mme_slac_parm_cnf_t) == 44, "CM_SLAC_PARM.CNF");
+_Static_assert(sizeof(qca_mme_mnbc_sound_ind_t) == 71, "CM_MNBC_SOUND.IND");
+_Static_assert(sizeof(qca_mme_atten_char_ind_t) == 129, "CM_ATTEN_CHAR.IND");
+_Static_assert(sizeof(qca_mme_slac_match_cnf_t) == 109, "CM_SLAC_MATCH.CNF");
+
+/*====================================================================*
+ *
+ *   qca_mme_type
+ *
+ *   Return: The MMTYPE of an Ethernet frame, 0 if it is no MME.
+ *
+ *--------------------------------------------------------------------*/
+
+uint16_t qca_mme_type(const uint8_t *frame, size_t len);
+
+/*====================================================================*
+ *
+ *   qca_mme_parse
+ *
+ *   Check that an Ethernet frame is an MME of the given MMTYPE and at
+ *   least size bytes long.
+ *
+ *   Return: The frame itself, NULL if it does not match.
+ *
+ *--------------------------------------------------------------------*/
+
+const void *qca_mme_parse(const uint8_t *frame, size_t len, uint16_t mmtype, size_t size);
+
+/* Parse a received descriptor in place as the given message layout */
+#define QCA_MME_CAST(desc, mmtype, type) \
+    ((const type *)qca_mme_parse((desc)->pucEthernetBuffer, (desc)->xDataLength, (mmtype), sizeof(type)))
+
+/*====================================================================*
+ *
+ *   qca_mme_tmpl_t
+ *
+ *   A prebuilt TX frame with QCA7k headroom. The header is filled by
+ *   qca_mme_tmpl_init and the rest of the message is kept between
+ *   sends, so a burst only rewrites the fields that change. A template
+ *   is busy from qca_mme_tmpl_send until its completion. It is sent
+ *   through its own static descriptor, so nothing is allocated after
+ *   qca_mme_tmpl_init.
+ *
+ *--------------------------------------------------------------------*/
+
+typedef struct {
+    uint8_t *buf; /* QCA_TX_BUF_SIZE(len) bytes */
+    uint16_t len; /* Ethernet frame length */
+    _Atomic(bool) busy;
+    qca_tx_status_t status; /* Outcome of the last send */
+    NetworkBufferDescriptor_t desc;
+} qca_mme_tmpl_t;
+
+esp_err_t qca_mme_tmpl_init(qca_mme_tmpl_t *tmpl, uint16_t mmtype, size_t size, const uint8_t *dest,
+                            const uint8_t *src);
+void qca_mme_tmpl_free(qca_mme_tmpl_t *tmpl);
+esp_err_t qca_mme_tmpl_send(qca_mme_tmpl_t *tmpl);
+
+/* The message inside a template, cast to its layout */
+#define QCA_MME_TMPL(tmpl, type) ((type *)((tmpl)->buf + QCAFRM_HEADER_LEN))
+
+#endif
@@ -0,0 +1,361 @@
+/*====================================================================*
+ *
+ *   qca_mme_corr.c
+ *
+ *   MME request/response correlation.
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca_mme_corr.h"
+#include "byte_order.h"
+#include "qca_driver.h"
+#include <stddef.h>
+#include <string.h>
+
+/* qca_mme_request sends from any task */
+#if !QCASPI_TX_MULTI_PRODUCER
+#error "qca_mme_corr needs QCASPI_TX_MULTI_PRODUCER"
+#endif
+
+static const char *TAG = "qca-mme-corr";
+
+typedef struct {
+    uint16_t mmtype; /* Base, mode bits cleared */
+    uint8_t peer[QCA_MME_ETH_ALEN];
+    uint64_t token;
+} qca_mme_corr_key_t;
+
+typedef enum
+{
+    SLOT_FREE = 0,
+    SLOT_USED,
+    SLOT_DELETED, /* Keeps probe chains intact */
+} qca_mme_corr_slot_state_t;
+
+typedef struct {
+    qca_mme_corr_slot_state_t state;
+    qca_mme_corr_key_t key;
+    int64_t deadline;
+    qca_mme_corr_cb_t cb;
+    void *ctx;
+} qca_mme_corr_slot_t;
+
+/* Where the correlation token sits in each message */
+typedef struct {
+    uint16_t mmtype;
+    uint8_t offset;
+    uint8_t len;
+} qca_mme_corr_token_t;
+
+#define TOKEN(type, layout, field) {(type), offsetof(layout, field), sizeof(((layout *)0)->field)}
+
+static const qca_mme_corr_token_t tokens[] = {
+    TOKEN(QCA_MMTYPE_VS_OP_ATTR | QCA_MMTYPE_REQ, qca_mme_op_attr_req_t, cookie),
+    TOKEN(QCA_MMTYPE_VS_OP_ATTR | QCA_MMTYPE_CNF, qca_mme_op_attr_cnf_t, cookie),
+    TOKEN(QCA_MMTYPE_CM_SLAC_PARM | QCA_MMTYPE_REQ, qca_mme_slac_parm_req_t, run_id),
+    TOKEN(QCA_MMTYPE_CM_SLAC_PARM | QCA_MMTYPE_CNF, qca_mme_slac_parm_cnf_t, run_id),
+    TOKEN(QCA_MMTYPE_CM_ATTEN_CHAR | QCA_MMTYPE_IND, qca_mme_atten_char_ind_t, run_id),
+    TOKEN(QCA_MMTYPE_CM_ATTEN_CHAR | QCA_MMTYPE_RSP, qca_mme_atten_char_rsp_t, run_id),
+    TOKEN(QCA_MMTYPE_CM_SLAC_MATCH | QCA_MMTYPE_REQ, qca_mme_slac_match_req_t, run_id),
+    TOKEN(QCA_MMTYPE_CM_SLAC_MATCH | QCA_MMTYPE_CNF, qca_mme_slac_match_cnf_t, run_id),
+    TOKEN(QCA_MMTYPE_CM_SET_KEY | QCA_MMTYPE_REQ, qca_mme_set_key_req_t, my_nonce),
+    TOKEN(QCA_MMTYPE_CM_SET_KEY | QCA_MMTYPE_CNF, qca_mme_set_key_cnf_t, your_nonce),
+};
+
+static qca_mme_corr_slot_t slots[QCA_MME_CORR_SLOTS];
+static uint32_t pending;
+static portMUX_TYPE corr_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t corr_timer;
+static bool corr_timer_running; /* Armed, or its callback is running */
+static qca_mme_corr_stats_t corr_stats;
+static qca_rx_hook_t next_hook;
+
+/*====================================================================*
+ *
+ *   qca_mme_corr_key
+ *
+ *   Build the lookup key of an MME. Requests are keyed by their
+ *   destination, responses by their source. Messages without a token
+ *   entry match on MMTYPE and peer alone.
+ *
+ *--------------------------------------------------------------------*/
+
+static bool qca_mme_corr_key(const uint8_t *frame, size_t len, bool response, qca_mme_corr_key_t *key)
+{
+    const qca_mme_hdr_t *hdr = (const qca_mme_hdr_t *)frame;
+    uint16_t mmtype          = qca_mme_type(frame, len);
+    size_t i;
+
+    if (mmtype == 0)
+        return false;
+
+    memset(key, 0, sizeof(*key));
+    key->mmtype = mmtype & ~QCA_MMTYPE_MODE;
+    memcpy(key->peer, response ? hdr->src : hdr->dest, QCA_MME_ETH_ALEN);
+
+    for (i = 0; i < sizeof(tokens) / sizeof(tokens[0]); i++)
+    {
+        if (tokens[i].mmtype != mmtype)
+            continue;
+        if (len < tokens[i].offset + tokens[i].len)
+            return false;
+        memcpy(&key->token, frame + tokens[i].offset, tokens[i].len);
+        break;
+    }
+
+    return true;
+}
+
+static bool qca_mme_corr_is_group(const uint8_t *mac)
+{
+    return mac[0] & 0x01;
+}
+
+static bool qca_mme_corr_key_match(const qca_mme_corr_key_t *req, const qca_mme_corr_key_t *rsp)
+{
+    /* Requests to broadcast/multicast accept a response from any station */
+    return req->mmtype == rsp->mmtype && req->token == rsp->token
+        && (qca_mme_corr_is_group(req->peer) || memcmp(req->peer, rsp->peer, QCA_MME_ETH_ALEN) == 0);
+}
+
+/* FNV-1a over MMTYPE and token; the peer is left out so group requests hash alike */
+static uint32_t qca_mme_corr_hash(const qca_mme_corr_key_t *key)
+{
+    uint32_t hash = 2166136261u;
+    uint64_t v    = ((uint64_t)key->mmtype << 48) ^ key->token;
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        hash ^= (uint8_t)(v >> (i * 8));
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Caller holds corr_lock */
+static qca_mme_corr_slot_t *qca_mme_corr_find(const qca_mme_corr_key_t *key)
+{
+    uint32_t idx = qca_mme_corr_hash(key);
+    uint32_t n;
+
+    for (n = 0; n < QCA_MME_CORR_SLOTS; n++, idx++)
+    {
+        qca_mme_corr_slot_t *slot = &slots[idx & (QCA_MME_CORR_SLOTS - 1)];
+
+        if (slot->state == SLOT_FREE)
+            return NULL;
+        if (slot->state == SLOT_USED && qca_mme_corr_key_match(&slot->key, key))
+            return slot;
+    }
+    return NULL;
+}
+
+/* Caller holds corr_lock */
+static void qca_mme_corr_release(qca_mme_corr_slot_t *slot)
+{
+    slot->state = SLOT_DELETED;
+    if (--pending == 0)
+    {
+        /* Table empty, no probe chain to keep */
+        memset(slots, 0, sizeof(slots));
+    }
+}
+
+static void qca_mme_corr_tick(void *arg)
+{
+    qca_mme_corr_slot_t expired[QCA_MME_CORR_SLOTS];
+    int64_t now = esp_timer_get_time();
+    uint32_t n  = 0;
+    uint32_t i;
+    bool rearm;
+
+    portENTER_CRITICAL(&corr_lock);
+    for (i = 0; i < QCA_MME_CORR_SLOTS; i++)
+    {
+        if (slots[i].state == SLOT_USED && now >= slots[i].deadline)
+        {
+            expired[n++] = slots[i];
+            qca_mme_corr_release(&slots[i]);
+        }
+    }
+    /* Decided under the lock, armed after it. Until the timer is armed
+     * again, corr_timer_running keeps qca_mme_expect from arming it too. */
+    rearm              = pending > 0;
+    corr_timer_running = rearm;
+    corr_stats.timeouts += n;
+    portEXIT_CRITICAL(&corr_lock);
+
+    if (rearm)
+        esp_timer_start_once(corr_timer, QCA_MME_CORR_TICK_MS * 1000);
+
+    /* Callbacks run unlocked, they may issue the next request */
+    for (i = 0; i < n; i++) expired[i].cb(expired[i].ctx, QCA_MME_CORR_TIMEOUT, NULL);
+}
+
+static bool qca_mme_corr_rx(NetworkBufferDescriptor_t *rxDesc)
+{
+    qca_mme_corr_key_t key;
+    qca_mme_corr_slot_t *slot;
+    qca_mme_corr_cb_t cb = NULL;
+    void *ctx            = NULL;
+
+    /* Only confirmations and responses answer a request */
+    uint16_t mmtype = qca_mme_type(rxDesc->pucEthernetBuffer, rxDesc->xDataLength);
+    if (mmtype == 0 || ((mmtype & QCA_MMTYPE_MODE) != QCA_MMTYPE_CNF && (mmtype & QCA_MMTYPE_MODE) != QCA_MMTYPE_RSP))
+        return next_hook != NULL && next_hook(rxDesc);
+
+    if (!qca_mme_corr_key(rxDesc->pucEthernetBuffer, rxDesc->xDataLength, true, &key))
+        return next_hook != NULL && next_hook(rxDesc);
+
+    portENTER_CRITICAL(&corr_lock);
+    if (pending && (slot = qca_mme_corr_find(&key)) != NULL)
+    {
+        cb  = slot->cb;
+        ctx = slot->ctx;
+        qca_mme_corr_release(slot);
+        corr_stats.responses++;
+    }
+    else
+    {
+        corr_stats.unmatched++;
+    }
+    portEXIT_CRITICAL(&corr_lock);
+
+    if (cb == NULL)
+        return next_hook != NULL && next_hook(rxDesc);
+
+    cb(ctx, QCA_MME_CORR_OK, rxDesc);
+    qca_free_desc(rxDesc);
+    return true;
+}
+
+esp_err_t qca_mme_corr_init(void)
+{
+    const esp_timer_create_args_t args = {
+        .callback        = qca_mme_corr_tick,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name            = "qca_mme_corr",
+    };
+
+    esp_err_t err;
+
+    if (corr_timer != NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    err = esp_timer_create(&args, &corr_timer);
+    if (err != ESP_OK)
+        return err;
+
+    next_hook   = qca.rx_hook;
+    qca.rx_hook = qca_mme_corr_rx;
+    return ESP_OK;
+}
+
+esp_err_t qca_mme_expect(const uint8_t *frame, size_t len, uint32_t timeout_ms, qca_mme_corr_cb_t cb, void *ctx)
+{
+    qca_mme_corr_key_t key;
+    qca_mme_corr_slot_t *slot = NULL;
+    uint32_t idx;
+    uint32_t n;
+    esp_err_t err = ESP_OK;
+    bool arm      = false;
+
+    if (cb == NULL || !qca_mme_corr_key(frame, len, false, &key))
+        return ESP_ERR_INVALID_ARG;
+
+    uint16_t mode = qca_mme_type(frame, len) & QCA_MMTYPE_MODE;
+    if (mode != QCA_MMTYPE_REQ && mode != QCA_MMTYPE_IND)
+        return ESP_ERR_INVALID_ARG;
+
+    portENTER_CRITICAL(&corr_lock);
+    if (qca_mme_corr_find(&key) != NULL)
+    {
+        err = ESP_ERR_INVALID_STATE;
+    }
+    else
+    {
+        idx = qca_mme_corr_hash(&key);
+        for (n = 0; n < QCA_MME_CORR_SLOTS; n++, idx++)
+        {
+            if (slots[idx & (QCA_MME_CORR_SLOTS - 1)].state != SLOT_USED)
+            {
+                slot = &slots[idx & (QCA_MME_CORR_SLOTS - 1)];
+                break;
+            }
+        }
+
+        if (slot == NULL)
+        {
+            corr_stats.table_full++;
+            err = ESP_ERR_NO_MEM;
+        }
+        else
+        {
+            slot->state    = SLOT_USED;
+            slot->key      = key;
+            slot->deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+            slot->cb       = cb;
+            slot->ctx      = ctx;
+            pending++;
+            corr_stats.requests++;
+        }
+    }
+
+    /* Only the caller that finds the timer idle arms it, see qca_mme_corr_tick */
+    if (err == ESP_OK && !corr_timer_running)
+    {
+        corr_timer_running = true;
+        arm                = true;
+    }
+    portEXIT_CRITICAL(&corr_lock);
+
+    if (arm)
+        esp_timer_start_once(corr_timer, QCA_MME_CORR_TICK_MS * 1000);
+
+    return err;
+}
+
+esp_err_t qca_mme_cancel(const uint8_t *frame, size_t len)
+{
+    qca_mme_corr_key_t key;
+    qca_mme_corr_slot_t *slot;
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+
+    if (!qca_mme_corr_key(frame, len, false, &key))
+        return ESP_ERR_INVALID_ARG;
+
+    portENTER_CRITICAL(&corr_lock);
+    if ((slot = qca_mme_corr_find(&key)) != NULL)
+    {
+        qca_mme_corr_release(slot);
+        err = ESP_OK;
+    }
+    portEXIT_CRITICAL(&corr_lock);
+
+    return err;
+}
+
+esp_err_t qca_mme_request(const uint8_t *frame, size_t len, uint32_t timeout_ms, qca_mme_corr_cb_t cb, void *ctx)
+{
+    esp_err_t err = qca_mme_expect(frame, len, timeout_ms, cb, ctx);
+    if (err != ESP_OK)
+        return err;
+
+    /* Sent after its response is due, the request is of no use */
+    err = qca_send_deadline((void *)frame, len, esp_timer_get_time() + (int64_t)timeout_ms * 1000);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Send failed, request withdrawn");
+        qca_mme_cancel(frame, len);
+    }
+
+    return err;
+}
+
+void qca_mme_corr_get_stats(qca_mme_corr_stats_t *stats)
+{
+    portENTER_CRITICAL(&corr_lock);
+    *stats = corr_stats;
+    portEXIT_CRITICAL(&corr_lock);
+}
@@ -0,0 +1,99 @@
+/*====================================================================*
+ *
+ *   qca_mme_corr.h
+ *
+ *   MME request/response correlation.
+ *
+ *   Outstanding requests are kept in a small hash table keyed by the
+ *   MMTYPE base, a correlation token taken from the message (vendor
+ *   cookie, SLAC RunID or CM_SET_KEY nonce) and the peer MAC. Received
+ *   responses are matched in the SPI thread and handed to the request
+ *   callback without being queued; requests that see no response are
+ *   completed with a timeout. Any number of requests up to
+ *   QCA_MME_CORR_SLOTS can be in flight at once.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA_MME_CORR_HEADER
+#define QCA_MME_CORR_HEADER
+
+#include "qca_mme.h"
+
+/* Hash table size, a power of two */
+#ifndef QCA_MME_CORR_SLOTS
+#define QCA_MME_CORR_SLOTS 16
+#endif
+
+/* Timeout scan interval while requests are outstanding */
+#ifndef QCA_MME_CORR_TICK_MS
+#define QCA_MME_CORR_TICK_MS 10
+#endif
+
+_Static_assert(QCA_RING_IS_POW2(QCA_MME_CORR_SLOTS), "QCA_MME_CORR_SLOTS must be a power of two");
+
+typedef enum
+{
+    QCA_MME_CORR_OK = 0, /* rsp holds the response */
+    QCA_MME_CORR_TIMEOUT,
+} qca_mme_corr_result_t;
+
+/* Called from the SPI thread (response) or the esp_timer task (timeout).
+ * rsp is only valid during the call and is NULL on timeout. */
+typedef void (*qca_mme_corr_cb_t)(void *ctx, qca_mme_corr_result_t result, const NetworkBufferDescriptor_t *rsp);
+
+typedef struct {
+    uint32_t requests;
+    uint32_t responses;
+    uint32_t timeouts;
+    uint32_t unmatched; /* MME responses nobody waited for, passed on to qca_recv */
+    uint32_t table_full;
+} qca_mme_corr_stats_t;
+
+/*====================================================================*
+ *
+ *   qca_mme_corr_init
+ *
+ *   Create the timeout timer and hook the engine into the RX path,
+ *   in front of the hook installed before. Frames that answer no
+ *   request are passed on to it.
+ *
+ *   Return: ESP_ERR_INVALID_STATE    Already initialised
+ *
+ *--------------------------------------------------------------------*/
+
+esp_err_t qca_mme_corr_init(void);
+
+/*====================================================================*
+ *
+ *   qca_mme_expect
+ *
+ *   Register the request MME in frame as outstanding without sending
+ *   it, for callers that send it themselves (e.g. from a template).
+ *   Register before sending, the response can beat the return of the
+ *   send call.
+ *
+ *   Return: ESP_ERR_INVALID_ARG      Not a REQ/IND MME
+ *           ESP_ERR_INVALID_STATE    Same request already outstanding
+ *           ESP_ERR_NO_MEM           Table full
+ *
+ *--------------------------------------------------------------------*/
+
+esp_err_t qca_mme_expect(const uint8_t *frame, size_t len, uint32_t timeout_ms, qca_mme_corr_cb_t cb, void *ctx);
+
+/* Withdraw an outstanding request without calling its callback */
+esp_err_t qca_mme_cancel(const uint8_t *frame, size_t len);
+
+/*====================================================================*
+ *
+ *   qca_mme_request
+ *
+ *   qca_mme_expect followed by qca_send_deadline, so the request is
+ *   dropped rather than sent once its timeout has passed. Does not block.
+ *
+ *--------------------------------------------------------------------*/
+
+esp_err_t qca_mme_request(const uint8_t *frame, size_t len, uint32_t timeout_ms, qca_mme_corr_cb_t cb, void *ctx);
+
+void qca_mme_corr_get_stats(qca_mme_corr_stats_t *stats);
+
+#endif
@@ -0,0 +1,337 @@
+/*====================================================================*
+ *
+ *   qca_perf.c
+ *
+ *   Traffic generator and sink for throughput measurements.
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca_perf.h"
+#include "byte_order.h"
+#include "qca_driver.h"
+#include <string.h>
+
+static const char *TAG = "qca-perf";
+
+#define QCA_PERF_MAGIC 0x51505246 /* "QPRF" */
+
+/* Payload of every perf frame, behind the Ethernet header */
+typedef struct __attribute__((packed)) {
+    uint8_t dest[QCA_PERF_ETH_ALEN];
+    uint8_t src[QCA_PERF_ETH_ALEN];
+    uint16_t ethertype; /* Big endian */
+    uint32_t magic;
+    uint32_t run; /* Tells runs apart, frames of an old run restart the sequence */
+    uint32_t seq;
+    int64_t tx_time; /* esp_timer us of the sender */
+} qca_perf_hdr_t;
+
+/* Cumulative counters, reports are differences of two snapshots */
+typedef struct {
+    int64_t time;
+    uint32_t busy_us;
+    uint32_t tx_frames;
+    uint32_t tx_busy;
+    uint64_t tx_bytes;
+    uint32_t rx_frames;
+    uint64_t rx_bytes;
+    uint32_t rx_gaps; /* Frames skipped by the sequence */
+    uint32_t rx_late; /* Frames that arrived after a later one */
+    uint64_t rtt_sum;
+    uint32_t rtt_count;
+} qca_perf_counters_t;
+
+static struct {
+    qca_perf_config_t cfg;
+    volatile bool running;
+    TaskHandle_t volatile tx_task;
+    uint32_t run;
+
+    uint32_t rx_run;
+    uint32_t rx_next;
+    bool rx_synced;
+
+    qca_perf_counters_t cnt;
+    uint32_t rtt_max;       /* Interval */
+    uint32_t rtt_max_total; /* Run */
+    qca_perf_counters_t base;
+    qca_perf_counters_t last;
+
+    esp_timer_handle_t report_timer;
+    qca_perf_report_cb_t report_cb;
+} perf;
+
+static portMUX_TYPE perf_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void qca_perf_snapshot(qca_perf_counters_t *snap)
+{
+    portENTER_CRITICAL(&perf_lock);
+    *snap = perf.cnt;
+    portEXIT_CRITICAL(&perf_lock);
+    snap->time    = esp_timer_get_time();
+    snap->busy_us = qca.stats.busy_us;
+}
+
+static void qca_perf_fill(qca_perf_report_t *report, const qca_perf_counters_t *cur, const qca_perf_counters_t *prev,
+                          uint32_t rtt_max)
+{
+    int64_t us      = cur->time - prev->time;
+    uint32_t gaps   = cur->rx_gaps - prev->rx_gaps;
+    uint32_t late   = cur->rx_late - prev->rx_late;
+    uint32_t rtts   = cur->rtt_count - prev->rtt_count;
+
+    if (us <= 0)
+        us = 1;
+
+    memset(report, 0, sizeof(*report));
+    report->interval_ms  = (uint32_t)(us / 1000);
+    report->tx_frames    = cur->tx_frames - prev->tx_frames;
+    report->tx_busy      = cur->tx_busy - prev->tx_busy;
+    report->tx_pps       = (uint32_t)(report->tx_frames * 1000000ULL / us);
+    report->tx_kbps      = (uint32_t)((cur->tx_bytes - prev->tx_bytes) * 8000ULL / us);
+    report->rx_frames    = cur->rx_frames - prev->rx_frames;
+    report->rx_lost      = gaps > late ? gaps - late : 0;
+    report->rx_reordered = late;
+    report->rx_pps       = (uint32_t)(report->rx_frames * 1000000ULL / us);
+    report->rx_kbps      = (uint32_t)((cur->rx_bytes - prev->rx_bytes) * 8000ULL / us);
+    report->rtt_avg_us   = rtts ? (uint32_t)((cur->rtt_sum - prev->rtt_sum) / rtts) : 0;
+    report->rtt_max_us   = rtt_max;
+    report->spi_load     = (uint16_t)((cur->busy_us - prev->busy_us) * 1000ULL / us);
+}
+
+static void qca_perf_log(const qca_perf_report_t *r)
+{
+    ESP_LOGI(TAG, "TX %u pps %u kbit/s busy %u | RX %u pps %u kbit/s lost %u reord %u | RTT %u/%u us | SPI %u.%u%%",
+             r->tx_pps, r->tx_kbps, r->tx_busy, r->rx_pps, r->rx_kbps, r->rx_lost, r->rx_reordered, r->rtt_avg_us,
+             r->rtt_max_us, r->spi_load / 10, r->spi_load % 10);
+}
+
+static void qca_perf_report(void *arg)
+{
+    qca_perf_counters_t cur;
+    qca_perf_report_t report;
+    uint32_t rtt_max;
+
+    qca_perf_snapshot(&cur);
+    portENTER_CRITICAL(&perf_lock);
+    rtt_max      = perf.rtt_max;
+    perf.rtt_max = 0;
+    portEXIT_CRITICAL(&perf_lock);
+
+    qca_perf_fill(&report, &cur, &perf.last, rtt_max);
+    perf.last = cur;
+
+    (perf.report_cb != NULL ? perf.report_cb : qca_perf_log)(&report);
+}
+
+static void qca_perf_tx_task(void *arg)
+{
+    uint16_t len          = perf.cfg.frame_len;
+    uint32_t rate         = perf.cfg.rate_pps;
+    uint8_t *frame        = malloc(len);
+    qca_perf_hdr_t *hdr   = (qca_perf_hdr_t *)frame;
+    uint32_t seq          = 0;
+    int64_t t0            = esp_timer_get_time();
+    int64_t now, due;
+    uint16_t i;
+
+    if (frame == NULL)
+    {
+        ESP_LOGE(TAG, "No memory for the TX frame");
+        perf.tx_task = NULL;
+        vTaskDelete(NULL);
+        return;
+    }
+
+    memcpy(hdr->dest, perf.cfg.dest, QCA_PERF_ETH_ALEN);
+    memcpy(hdr->src, perf.cfg.src, QCA_PERF_ETH_ALEN);
+    hdr->ethertype = __cpu_to_be16(perf.cfg.ethertype);
+    hdr->magic     = QCA_PERF_MAGIC;
+    hdr->run       = perf.run;
+    for (i = sizeof(*hdr); i < len; i++) frame[i] = (uint8_t)i;
+
+    while (perf.running)
+    {
+        now = esp_timer_get_time();
+        if (rate)
+        {
+            due = t0 + (int64_t)((uint64_t)seq * 1000000 / rate);
+            if (due > now)
+            {
+                /* Frames due within the same tick go out back to back */
+                vTaskDelay(1);
+                continue;
+            }
+            /* Fell far behind, e.g. a resync: do not make up with a burst */
+            if (now - due > 100000)
+                t0 = now - (int64_t)((uint64_t)seq * 1000000 / rate);
+        }
+
+        hdr->seq     = seq;
+        hdr->tx_time = now;
+        if (qca_send(frame, len) == ESP_OK)
+        {
+            seq++;
+            portENTER_CRITICAL(&perf_lock);
+            perf.cnt.tx_frames++;
+            perf.cnt.tx_bytes += len;
+            portEXIT_CRITICAL(&perf_lock);
+        }
+        else
+        {
+            portENTER_CRITICAL(&perf_lock);
+            perf.cnt.tx_busy++;
+            portEXIT_CRITICAL(&perf_lock);
+            vTaskDelay(1);
+        }
+    }
+
+    free(frame);
+    perf.tx_task = NULL;
+    vTaskDelete(NULL);
+}
+
+bool qca_perf_rx(NetworkBufferDescriptor_t *rxDesc)
+{
+    qca_perf_hdr_t *hdr = (qca_perf_hdr_t *)rxDesc->pucEthernetBuffer;
+    NetworkBufferDescriptor_t *echo;
+    uint8_t mac[QCA_PERF_ETH_ALEN];
+    int64_t now;
+
+    if (!perf.running || rxDesc->xDataLength < sizeof(*hdr) || hdr->ethertype != __cpu_to_be16(perf.cfg.ethertype)
+        || hdr->magic != QCA_PERF_MAGIC)
+        return false;
+
+    if (perf.cfg.mode & QCA_PERF_ECHO)
+    {
+        /* Back to the sender, the payload is kept for its RTT. The
+         * received buffer goes out again, on a second descriptor. */
+        memcpy(mac, hdr->dest, QCA_PERF_ETH_ALEN);
+        memcpy(hdr->dest, hdr->src, QCA_PERF_ETH_ALEN);
+        memcpy(hdr->src, mac, QCA_PERF_ETH_ALEN);
+        echo = qca_clone_desc(rxDesc);
+        if (echo != NULL && qca_send_desc(echo) != ESP_OK)
+            qca_free_desc(echo);
+    }
+
+    if (perf.cfg.mode & QCA_PERF_RX)
+    {
+        now = esp_timer_get_time();
+
+        portENTER_CRITICAL(&perf_lock);
+        if (!perf.rx_synced || hdr->run != perf.rx_run)
+        {
+            /* First frame of a run, whatever its sequence number */
+            perf.rx_synced = true;
+            perf.rx_run    = hdr->run;
+            perf.rx_next   = hdr->seq;
+        }
+
+        if (hdr->seq == perf.rx_next)
+        {
+            perf.rx_next++;
+        }
+        else if ((int32_t)(hdr->seq - perf.rx_next) > 0)
+        {
+            perf.cnt.rx_gaps += hdr->seq - perf.rx_next;
+            perf.rx_next = hdr->seq + 1;
+        }
+        else
+        {
+            perf.cnt.rx_late++;
+        }
+
+        perf.cnt.rx_frames++;
+        perf.cnt.rx_bytes += rxDesc->xDataLength;
+
+        /* Only our own frames carry our clock */
+        if ((perf.cfg.mode & QCA_PERF_TX) && hdr->run == perf.run)
+        {
+            uint32_t rtt = (uint32_t)(now - hdr->tx_time);
+            perf.cnt.rtt_sum += rtt;
+            perf.cnt.rtt_count++;
+            if (rtt > perf.rtt_max)
+                perf.rtt_max = rtt;
+            if (rtt > perf.rtt_max_total)
+                perf.rtt_max_total = rtt;
+        }
+        portEXIT_CRITICAL(&perf_lock);
+    }
+
+    qca_free_desc(rxDesc);
+    return true;
+}
+
+esp_err_t qca_perf_start(const qca_perf_config_t *cfg)
+{
+    const esp_timer_create_args_t report_timer_args = {
+        .callback        = qca_perf_report,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name            = "qca_perf",
+    };
+
+    if (perf.running)
+        return ESP_ERR_INVALID_STATE;
+    if (cfg->frame_len < sizeof(qca_perf_hdr_t) || cfg->frame_len > QCAFRM_ETHMAXLEN)
+        return ESP_ERR_INVALID_SIZE;
+
+    if (perf.report_timer == NULL)
+        ESP_ERROR_CHECK(esp_timer_create(&report_timer_args, &perf.report_timer));
+
+    perf.cfg = *cfg;
+    if (perf.cfg.ethertype == 0)
+        perf.cfg.ethertype = QCA_PERF_ETHERTYPE;
+
+    portENTER_CRITICAL(&perf_lock);
+    memset(&perf.cnt, 0, sizeof(perf.cnt));
+    perf.rtt_max       = 0;
+    perf.rtt_max_total = 0;
+    perf.rx_synced     = false;
+    portEXIT_CRITICAL(&perf_lock);
+
+    perf.run = (uint32_t)esp_timer_get_time();
+    qca_perf_snapshot(&perf.base);
+    perf.last    = perf.base;
+    perf.running = true;
+
+    if (perf.cfg.mode & QCA_PERF_TX)
+    {
+        TaskHandle_t task;
+        if (xTaskCreatePinnedToCore(qca_perf_tx_task, "qca_perf", 3072, NULL, QCA_PERF_TASK_PRIO, &task,
+                                    APP_CPU_NUM)
+            != pdPASS)
+        {
+            perf.running = false;
+            return ESP_ERR_NO_MEM;
+        }
+        perf.tx_task = task;
+    }
+
+    ESP_ERROR_CHECK(esp_timer_start_periodic(perf.report_timer, 1000000));
+    return ESP_OK;
+}
+
+void qca_perf_stop(void)
+{
+    if (!perf.running)
+        return;
+
+    perf.running = false;
+    while (perf.tx_task != NULL) vTaskDelay(1);
+
+    esp_timer_stop(perf.report_timer);
+    qca_perf_report(NULL);
+}
+
+void qca_perf_set_report_cb(qca_perf_report_cb_t cb)
+{
+    perf.report_cb = cb;
+}
+
+void qca_perf_get_totals(qca_perf_report_t *totals)
+{
+    qca_perf_counters_t cur;
+
+    qca_perf_snapshot(&cur);
+    qca_perf_fill(totals, &cur, &perf.base, perf.rtt_max_total);
+}
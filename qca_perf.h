@@ -0,0 +1,108 @@
+/*====================================================================*
+ *
+ *   qca_perf.h
+ *
+ *   Traffic generator and sink for throughput measurements.
+ *
+ *   TX sends numbered frames of a given size, ethertype and rate
+ *   through qca_send. RX takes those frames from the receive path,
+ *   checks their sequence numbers and drops them; ECHO sends them back
+ *   to where they came from. Every second a report with pps, Mbit/s,
+ *   loss, reordering, latency (echoed frames only) and SPI thread load
+ *   is passed to the report callback.
+ *
+ *   Two nodes: TX|RX on one and ECHO on the other measures the round
+ *   trip, TX on one and RX on the other a single direction. The host
+ *   build runs the same code against the QCA7000 model in loopback,
+ *   see tools/qca_perf_host.c.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA_PERF_HEADER
+#define QCA_PERF_HEADER
+
+#include "qca_spi.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define QCA_PERF_ETH_ALEN 6
+
+/* IEEE 802 local experimental ethertype */
+#ifndef QCA_PERF_ETHERTYPE
+#define QCA_PERF_ETHERTYPE 0x88B5
+#endif
+
+#ifndef QCA_PERF_TASK_PRIO
+#define QCA_PERF_TASK_PRIO (tskIDLE_PRIORITY + 5)
+#endif
+
+#define QCA_PERF_TX   (1 << 0)
+#define QCA_PERF_RX   (1 << 1)
+#define QCA_PERF_ECHO (1 << 2) /* Needs QCASPI_TX_MULTI_PRODUCER together with QCA_PERF_TX */
+
+typedef struct {
+    uint8_t mode;       /* QCA_PERF_TX | QCA_PERF_RX | QCA_PERF_ECHO */
+    uint16_t frame_len; /* Ethernet frame length, at least the perf header */
+    uint32_t rate_pps;  /* TX rate, 0 for as fast as the TX ring takes them */
+    uint16_t ethertype; /* 0 for QCA_PERF_ETHERTYPE */
+    uint8_t dest[QCA_PERF_ETH_ALEN];
+    uint8_t src[QCA_PERF_ETH_ALEN];
+} qca_perf_config_t;
+
+/* One reporting interval */
+typedef struct {
+    uint32_t interval_ms;
+    uint32_t tx_frames;
+    uint32_t tx_busy; /* qca_send refused, TX ring full */
+    uint32_t tx_pps;
+    uint32_t tx_kbps;
+    uint32_t rx_frames;
+    uint32_t rx_lost; /* Sequence gaps, net of late arrivals */
+    uint32_t rx_reordered;
+    uint32_t rx_pps;
+    uint32_t rx_kbps;
+    uint32_t rtt_avg_us; /* Echoed frames, 0 if none */
+    uint32_t rtt_max_us;
+    uint16_t spi_load; /* SPI thread busy time, per mille */
+} qca_perf_report_t;
+
+/* Called from the esp_timer task once a second */
+typedef void (*qca_perf_report_cb_t)(const qca_perf_report_t *report);
+
+/*====================================================================*
+ *
+ *   qca_perf_start
+ *
+ *   Reset the counters and start the modes in cfg. TX runs in its own
+ *   task; RX and ECHO run in the receiving task through qca_perf_rx.
+ *
+ *   Return: ESP_ERR_INVALID_STATE    Already running
+ *           ESP_ERR_INVALID_SIZE     frame_len out of range
+ *
+ *--------------------------------------------------------------------*/
+
+esp_err_t qca_perf_start(const qca_perf_config_t *cfg);
+
+/* Stop and wait for the TX task to end, then send the final report */
+void qca_perf_stop(void);
+
+/*====================================================================*
+ *
+ *   qca_perf_rx
+ *
+ *   Offer a received frame to the sink, from the task that calls
+ *   qca_recv.
+ *
+ *   Return: true if it was a perf frame, which is then consumed.
+ *
+ *--------------------------------------------------------------------*/
+
+bool qca_perf_rx(NetworkBufferDescriptor_t *rxDesc);
+
+/* NULL restores the default, which logs the report */
+void qca_perf_set_report_cb(qca_perf_report_cb_t cb);
+
+/* Totals since qca_perf_start, interval_ms is the run time */
+void qca_perf_get_totals(qca_perf_report_t *totals);
+
+#endif
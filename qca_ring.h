@@ -0,0 +1,207 @@
+/*====================================================================*
+ *
+ *   qca_ring.h
+ *
+ *   Lock-free single-producer/single-consumer ring of pointers.
+ *
+ *   The producer only writes head, the consumer only writes tail,
+ *   each on its own cache line. Both sides keep a cached copy of the
+ *   other index and only reload it when the ring looks full/empty.
+ *   The depth must be a power of two.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA_RING_HEADER
+#define QCA_RING_HEADER
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "qca_iram.h"
+
+#ifndef QCA_RING_CACHE_LINE
+#define QCA_RING_CACHE_LINE 32
+#endif
+
+#define QCA_RING_IS_POW2(n) ((n) != 0 && ((n) & ((n)-1)) == 0)
+
+typedef struct {
+    /* Producer side */
+    _Atomic(uint32_t) head __attribute__((aligned(QCA_RING_CACHE_LINE)));
+    uint32_t tail_cache;
+    uint32_t peak; /* Most entries seen by a push */
+
+    /* Consumer side */
+    _Atomic(uint32_t) tail __attribute__((aligned(QCA_RING_CACHE_LINE)));
+    uint32_t head_cache;
+
+    /* Read only after init */
+    uint32_t mask __attribute__((aligned(QCA_RING_CACHE_LINE)));
+    void **slots;
+} qca_ring_t;
+
+/*====================================================================*
+ *
+ *   qca_ring_init
+ *
+ *   Allocate the slots of a ring with depth entries.
+ *
+ *   Return: false if depth is not a power of two or on allocation failure.
+ *
+ *--------------------------------------------------------------------*/
+
+static inline bool qca_ring_init(qca_ring_t *ring, uint32_t depth)
+{
+    if (!QCA_RING_IS_POW2(depth))
+        return false;
+
+    ring->slots = (void **)calloc(depth, sizeof(void *));
+    if (ring->slots == NULL)
+        return false;
+
+    ring->mask       = depth - 1;
+    ring->tail_cache = 0;
+    ring->head_cache = 0;
+    ring->peak       = 0;
+    atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+    return true;
+}
+
+QCA_INLINE uint32_t qca_ring_depth(const qca_ring_t *ring)
+{
+    return ring->mask + 1;
+}
+
+/* Number of queued entries, exact for either side, a snapshot for others */
+QCA_INLINE uint32_t qca_ring_count(qca_ring_t *ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_acquire)
+         - atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+QCA_INLINE bool qca_ring_empty(qca_ring_t *ring)
+{
+    return qca_ring_count(ring) == 0;
+}
+
+/* Free slots, a snapshot for any side; leaves the producer's tail_cache alone */
+QCA_INLINE uint32_t qca_ring_free(qca_ring_t *ring)
+{
+    return qca_ring_depth(ring) - qca_ring_count(ring);
+}
+
+/* Producer: free slots */
+QCA_INLINE uint32_t qca_ring_space(qca_ring_t *ring)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    ring->tail_cache = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return qca_ring_depth(ring) - (head - ring->tail_cache);
+}
+
+/*====================================================================*
+ *
+ *   qca_ring_push_n
+ *
+ *   Producer: append up to n entries with a single head update.
+ *
+ *   Return: The number of entries pushed. *was_empty (optional) is set
+ *   when the consumer had drained the ring right before this push, so
+ *   the caller only needs to wake it on that transition.
+ *
+ *--------------------------------------------------------------------*/
+
+QCA_INLINE uint32_t qca_ring_push_n(qca_ring_t *ring, void *const *items, uint32_t n, bool *was_empty)
+{
+    uint32_t head  = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t space = qca_ring_depth(ring) - (head - ring->tail_cache);
+    uint32_t i, tail;
+
+    if (space < n)
+    {
+        ring->tail_cache = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        space            = qca_ring_depth(ring) - (head - ring->tail_cache);
+        if (n > space)
+            n = space;
+    }
+
+    for (i = 0; i < n; i++) ring->slots[(head + i) & ring->mask] = items[i];
+
+    if (n)
+        atomic_store_explicit(&ring->head, head + n, memory_order_seq_cst);
+
+    /* Read tail after publishing head; pairs with the consumer storing its
+     * waiter before re-checking head (see qca_ring_pop_n). The same read
+     * gives the fill level for the high-water mark. */
+    tail = atomic_load_explicit(&ring->tail, memory_order_seq_cst);
+    if (was_empty)
+        *was_empty = n && tail == head;
+    if (head + n - tail > ring->peak)
+        ring->peak = head + n - tail;
+
+    return n;
+}
+
+QCA_INLINE bool qca_ring_push(qca_ring_t *ring, void *item, bool *was_empty)
+{
+    return qca_ring_push_n(ring, &item, 1, was_empty) == 1;
+}
+
+/*====================================================================*
+ *
+ *   qca_ring_pop_n
+ *
+ *   Consumer: take up to max entries with a single tail update.
+ *
+ *   Return: The number of entries taken.
+ *
+ *--------------------------------------------------------------------*/
+
+QCA_INLINE uint32_t qca_ring_pop_n(qca_ring_t *ring, void **items, uint32_t max)
+{
+    uint32_t tail  = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t avail = ring->head_cache - tail;
+    uint32_t i;
+
+    if (avail < max)
+    {
+        ring->head_cache = atomic_load_explicit(&ring->head, memory_order_seq_cst);
+        avail            = ring->head_cache - tail;
+    }
+    if (max > avail)
+        max = avail;
+
+    for (i = 0; i < max; i++) items[i] = ring->slots[(tail + i) & ring->mask];
+
+    if (max)
+        atomic_store_explicit(&ring->tail, tail + max, memory_order_seq_cst);
+
+    return max;
+}
+
+QCA_INLINE void *qca_ring_pop(qca_ring_t *ring)
+{
+    void *item = NULL;
+
+    qca_ring_pop_n(ring, &item, 1);
+    return item;
+}
+
+/* Consumer: oldest entry without removing it, NULL if empty */
+QCA_INLINE void *qca_ring_peek(qca_ring_t *ring)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    if (ring->head_cache == tail)
+    {
+        ring->head_cache = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (ring->head_cache == tail)
+            return NULL;
+    }
+    return ring->slots[tail & ring->mask];
+}
+
+#endif
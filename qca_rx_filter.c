@@ -0,0 +1,253 @@
+/*====================================================================*
+ *
+ *   qca_rx_filter.c
+ *
+ *   Early RX drop on destination MAC and ethertype.
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca_rx_filter.h"
+#include "qca_driver.h"
+#include <string.h>
+
+typedef struct {
+    uint8_t mac[QCA_RX_FILTER_MACS][QCA_RX_FILTER_ETH_ALEN];
+    uint8_t mac_count;
+    uint64_t mcast_hash;
+    bool bcast;
+    qca_rx_filter_mode_t mode;
+    uint16_t ethertype[QCA_RX_FILTER_ETHERTYPES];
+    uint8_t ethertype_count;
+} qca_rx_filter_table_t;
+
+static qca_rx_filter_table_t table = {.bcast = true};
+static qca_rx_filter_stats_t filter_stats;
+static portMUX_TYPE filter_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Top 6 bits of the Ethernet CRC of the address, as in most MAC hash filters */
+static uint8_t QCA_IRAM_ATTR qca_rx_filter_hash(const uint8_t *mac)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    int i, bit;
+
+    for (i = 0; i < QCA_RX_FILTER_ETH_ALEN; i++)
+    {
+        crc ^= mac[i];
+        for (bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return (~crc) >> 26;
+}
+
+static int QCA_IRAM_ATTR qca_rx_filter_find_mac(const uint8_t *mac)
+{
+    int i;
+
+    for (i = 0; i < table.mac_count; i++)
+        if (memcmp(table.mac[i], mac, QCA_RX_FILTER_ETH_ALEN) == 0)
+            return i;
+    return -1;
+}
+
+static int QCA_IRAM_ATTR qca_rx_filter_find_ethertype(uint16_t ethertype)
+{
+    int i;
+
+    for (i = 0; i < table.ethertype_count; i++)
+        if (table.ethertype[i] == ethertype)
+            return i;
+    return -1;
+}
+
+/*====================================================================*
+ *
+ *   qca_rx_filter_check
+ *
+ *   Called from the SPI thread with the Ethernet header of a frame.
+ *
+ *   Return: true if the frame passes.
+ *
+ *--------------------------------------------------------------------*/
+
+static bool QCA_IRAM_ATTR qca_rx_filter_check(const uint8_t *hdr)
+{
+    static const uint8_t QCA_DRAM_ATTR bcast[QCA_RX_FILTER_ETH_ALEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    uint16_t ethertype = (uint16_t)((hdr[12] << 8) | hdr[13]);
+    bool pass          = false;
+    int i;
+
+    portENTER_CRITICAL(&filter_lock);
+
+    if (memcmp(hdr, bcast, sizeof(bcast)) == 0)
+    {
+        if (table.bcast)
+        {
+            filter_stats.bcast_hits++;
+            pass = true;
+        }
+        else
+        {
+            filter_stats.drop_bcast++;
+        }
+    }
+    else if (hdr[0] & 0x01)
+    {
+        if (table.mcast_hash & (1ULL << qca_rx_filter_hash(hdr)))
+        {
+            filter_stats.mcast_hits++;
+            pass = true;
+        }
+        else
+        {
+            filter_stats.drop_mcast++;
+        }
+    }
+    else if ((i = qca_rx_filter_find_mac(hdr)) >= 0)
+    {
+        filter_stats.mac_hits[i]++;
+        pass = true;
+    }
+    else
+    {
+        filter_stats.drop_unicast++;
+    }
+
+    if (pass)
+    {
+        i = qca_rx_filter_find_ethertype(ethertype);
+        if (i >= 0)
+            filter_stats.ethertype_hits[i]++;
+
+        pass = (table.mode == QCA_RX_FILTER_ALLOW) ? (i >= 0) : (i < 0);
+        if (!pass)
+            filter_stats.drop_ethertype++;
+    }
+
+    portEXIT_CRITICAL(&filter_lock);
+    return pass;
+}
+
+void qca_rx_filter_enable(bool enable)
+{
+    qca.rx_filter = enable ? qca_rx_filter_check : NULL;
+}
+
+esp_err_t qca_rx_filter_add_mac(const uint8_t *mac)
+{
+    esp_err_t ret = ESP_OK;
+
+    if (mac[0] & 0x01)
+        return ESP_ERR_INVALID_ARG;
+
+    portENTER_CRITICAL(&filter_lock);
+    if (qca_rx_filter_find_mac(mac) < 0)
+    {
+        if (table.mac_count < QCA_RX_FILTER_MACS)
+        {
+            memcpy(table.mac[table.mac_count], mac, QCA_RX_FILTER_ETH_ALEN);
+            filter_stats.mac_hits[table.mac_count] = 0;
+            table.mac_count++;
+        }
+        else
+        {
+            ret = ESP_ERR_NO_MEM;
+        }
+    }
+    portEXIT_CRITICAL(&filter_lock);
+    return ret;
+}
+
+esp_err_t qca_rx_filter_del_mac(const uint8_t *mac)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    int i;
+
+    portENTER_CRITICAL(&filter_lock);
+    if ((i = qca_rx_filter_find_mac(mac)) >= 0)
+    {
+        /* Keep the set dense, the counters move with their entries */
+        table.mac_count--;
+        memmove(table.mac[i], table.mac[i + 1], (table.mac_count - i) * QCA_RX_FILTER_ETH_ALEN);
+        memmove(&filter_stats.mac_hits[i], &filter_stats.mac_hits[i + 1],
+                (table.mac_count - i) * sizeof(filter_stats.mac_hits[0]));
+        ret = ESP_OK;
+    }
+    portEXIT_CRITICAL(&filter_lock);
+    return ret;
+}
+
+void qca_rx_filter_add_mcast(const uint8_t *mac)
+{
+    uint8_t bit = qca_rx_filter_hash(mac);
+
+    portENTER_CRITICAL(&filter_lock);
+    table.mcast_hash |= 1ULL << bit;
+    portEXIT_CRITICAL(&filter_lock);
+}
+
+void qca_rx_filter_clear_mcast(void)
+{
+    portENTER_CRITICAL(&filter_lock);
+    table.mcast_hash = 0;
+    portEXIT_CRITICAL(&filter_lock);
+}
+
+void qca_rx_filter_set_broadcast(bool accept)
+{
+    portENTER_CRITICAL(&filter_lock);
+    table.bcast = accept;
+    portEXIT_CRITICAL(&filter_lock);
+}
+
+void qca_rx_filter_set_ethertype_mode(qca_rx_filter_mode_t mode)
+{
+    portENTER_CRITICAL(&filter_lock);
+    table.mode = mode;
+    portEXIT_CRITICAL(&filter_lock);
+}
+
+esp_err_t qca_rx_filter_add_ethertype(uint16_t ethertype)
+{
+    esp_err_t ret = ESP_OK;
+
+    portENTER_CRITICAL(&filter_lock);
+    if (qca_rx_filter_find_ethertype(ethertype) < 0)
+    {
+        if (table.ethertype_count < QCA_RX_FILTER_ETHERTYPES)
+        {
+            table.ethertype[table.ethertype_count]            = ethertype;
+            filter_stats.ethertype_hits[table.ethertype_count] = 0;
+            table.ethertype_count++;
+        }
+        else
+        {
+            ret = ESP_ERR_NO_MEM;
+        }
+    }
+    portEXIT_CRITICAL(&filter_lock);
+    return ret;
+}
+
+esp_err_t qca_rx_filter_del_ethertype(uint16_t ethertype)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    int i;
+
+    portENTER_CRITICAL(&filter_lock);
+    if ((i = qca_rx_filter_find_ethertype(ethertype)) >= 0)
+    {
+        table.ethertype_count--;
+        memmove(&table.ethertype[i], &table.ethertype[i + 1], (table.ethertype_count - i) * sizeof(table.ethertype[0]));
+        memmove(&filter_stats.ethertype_hits[i], &filter_stats.ethertype_hits[i + 1],
+                (table.ethertype_count - i) * sizeof(filter_stats.ethertype_hits[0]));
+        ret = ESP_OK;
+    }
+    portEXIT_CRITICAL(&filter_lock);
+    return ret;
+}
+
+void qca_rx_filter_get_stats(qca_rx_filter_stats_t *stats)
+{
+    portENTER_CRITICAL(&filter_lock);
+    *stats = filter_stats;
+    portEXIT_CRITICAL(&filter_lock);
+}
@@ -0,0 +1,86 @@
+/*====================================================================*
+ *
+ *   qca_rx_filter.h
+ *
+ *   Early RX drop on destination MAC and ethertype.
+ *
+ *   While a filter is enabled the SPI thread reads the Ethernet header
+ *   together with the QCA7k header and checks it before the rest of
+ *   the frame is read. Rejected frames are read into the spare RX
+ *   descriptor and overwritten by the next frame: nothing is
+ *   allocated, queued or seen by qca_recv.
+ *
+ *   A frame passes if its destination passes the MAC stage and its
+ *   ethertype passes the ethertype stage:
+ *     - unicast:   in the exact MAC set
+ *     - multicast: its bit set in the 64 bit multicast hash
+ *     - broadcast: broadcast accepted
+ *     - ethertype: in the list (allow mode) or not in it (deny mode);
+ *                  the outer one, 0x8100 for VLAN tagged frames
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA_RX_FILTER_HEADER
+#define QCA_RX_FILTER_HEADER
+
+#include "qca_spi.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef QCA_RX_FILTER_MACS
+#define QCA_RX_FILTER_MACS 4
+#endif
+
+#ifndef QCA_RX_FILTER_ETHERTYPES
+#define QCA_RX_FILTER_ETHERTYPES 4
+#endif
+
+#define QCA_RX_FILTER_ETH_ALEN 6
+
+typedef enum
+{
+    QCA_RX_FILTER_DENY = 0, /* Listed ethertypes are dropped (empty list: all pass) */
+    QCA_RX_FILTER_ALLOW,    /* Only listed ethertypes pass */
+} qca_rx_filter_mode_t;
+
+/* Per rule hit counters */
+typedef struct {
+    uint32_t mac_hits[QCA_RX_FILTER_MACS];
+    uint32_t ethertype_hits[QCA_RX_FILTER_ETHERTYPES];
+    uint32_t mcast_hits;
+    uint32_t bcast_hits;
+    uint32_t drop_unicast;   /* Unicast not in the MAC set */
+    uint32_t drop_mcast;     /* Multicast not in the hash */
+    uint32_t drop_bcast;     /* Broadcast while not accepted */
+    uint32_t drop_ethertype; /* Rejected by the ethertype stage */
+} qca_rx_filter_stats_t;
+
+/*====================================================================*
+ *
+ *   qca_rx_filter_enable
+ *
+ *   Start or stop filtering. A freshly enabled filter accepts nothing
+ *   but broadcast until MACs are added.
+ *
+ *--------------------------------------------------------------------*/
+
+void qca_rx_filter_enable(bool enable);
+
+/* Exact unicast destinations. Return: ESP_ERR_NO_MEM when the set is full */
+esp_err_t qca_rx_filter_add_mac(const uint8_t *mac);
+esp_err_t qca_rx_filter_del_mac(const uint8_t *mac);
+
+/* Multicast destinations, hashed: unrelated groups may share a bit */
+void qca_rx_filter_add_mcast(const uint8_t *mac);
+void qca_rx_filter_clear_mcast(void);
+
+void qca_rx_filter_set_broadcast(bool accept);
+
+/* Ethertype stage. Return: ESP_ERR_NO_MEM when the list is full */
+void qca_rx_filter_set_ethertype_mode(qca_rx_filter_mode_t mode);
+esp_err_t qca_rx_filter_add_ethertype(uint16_t ethertype);
+esp_err_t qca_rx_filter_del_ethertype(uint16_t ethertype);
+
+void qca_rx_filter_get_stats(qca_rx_filter_stats_t *stats);
+
+#endif
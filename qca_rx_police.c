@@ -0,0 +1,134 @@
+/*====================================================================*
+ *
+ *   qca_rx_police.c
+ *
+ *   Per-class RX rate limits against broadcast storms.
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca_rx_police.h"
+#include "qca_driver.h"
+#include "qca_mme.h"
+#include <string.h>
+
+/* Token bucket kept as the time it is full again (GCRA): a frame
+ * conforms while that lies less than burst - 1 frames ahead */
+typedef struct {
+    qca_rx_police_rule_t rule;
+    int64_t interval_us;  /* One token */
+    int64_t tolerance_us; /* burst - 1 tokens */
+    int64_t tat;          /* Theoretical arrival time of the next frame */
+    int64_t blocked_until;
+} qca_rx_police_bucket_t;
+
+static qca_rx_police_bucket_t buckets[QCA_RX_POLICE_CLASSES];
+static qca_rx_police_stats_t police_stats;
+static portMUX_TYPE police_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Return: the class, QCA_RX_POLICE_CLASSES for unlimited unicast */
+static qca_rx_police_class_t QCA_IRAM_ATTR qca_rx_police_classify(const uint8_t *hdr)
+{
+    uint16_t ethertype = (uint16_t)((hdr[12] << 8) | hdr[13]);
+
+    if (ethertype == QCA_MME_ETHERTYPE)
+        return QCA_RX_POLICE_MME;
+    if (ethertype == 0x0800 || ethertype == 0x0806 || ethertype == 0x86DD)
+        return QCA_RX_POLICE_IP;
+    if ((hdr[0] & hdr[1] & hdr[2] & hdr[3] & hdr[4] & hdr[5]) == 0xFF)
+        return QCA_RX_POLICE_BCAST;
+    if (hdr[0] & 0x01)
+        return QCA_RX_POLICE_MCAST;
+    return QCA_RX_POLICE_CLASSES;
+}
+
+/*====================================================================*
+ *
+ *   qca_rx_police_check
+ *
+ *   Called from the SPI thread with the Ethernet header of a frame.
+ *
+ *   Return: true if the frame passes.
+ *
+ *--------------------------------------------------------------------*/
+
+static bool QCA_IRAM_ATTR qca_rx_police_check(const uint8_t *hdr)
+{
+    qca_rx_police_class_t cls = qca_rx_police_classify(hdr);
+    int64_t now;
+    qca_rx_police_bucket_t *b;
+    bool pass = true;
+
+    if (cls == QCA_RX_POLICE_CLASSES)
+        return true;
+
+    b   = &buckets[cls];
+    now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&police_lock);
+
+    if (b->rule.rate_pps != 0)
+    {
+        if (b->blocked_until > now)
+        {
+            pass = false;
+        }
+        else
+        {
+            if (b->tat < now)
+                b->tat = now;
+
+            if (b->tat - now > b->tolerance_us)
+            {
+                pass = false;
+                if (b->rule.action == QCA_RX_POLICE_BLOCK)
+                {
+                    b->blocked_until = now + (int64_t)b->rule.block_ms * 1000;
+                    police_stats.blocks[cls]++;
+                }
+            }
+            else
+            {
+                b->tat += b->interval_us;
+            }
+        }
+    }
+
+    if (pass)
+        police_stats.passed[cls]++;
+    else
+        police_stats.dropped[cls]++;
+
+    portEXIT_CRITICAL(&police_lock);
+    return pass;
+}
+
+esp_err_t qca_rx_police_set(qca_rx_police_class_t cls, const qca_rx_police_rule_t *rule)
+{
+    qca_rx_police_bucket_t *b;
+
+    if (cls >= QCA_RX_POLICE_CLASSES || rule->rate_pps > 1000000 || (rule->rate_pps != 0 && rule->burst == 0))
+        return ESP_ERR_INVALID_ARG;
+
+    b = &buckets[cls];
+    portENTER_CRITICAL(&police_lock);
+    b->rule          = *rule;
+    b->interval_us   = rule->rate_pps ? 1000000 / rule->rate_pps : 0;
+    b->tolerance_us  = rule->rate_pps ? (int64_t)(rule->burst - 1) * b->interval_us : 0;
+    b->tat           = 0;
+    b->blocked_until = 0;
+    portEXIT_CRITICAL(&police_lock);
+
+    return ESP_OK;
+}
+
+void qca_rx_police_enable(bool enable)
+{
+    qca.rx_police = enable ? qca_rx_police_check : NULL;
+}
+
+void qca_rx_police_get_stats(qca_rx_police_stats_t *stats)
+{
+    portENTER_CRITICAL(&police_lock);
+    *stats = police_stats;
+    portEXIT_CRITICAL(&police_lock);
+}
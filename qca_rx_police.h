@@ -0,0 +1,86 @@
+/*====================================================================*
+ *
+ *   qca_rx_police.h
+ *
+ *   Per-class RX rate limits against broadcast storms.
+ *
+ *   While enabled the SPI thread reads the Ethernet header together
+ *   with the QCA7k header, as for the RX filter, and charges the frame
+ *   to one class:
+ *     - MME:       ethertype 0x88E1, HomePlug AV management
+ *     - IP:        ethertype 0x0800, 0x0806 or 0x86DD (IPv4, ARP, IPv6)
+ *     - broadcast: any other frame to ff:ff:ff:ff:ff:ff
+ *     - multicast: any other frame to a group address
+ *   Other unicast frames are not limited. Each class has a token
+ *   bucket of rate_pps frames per second and burst frames depth. A
+ *   frame finding it empty is dropped, read into the spare RX
+ *   descriptor like a filtered one; with QCA_RX_POLICE_BLOCK the whole
+ *   class is then dropped for block_ms, as switch storm control does.
+ *
+ *   The buckets run on frames, not bytes: a storm of small frames
+ *   costs the SPI thread per frame.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA_RX_POLICE_HEADER
+#define QCA_RX_POLICE_HEADER
+
+#include "qca_spi.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum
+{
+    QCA_RX_POLICE_BCAST = 0,
+    QCA_RX_POLICE_MCAST,
+    QCA_RX_POLICE_MME,
+    QCA_RX_POLICE_IP,
+    QCA_RX_POLICE_CLASSES,
+} qca_rx_police_class_t;
+
+typedef enum
+{
+    QCA_RX_POLICE_DROP = 0, /* Drop what exceeds the bucket */
+    QCA_RX_POLICE_BLOCK,    /* Drop the class for block_ms once it exceeds the bucket */
+} qca_rx_police_action_t;
+
+typedef struct {
+    uint32_t rate_pps; /* 0 for no limit */
+    uint32_t burst;    /* Bucket depth in frames, at least 1 */
+    qca_rx_police_action_t action;
+    uint32_t block_ms;
+} qca_rx_police_rule_t;
+
+typedef struct {
+    uint32_t passed[QCA_RX_POLICE_CLASSES];
+    uint32_t dropped[QCA_RX_POLICE_CLASSES];
+    uint32_t blocks[QCA_RX_POLICE_CLASSES]; /* Times the class was blocked */
+} qca_rx_police_stats_t;
+
+/*====================================================================*
+ *
+ *   qca_rx_police_set
+ *
+ *   Set the limit of one class; its bucket starts full.
+ *
+ *   Return: ESP_ERR_INVALID_ARG      No such class, or a rate with
+ *                                    burst 0 or above 1000000 pps
+ *
+ *--------------------------------------------------------------------*/
+
+esp_err_t qca_rx_police_set(qca_rx_police_class_t cls, const qca_rx_police_rule_t *rule);
+
+/*====================================================================*
+ *
+ *   qca_rx_police_enable
+ *
+ *   Start or stop policing. Works alongside the RX filter, which sees
+ *   every frame first.
+ *
+ *--------------------------------------------------------------------*/
+
+void qca_rx_police_enable(bool enable);
+
+void qca_rx_police_get_stats(qca_rx_police_stats_t *stats);
+
+#endif
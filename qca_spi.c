@@ -22,140 +22,298 @@
 /* QCA7k includes */
 #include "byte_order.h"
 #include "qca_7k.h"
+#include "qca_buf.h"
 #include "qca_framing.h"
 #include "qca_spi.h"
+#include <stdlib.h>
 #include <string.h>
 
 static uint16_t available = 0;
 
 static const char *TAG = "qca_spi";
 
-static void start_spi_intr_handling(qcaspi_t *qca, uint16_t *intr_cause)
+static void QCA_IRAM_ATTR start_spi_intr_handling(qcaspi_t *qca, uint16_t *intr_cause)
 {
     *intr_cause = 0;
     qcaspi_write_register(qca, SPI_REG_INTR_ENABLE, 0);
     *intr_cause = qcaspi_read_register(qca, SPI_REG_INTR_CAUSE);
 }
 
-static void end_spi_intr_handling(qcaspi_t *qca, uint16_t intr_cause)
+static void QCA_IRAM_ATTR end_spi_intr_handling(qcaspi_t *qca, uint16_t intr_cause)
 {
     uint16_t intr_enable = (SPI_INT_CPU_ON | SPI_INT_PKT_AVLBL | SPI_INT_RDBUF_ERR | SPI_INT_WRBUF_ERR);
     qcaspi_write_register(qca, SPI_REG_INTR_CAUSE, intr_cause);
     qcaspi_write_register(qca, SPI_REG_INTR_ENABLE, intr_enable);
 }
 
-uint16_t qcaspi_write_burst(qcaspi_t *qca, uint8_t *src, uint16_t len)
+/* Announce the burst length in SPI_REG_BFR_SIZE, then run the burst,
+ * in one bus batch */
+static void QCA_IRAM_ATTR qcaspi_burst(qcaspi_t *qca, uint16_t cmd, uint16_t bfr_size, const void *tx, void *rx,
+                                       uint16_t len)
 {
-    QcaFrmCreateHeader(src, len);
-    QcaFrmCreateFooter(src + QCAFRM_HEADER_LEN + len);
+    uint16_t size = __cpu_to_be16(bfr_size);
 
-    spi_transaction_t t = {0};
+    qca_bus_xfer_t x[2] = {
+        {.cmd = QCA7K_SPI_WRITE | QCA7K_SPI_INTERNAL | SPI_REG_BFR_SIZE, .tx = &size, .len = 2},
+        {.cmd = cmd, .tx = tx, .rx = rx, .len = len},
+    };
 
-    t.cmd         = (QCA7K_SPI_WRITE | QCA7K_SPI_EXTERNAL);
-    t.length      = (len + QCAFRM_FRAME_OVERHEAD) * 8;
-    t.tx_buffer   = src;
-    t.rx_buffer   = NULL;
-    t.rxlength    = 0;
-    esp_err_t err = spi_device_transmit(qca->handle, &t);
+    if (len > qca->spi_xfer_peak)
+        qca->spi_xfer_peak = len;
+
+    esp_err_t err = qca->bus.xfer(qca->bus.ctx, x, 2);
     ESP_ERROR_CHECK(err);
+}
+
+/* src holds a frame of len bytes framed by QcaFrmEncapsulate */
+uint16_t QCA_IRAM_ATTR qcaspi_write_burst(qcaspi_t *qca, uint8_t *src, uint16_t len)
+{
+    qcaspi_burst(qca, QCA7K_SPI_WRITE | QCA7K_SPI_EXTERNAL, len + QCAFRM_FRAME_OVERHEAD, src, NULL,
+                 len + QCAFRM_FRAME_OVERHEAD);
 
     return len;
 }
 
 uint16_t qcaspi_read_blocking(qcaspi_t *qca, uint8_t *dst, uint16_t len)
 {
-    qcaspi_write_register(qca, SPI_REG_BFR_SIZE, len);
+    qcaspi_burst(qca, QCA7K_SPI_READ | QCA7K_SPI_EXTERNAL, len, NULL, dst, len);
 
-    spi_transaction_t t = {0};
+    available -= len;
 
-    t.cmd         = (QCA7K_SPI_READ | QCA7K_SPI_EXTERNAL);
-    t.length      = 0;
-    t.tx_buffer   = NULL;
-    t.rx_buffer   = dst;
-    t.rxlength    = (len)*8;
-    esp_err_t err = spi_device_transmit(qca->handle, &t);
+    return len;
+}
 
-    ESP_ERROR_CHECK(err);
+uint16_t QCA_IRAM_ATTR qcaspi_read_burst(qcaspi_t *qca, uint8_t *dst, uint16_t len)
+{
+    qcaspi_burst(qca, QCA7K_SPI_READ | QCA7K_SPI_EXTERNAL, len, NULL, dst, len);
 
     available -= len;
 
     return len;
 }
 
-uint16_t qcaspi_read_burst(qcaspi_t *qca, uint8_t *dst, uint16_t len)
+uint16_t QCA_IRAM_ATTR qcaspi_tx_frame(qcaspi_t *qca, NetworkBufferDescriptor_t *txBuffer)
 {
-    qcaspi_write_register(qca, SPI_REG_BFR_SIZE, len);
+    uint16_t writtenBytes = 0;
 
-    spi_transaction_t t = {0};
+    uint8_t *pucData = txBuffer->pucEthernetBuffer;
+    uint16_t len     = QcaFrmEncapsulate(pucData, txBuffer->xDataLength);
 
-    t.cmd       = (QCA7K_SPI_READ | QCA7K_SPI_EXTERNAL);
-    t.length    = 0;
-    t.tx_buffer = NULL;
-    t.rx_buffer = dst;
-    t.rxlength  = (len)*8;
+    /* send ethernet packet via DMA to SPI */
+    writtenBytes = qcaspi_write_burst(qca, pucData, len);
+    return writtenBytes;
+}
 
-    esp_err_t err = spi_device_transmit(qca->handle, &t);
-    ESP_ERROR_CHECK(err);
+void QCA_IRAM_ATTR qcaspi_tx_complete(qcaspi_t *qca, NetworkBufferDescriptor_t *txBuffer, qca_tx_status_t status)
+{
+    txBuffer->xDoneTime = esp_timer_get_time();
 
-    available -= len;
+    if (qca->tx_replay > 0)
+    {
+        qca->tx_replay--;
+        if (status == QCA_TX_SENT)
+            qca->stats.tx_replayed++;
+    }
 
-    return len;
+    if (status == QCA_TX_SENT && qca->tx_report_cb != NULL)
+        qca->tx_report_cb(txBuffer);
+
+    if (txBuffer->pxTxComplete != NULL)
+    {
+        /* A static descriptor may be sent again as soon as it is reported */
+        bool owned = !txBuffer->xStatic;
+
+        txBuffer->pxTxComplete(txBuffer->pvTxContext, status);
+        if (owned)
+            free(txBuffer);
+    }
+    else
+    {
+        qca_free_desc(txBuffer);
+    }
 }
 
-uint16_t qcaspi_tx_frame(qcaspi_t *qca, NetworkBufferDescriptor_t *txBuffer)
+static void QCA_IRAM_ATTR qcaspi_tx_drop(qcaspi_t *qca, qca_tx_status_t status)
 {
-    uint16_t writtenBytes = 0;
+    NetworkBufferDescriptor_t *txBuffer = qca_ring_pop(&qca->txRing);
+
+    qca->stats.tx_dropped++;
+    if (status == QCA_TX_EXPIRED)
+        qca->stats.tx_expired++;
+    else if (status == QCA_TX_DROPPED)
+        qca->stats.tx_aqm_drop++;
+    qcaspi_tx_complete(qca, txBuffer, status);
+}
 
-    uint8_t *pucData = txBuffer->pucEthernetBuffer;
-    uint16_t len     = txBuffer->xDataLength;
-    uint16_t pad_len;
-    if (len < QCAFRM_ETHMINLEN)
+#if QCASPI_TX_CODEL_TARGET_US
+static uint32_t QCA_IRAM_ATTR qcaspi_isqrt(uint32_t n)
+{
+    uint32_t x = n, y = (n + 1) / 2;
+
+    while (y < x)
     {
-        ESP_LOGE(TAG, "QCAFRM_ETHMINLEN");
-        pad_len = QCAFRM_ETHMINLEN - len;
-        memset(pucData + len, 0, pad_len);
-        len += pad_len;
+        x = y;
+        y = (x + n / x) / 2;
     }
+    return x;
+}
 
-    qcaspi_write_register(qca, SPI_REG_BFR_SIZE, len + QCAFRM_FRAME_OVERHEAD);
-    /* send ethernet packet via DMA to SPI */
-    writtenBytes = qcaspi_write_burst(qca, pucData, len);
-    return writtenBytes;
+/* CoDel control law: drops spaced interval / sqrt(count) apart */
+static int64_t QCA_IRAM_ATTR qcaspi_codel_next(int64_t t, uint32_t count)
+{
+    return t + QCASPI_TX_CODEL_INTERVAL_US / qcaspi_isqrt(count);
+}
+
+static bool QCA_IRAM_ATTR qcaspi_codel_ok_to_drop(qcaspi_t *qca, const NetworkBufferDescriptor_t *txBuffer, int64_t now)
+{
+    qcaspi_codel_t *codel = &qca->codel;
+    int64_t since         = txBuffer->xEntryTime;
+
+    /* Time held through a resync is not a standing queue */
+    if (since < codel->resumed)
+        since = codel->resumed;
+
+    /* Short wait, or nothing queued behind this frame: no standing queue */
+    if (now - since < QCASPI_TX_CODEL_TARGET_US || qca_ring_count(&qca->txRing) <= 1)
+    {
+        codel->first_above = 0;
+        return false;
+    }
+
+    if (codel->first_above == 0)
+    {
+        codel->first_above = now + QCASPI_TX_CODEL_INTERVAL_US;
+        return false;
+    }
+
+    return now >= codel->first_above;
 }
+#endif
+
+/*====================================================================*
+ *
+ *   qcaspi_tx_head
+ *
+ *   Next TX frame to send. Frames past their deadline are dropped
+ *   first, then CoDel drops frames while the time spent in the TX ring
+ *   stays above QCASPI_TX_CODEL_TARGET_US.
+ *
+ *--------------------------------------------------------------------*/
 
-int qcaspi_transmit(qcaspi_t *qca)
+NetworkBufferDescriptor_t *qcaspi_tx_head(qcaspi_t *qca)
 {
     NetworkBufferDescriptor_t *txBuffer;
+    int64_t now = esp_timer_get_time();
+
+    while ((txBuffer = qca_ring_peek(&qca->txRing)) != NULL)
+    {
+        if (txBuffer->xDeadline != 0 && now >= txBuffer->xDeadline)
+        {
+            qcaspi_tx_drop(qca, QCA_TX_EXPIRED);
+            continue;
+        }
+
+#if QCASPI_TX_CODEL_TARGET_US
+        qcaspi_codel_t *codel = &qca->codel;
+        bool ok_to_drop       = qcaspi_codel_ok_to_drop(qca, txBuffer, now);
+
+        if (codel->dropping)
+        {
+            if (!ok_to_drop)
+            {
+                codel->dropping = false;
+            }
+            else if (now >= codel->drop_next)
+            {
+                qcaspi_tx_drop(qca, QCA_TX_DROPPED);
+                codel->count++;
+                codel->drop_next = qcaspi_codel_next(codel->drop_next, codel->count);
+                continue;
+            }
+        }
+        else if (ok_to_drop)
+        {
+            qcaspi_tx_drop(qca, QCA_TX_DROPPED);
+            codel->dropping = true;
+
+            /* Back into dropping soon after leaving it: resume the old rate */
+            uint32_t delta = codel->count - codel->last_count;
+            if (delta > 1 && now - codel->drop_next < 16 * QCASPI_TX_CODEL_INTERVAL_US)
+                codel->count = delta;
+            else
+                codel->count = 1;
+            codel->drop_next  = qcaspi_codel_next(now, codel->count);
+            codel->last_count = codel->count;
+            continue;
+        }
+#endif
+        return txBuffer;
+    }
+
+    /* Empty queue */
+    qca->codel.first_above = 0;
+    qca->codel.dropping    = false;
+    return NULL;
+}
+
+/*====================================================================*
+ *
+ *   qcaspi_transmit
+ *
+ *   Send queued frames while the QCA7k write buffer has room and the
+ *   TX deficit of this scheduler round covers the next frame.
+ *
+ *   Return: 0 TX ring drained, 1 stopped by the TX budget,
+ *           -1 stopped for lack of QCA7k buffer space.
+ *
+ *--------------------------------------------------------------------*/
 
-    /* read the available space in bytes from QCA7k */
-    uint16_t wrbuf_available = qcaspi_read_register(qca, SPI_REG_WRBUF_SPC_AVA);
+int QCA_IRAM_ATTR qcaspi_transmit(qcaspi_t *qca)
+{
+    NetworkBufferDescriptor_t *txBuffer;
+    uint16_t frames = 0;
 
-    if (xQueuePeek(qca->txQueue, &txBuffer, 0) == pdPASS)
+    /* send as many queued frames as the QCA7k buffer can take */
+    while ((txBuffer = qcaspi_tx_head(qca)) != NULL)
     {
         /* check whether there is enough space in the QCA7k buffer to hold
-         * the next packet */
-        if (wrbuf_available < (txBuffer->xDataLength + QCAFRM_FRAME_OVERHEAD))
+         * the next packet, asking the QCA7k only if the known free space
+         * does not cover it */
+        uint16_t needed = QCA_TX_BUF_SIZE(txBuffer->xDataLength);
+        if (qcaspi_wrbuf_space(qca, needed) < needed)
         {
             ESP_LOGE(TAG, "Not Enough Space");
+            if (frames == 0)
+                qca->stats.tx_starved++;
             return -1;
         }
 
+        /* leave the rest of the ring to the next round */
+        if ((int32_t)txBuffer->xDataLength > qca->sched.tx_deficit || frames >= QCASPI_SCHED_TX_FRAMES)
+        {
+            qca->stats.tx_deferred++;
+            return 1;
+        }
+
         /* receive and process the next packet */
-        if (xQueueReceive(qca->txQueue, &txBuffer, 0) == pdPASS)
+        if (qca_ring_pop(&qca->txRing) == txBuffer)
         {
             uint16_t writtenBytes = qcaspi_tx_frame(qca, txBuffer);
-            free(txBuffer->pucEthernetBuffer);
-            free(txBuffer);
-            wrbuf_available -= (writtenBytes + QCAFRM_FRAME_OVERHEAD);
+            qcaspi_wrbuf_consume(qca, writtenBytes + QCAFRM_FRAME_OVERHEAD);
+            qca->sched.tx_deficit -= writtenBytes;
+            frames++;
             qca->stats.tx_packets++;
             qca->stats.tx_bytes += writtenBytes;
+            qcaspi_tx_complete(qca, txBuffer, QCA_TX_SENT);
         }
     }
 
+    /* DRR: an idle queue keeps no credit */
+    qca->sched.tx_deficit = 0;
     return 0;
 }
 
-void qcaspi_process_rx_buffer(qcaspi_t *qca)
+void QCA_IRAM_ATTR qcaspi_process_rx_buffer(qcaspi_t *qca)
 {
     int32_t ret;
     qca->rx_buffer_pos = 0;
@@ -188,29 +346,177 @@ void qcaspi_process_rx_buffer(qcaspi_t *qca)
     }
 }
 
-int qcaspi_receive(qcaspi_t *qca)
+bool QCA_IRAM_ATTR qcaspi_rx_deliver(qcaspi_t *qca, NetworkBufferDescriptor_t *rxDesc)
 {
-    available = qcaspi_read_register(qca, SPI_REG_RDBUF_BYTE_AVA);
+    bool was_empty;
+    TaskHandle_t waiter;
+
+    if (!qca_ring_push(&qca->rxRing, rxDesc, &was_empty))
+        return false;
+
+    /* Only the empty -> non-empty transition can have a consumer asleep */
+    if (was_empty && (waiter = atomic_load(&qca->rx_waiter)) != NULL)
+        xTaskNotifyGive(waiter);
+
+    return true;
+}
+
+/*====================================================================*
+ *
+ *   qcaspi_rx_dispatch
+ *
+ *   Pass the frame decoded into qca->rx_desc to the RX hook, else the
+ *   RX ring. Up to QCASPI_RX_COPYBREAK bytes, and below the full size
+ *   buffer class, it goes in a copy and rx_desc stays; otherwise rx_desc
+ *   goes and is set to NULL, unless the ring is full and nothing else
+ *   holds its buffer.
+ *
+ *--------------------------------------------------------------------*/
+
+void QCA_IRAM_ATTR qcaspi_rx_dispatch(qcaspi_t *qca)
+{
+    NetworkBufferDescriptor_t *rxDesc = qca->rx_desc;
+    NetworkBufferDescriptor_t *copy;
+
+    /* A copy into a full size buffer saves nothing */
+    if (rxDesc->xDataLength <= QCASPI_RX_COPYBREAK && !qca_buf_full_class(rxDesc->xDataLength)
+        && (copy = qca_alloc_desc(rxDesc->xDataLength)) != NULL)
+    {
+        memcpy(copy->pucEthernetBuffer, rxDesc->pucEthernetBuffer, rxDesc->xDataLength);
+        copy->xEntryTime = rxDesc->xEntryTime;
+        copy->xDoneTime  = rxDesc->xDoneTime;
+        qca->stats.rx_copied++;
+        rxDesc = copy;
+    }
+
+    /* Consumed in the SPI thread, e.g. a matched MME response, or queued */
+    if ((qca->rx_hook != NULL && qca->rx_hook(rxDesc)) || qcaspi_rx_deliver(qca, rxDesc))
+    {
+        if (rxDesc == qca->rx_desc)
+            qca->rx_desc = NULL;
+        return;
+    }
+
+    /* Ring full, the full size descriptor is reused for the next frame,
+     * unless the hook shared its buffer, e.g. with a bridge port */
+    qca->stats.rx_dropped++;
+    if (rxDesc != qca->rx_desc)
+    {
+        qca_free_desc(rxDesc);
+    }
+    else if (qca_desc_shared(rxDesc))
+    {
+        qca_free_desc(rxDesc);
+        qca->rx_desc = NULL;
+    }
+}
+
+/*====================================================================*
+ *
+ *   qcaspi_rx_accept
+ *
+ *   Run the RX filter, then the policer, on the Ethernet header of a
+ *   frame.
+ *
+ *   Return: true if the frame passes both.
+ *
+ *--------------------------------------------------------------------*/
+
+bool QCA_IRAM_ATTR qcaspi_rx_accept(qcaspi_t *qca, const uint8_t *ethHdr)
+{
+    if (qca->rx_filter != NULL && !qca->rx_filter(ethHdr))
+        return false;
+
+    if (qca->rx_police != NULL && !qca->rx_police(ethHdr))
+    {
+        qca->stats.rx_policed++;
+        return false;
+    }
+
+    return true;
+}
+
+/* A full size descriptor for the next frame. Return: false when out of memory */
+static bool QCA_IRAM_ATTR qcaspi_rx_desc_alloc(qcaspi_t *qca)
+{
+    if (qca->rx_desc != NULL)
+        return true;
 
+    qca->rx_desc = qca_alloc_desc(QCAFRM_ETHMAXLEN);
     if (qca->rx_desc == NULL)
     {
-        qca->rx_desc                    = malloc(sizeof(NetworkBufferDescriptor_t));
-        qca->rx_desc->pucEthernetBuffer = malloc(QCAFRM_ETHMAXLEN);
-        qca->rx_desc->xDataLength       = 0;
+        qca->stats.rx_nomem++;
+        return false;
     }
 
+    qca->rx_desc->xDataLength = 0;
+    return true;
+}
+
+/*====================================================================*
+ *
+ *   qcaspi_receive
+ *
+ *   Read frames from the QCA7k until its read buffer is drained or the
+ *   RX deficit of this scheduler round is used up. The budget is only
+ *   checked between frames, so a round may overdraw by one frame and
+ *   the next round starts with less credit.
+ *
+ *   Return: 0 read buffer drained or no memory for a frame, 1 stopped
+ *   by the RX budget.
+ *
+ *--------------------------------------------------------------------*/
+
+int QCA_IRAM_ATTR qcaspi_receive(qcaspi_t *qca)
+{
+    uint16_t frames = 0;
+    uint16_t len;
+    bool budget_left = true;
+
+    /* Without memory the frames stay in the QCA7k until the next interrupt */
+    if (!qcaspi_rx_desc_alloc(qca))
+        return 0;
+
+    available = qcaspi_read_register(qca, SPI_REG_RDBUF_BYTE_AVA);
+
     // printf("Available:%d\n", available);
-    while (available >= QcaFrmBytesRequired(&qca->lFrmHdl))
+    while (budget_left && available >= QcaFrmBytesRequired(&qca->lFrmHdl))
     {
         switch (QcaFrmGetAction(&qca->lFrmHdl))
         {
         case QCAFRM_FIND_HEADER:
-            /* Read data of the size of one header. */
-            qca->rx_buffer_len = qcaspi_read_blocking(qca, qca->rx_buffer, QcaFrmBytesRequired(&qca->lFrmHdl));
+            qca->rx_checked = false;
+            qca->rx_discard = false;
+
+            /* Read data of the size of one header. With an RX filter the
+             * Ethernet header comes along, so it can be checked before the
+             * rest of the frame is read. */
+            len = QcaFrmBytesRequired(&qca->lFrmHdl);
+            if ((qca->rx_filter != NULL || qca->rx_police != NULL) && qca->lFrmHdl.state == qca->lFrmHdl.init
+                && available >= len + ETH_HLEN)
+                len += ETH_HLEN;
+            qca->rx_buffer_len = qcaspi_read_blocking(qca, qca->rx_buffer, len);
             qcaspi_process_rx_buffer(qca);
             break;
 
         case QCAFRM_COPY_FRAME:
+            if ((qca->rx_filter != NULL || qca->rx_police != NULL) && !qca->rx_checked)
+            {
+                /* Header read was short of the Ethernet header */
+                if (qca->lFrmHdl.offset < ETH_HLEN)
+                {
+                    len = qcaspi_read_burst(qca, qca->rx_desc->pucEthernetBuffer + qca->lFrmHdl.offset,
+                                            ETH_HLEN - qca->lFrmHdl.offset);
+                    qca->lFrmHdl.state -= len;
+                    qca->lFrmHdl.offset += len;
+                }
+
+                /* A rejected frame is still read, into the descriptor that
+                 * will take the next frame anyway */
+                qca->rx_checked = true;
+                qca->rx_discard = !qcaspi_rx_accept(qca, qca->rx_desc->pucEthernetBuffer);
+            }
+
             /* Start DMA read to copy the frame into the ethernet buffer. */
             qca->lFrmHdl.state -= qcaspi_read_burst(qca, qca->rx_desc->pucEthernetBuffer + qca->lFrmHdl.offset,
                                                     (qca->lFrmHdl.len - qca->lFrmHdl.offset));
@@ -223,46 +529,156 @@ int qcaspi_receive(qcaspi_t *qca)
             break;
 
         case QCAFRM_FRAME_COMPLETE:
-            qca->stats.rx_packets++;
-            qca->stats.rx_bytes += qca->rx_desc->xDataLength;
+            qca->sched.rx_deficit -= qca->rx_desc->xDataLength;
+            budget_left = (qca->sched.rx_deficit > 0) && (++frames < QCASPI_SCHED_RX_FRAMES);
 
-            if (xQueueSend(qca->rxQueue, &qca->rx_desc, 0) != pdPASS)
+            if (qca->rx_discard)
             {
-                ESP_LOGE("qca_spi", "Rx Frame[%d] Send to Queue Failed", qca->rx_desc->xDataLength);
-                qca->stats.rx_dropped++;
+                /* Rejected by the RX filter or policer, the descriptor takes the next frame */
+                qca->stats.rx_filtered++;
+                qca->lFrmHdl.state = qca->lFrmHdl.init;
+                break;
             }
 
-            qca->rx_desc = NULL;
+            qca->rx_desc->xEntryTime = qca->rx_irq_time;
+            qca->rx_desc->xDoneTime  = esp_timer_get_time();
+            qca->stats.rx_packets++;
+            qca->stats.rx_bytes += qca->rx_desc->xDataLength;
 
-            if (qca->rx_desc == NULL)
-            {
-                qca->rx_desc                    = malloc(sizeof(NetworkBufferDescriptor_t));
-                qca->rx_desc->pucEthernetBuffer = malloc(QCAFRM_ETHMAXLEN);
-                qca->rx_desc->xDataLength       = 0;
-            }
+            qcaspi_rx_dispatch(qca);
 
             /* Reset the frame handle, so a new header will be read */
-            qca->lFrmHdl.state = QCAFRM_WAIT_AA1;
+            qca->lFrmHdl.state = qca->lFrmHdl.init;
+
+            if (!qcaspi_rx_desc_alloc(qca))
+                return 0;
             break;
         }
     }
 
     if (available >= QcaFrmBytesRequired(&qca->lFrmHdl))
     {
-        ESP_LOGI(TAG, " Could not receive all frames. %d", available);
-        /* Could not receive all frames. */
-        return -1;
+        /* Could not receive all frames, the rest goes in the next round. */
+        qca->stats.rx_deferred++;
+        return 1;
     }
+
+    /* DRR: an idle queue keeps no credit */
+    qca->sched.rx_deficit = 0;
     return 0;
 }
 
+/*====================================================================*
+ *
+ *   qcaspi_rx_budget
+ *
+ *   Charge the RX busy period with the time since it started. Once it
+ *   exceeds QCASPI_SCHED_RX_BUDGET_US, RX is left until the next tick,
+ *   so a storm cannot keep the SPI thread busy beyond that per
+ *   interrupt; TX is still served meanwhile.
+ *
+ *--------------------------------------------------------------------*/
+
+static void QCA_IRAM_ATTR qcaspi_rx_budget(qcaspi_t *qca)
+{
+    qcaspi_sched_t *sched = &qca->sched;
+
+    if (!sched->rx_pending)
+    {
+        sched->rx_start = 0;
+    }
+    else if (QCASPI_SCHED_RX_BUDGET_US && esp_timer_get_time() - sched->rx_start >= QCASPI_SCHED_RX_BUDGET_US)
+    {
+        sched->rx_throttled = true;
+        sched->rx_resume    = xTaskGetTickCount() + 1;
+        sched->rx_start     = 0;
+        qca->stats.rx_throttle++;
+    }
+}
+
+/*====================================================================*
+ *
+ *   qcaspi_sched_round
+ *
+ *   One deficit round robin round: each direction with work gets its
+ *   quantum of byte credit and is served up to it, RX first, then TX.
+ *   A direction stopped by its budget stays pending and the SPI thread
+ *   comes back without sleeping, after picking up new interrupts, so
+ *   sustained traffic in one direction cannot starve the other.
+ *
+ *--------------------------------------------------------------------*/
+
+static void QCA_IRAM_ATTR qcaspi_sched_round(qcaspi_t *qca)
+{
+    qcaspi_sched_t *sched = &qca->sched;
+
+    if (sched->rx_throttled && (int32_t)(xTaskGetTickCount() - sched->rx_resume) >= 0)
+        sched->rx_throttled = false;
+
+    if (sched->rx_pending && !sched->rx_throttled)
+    {
+        if (sched->rx_start == 0)
+            sched->rx_start = esp_timer_get_time();
+        sched->rx_deficit += QCASPI_SCHED_RX_QUANTUM;
+        sched->rx_pending = (qcaspi_receive(qca) > 0);
+        qcaspi_rx_budget(qca);
+    }
+
+    sched->tx_pending = false;
+    if (!qca_ring_empty(&qca->txRing))
+    {
+        sched->tx_deficit += QCASPI_SCHED_TX_QUANTUM;
+        sched->tx_pending = (qcaspi_transmit(qca) > 0);
+
+        /* Blocked by the QCA7k rather than the budget: do not hoard credit */
+        if (sched->tx_deficit > QCASPI_SCHED_TX_QUANTUM + QCAFRM_ETHMAXLEN)
+            sched->tx_deficit = QCASPI_SCHED_TX_QUANTUM + QCAFRM_ETHMAXLEN;
+    }
+}
+
 void qcaspi_flush_txq(qcaspi_t *qca)
 {
     NetworkBufferDescriptor_t *txBuffer = NULL;
-    while (xQueueReceive(qca->txQueue, &txBuffer, 0)) { ESP_LOGI("qcaspi", "flush_txq"); }
+    while ((txBuffer = qca_ring_pop(&qca->txRing)) != NULL)
+    {
+        ESP_LOGI("qcaspi", "flush_txq");
+        qca->stats.tx_dropped++;
+        qcaspi_tx_complete(qca, txBuffer, QCA_TX_FLUSHED);
+    }
+
+    memset(&qca->codel, 0, sizeof(qca->codel));
+    qca->tx_replay = 0;
 }
 
-void qcaspi_qca7k_sync(qcaspi_t *qca, int event)
+#if QCASPI_TX_HOLD_MS
+/*====================================================================*
+ *
+ *   qcaspi_hold_txq
+ *
+ *   Keep the TX ring while the QCA7k is not ready, dropping frames
+ *   past their deadline or held longer than QCASPI_TX_HOLD_MS. Frames
+ *   enter in order, so only the head needs checking.
+ *
+ *--------------------------------------------------------------------*/
+
+static void qcaspi_hold_txq(qcaspi_t *qca)
+{
+    NetworkBufferDescriptor_t *txBuffer;
+    int64_t now = esp_timer_get_time();
+
+    while ((txBuffer = qca_ring_peek(&qca->txRing)) != NULL)
+    {
+        if (txBuffer->xDeadline != 0 && now >= txBuffer->xDeadline)
+            qcaspi_tx_drop(qca, QCA_TX_EXPIRED);
+        else if (now - txBuffer->xEntryTime >= (int64_t)QCASPI_TX_HOLD_MS * 1000)
+            qcaspi_tx_drop(qca, QCA_TX_FLUSHED);
+        else
+            break;
+    }
+}
+#endif
+
+static void qcaspi_qca7k_sync_fsm(qcaspi_t *qca, int event)
 {
     uint32_t signature;
     uint32_t spi_config;
@@ -278,6 +694,7 @@ void qcaspi_qca7k_sync(qcaspi_t *qca, int event)
         {
         case QCASPI_SYNC_CPUON:
             ESP_LOGI(TAG, "QCASPI_SYNC_RESET");
+            qcaspi_invalidate_registers(qca);
             /* Read signature twice, if not valid go back to unknown state. */
             signature = qcaspi_read_register(qca, SPI_REG_SIGNATURE);
             signature = qcaspi_read_register(qca, SPI_REG_SIGNATURE);
@@ -304,6 +721,7 @@ void qcaspi_qca7k_sync(qcaspi_t *qca, int event)
         case QCASPI_SYNC_UNKNOWN:
         case QCASPI_SYNC_RESET:
             ESP_LOGI(TAG, "QCASPI_SYNC_RESET");
+            qcaspi_invalidate_registers(qca);
             signature = qcaspi_read_register(qca, SPI_REG_SIGNATURE);
             if (signature == QCASPI_GOOD_SIGNATURE)
             {
@@ -328,6 +746,7 @@ void qcaspi_qca7k_sync(qcaspi_t *qca, int event)
         case QCASPI_SYNC_HARD_RESET:
 
             ESP_LOGI(TAG, "QCASPI_SYNC_HARD_RESET");
+            qcaspi_invalidate_registers(qca);
             /* reset is normally active low, so reset ... */
             // Chip_GPIO_SetPinOutLow(LPC_GPIO, GREENPHY_RESET_GPIO_PORT, GREENPHY_RESET_GPIO_PIN);
             // gpio_set_level(QCASPI_RST, 0);
@@ -367,107 +786,207 @@ void qcaspi_qca7k_sync(qcaspi_t *qca, int event)
     }
 }
 
-void qcaspi_spi_thread(void *data)
+void qcaspi_qca7k_sync(qcaspi_t *qca, int event)
 {
-    ESP_LOGI("qca_spi", "Thread Started.");
+    bool was_ready = (qca->sync == QCASPI_SYNC_READY);
 
-    qcaspi_t *qca = (qcaspi_t *)data;
+    qcaspi_qca7k_sync_fsm(qca, event);
+
+    bool ready = (qca->sync == QCASPI_SYNC_READY);
+    if (ready == was_ready)
+        return;
+
+#if QCASPI_TX_HOLD_MS
+    if (ready)
+    {
+        /* Send what was held before anything newer, without CoDel
+         * taking the time spent waiting for sync as queueing delay */
+        qca->tx_replay = qca_ring_count(&qca->txRing);
+        qca->stats.tx_held += qca->tx_replay;
+        memset(&qca->codel, 0, sizeof(qca->codel));
+        qca->codel.resumed = esp_timer_get_time();
+    }
+#endif
+
+    if (ready)
+    {
+        if (qca->boot.ready == 0)
+            qca->boot.ready = esp_timer_get_time();
+        xEventGroupSetBits(qca->events, QCASPI_EVT_READY);
+    }
+    else
+    {
+        xEventGroupClearBits(qca->events, QCASPI_EVT_READY);
+    }
+
+    if (qca->ready_cb != NULL)
+        qca->ready_cb(qca->ready_ctx, ready);
+}
+
+/*====================================================================*
+ *
+ *   qcaspi_wait_ticks
+ *
+ *   How long the SPI thread may sleep before the next qcaspi_service
+ *   call, unless notified earlier.
+ *
+ *--------------------------------------------------------------------*/
 
+TickType_t QCA_IRAM_ATTR qcaspi_wait_ticks(qcaspi_t *qca)
+{
+    if (qca->sync != QCASPI_SYNC_READY)
+        return pdMS_TO_TICKS(GREENPHY_SYNC_LOW_CHECK_TIME_MS);
+
+    if (qca->sched.tx_pending || (qca->sched.rx_pending && !qca->sched.rx_throttled))
+    {
+        /* The last round ran out of budget, go on after checking for
+         * new notifications. */
+        return 0;
+    }
+
+    if (qca->sched.rx_throttled)
+    {
+        /* RX used up its time, the QCA7k holds or drops the rest */
+        return 1;
+    }
+
+    if (!qca_ring_empty(&qca->txRing))
+    {
+        /* Frames were left for lack of QCA7k buffer space. Pushes into a
+         * non-empty ring do not notify, so poll until it drains. */
+        return QCASPI_TX_RETRY_TICKS;
+    }
+
+    return pdMS_TO_TICKS(GREENPHY_SYNC_HIGH_CHECK_TIME_MS);
+}
+
+/*====================================================================*
+ *
+ *   qcaspi_service
+ *
+ *   The work of one SPI thread wakeup. notification holds the QCAGP_*
+ *   bits that woke it, 0 after a timeout.
+ *
+ *--------------------------------------------------------------------*/
+
+void QCA_IRAM_ATTR qcaspi_service(qcaspi_t *qca, uint32_t notification)
+{
     uint16_t intr_cause;
-    uint32_t ulNotificationValue;
-    TickType_t xSyncRemTime = pdMS_TO_TICKS(GREENPHY_SYNC_LOW_CHECK_TIME_MS);
+    TickType_t xSyncRemTime = pdMS_TO_TICKS((qca->sync == QCASPI_SYNC_READY) ? GREENPHY_SYNC_HIGH_CHECK_TIME_MS
+                                                                             : GREENPHY_SYNC_LOW_CHECK_TIME_MS);
 
-    for (;;)
+    if (!notification && (xTaskGetTickCount() - qca->last_sync_check) >= xSyncRemTime)
     {
-        /* Take notification
-         * 0 timeout
-         * 1 interrupt (including receive)
-         * 2 receive (not used, handled by interrupt)
-         * 4 transmit
-         * */
-        if ((qca->sync == QCASPI_SYNC_READY))
-        {
-            xSyncRemTime = pdMS_TO_TICKS(GREENPHY_SYNC_HIGH_CHECK_TIME_MS);
-        }
-        else
+        /* We got a timeout, check if we need to restart sync. */
+        qca->last_sync_check = xTaskGetTickCount();
+        qcaspi_qca7k_sync(qca, QCASPI_SYNC_UPDATE);
+        /* Not synced. Awaiting reset, or sync unknown. */
+        if (qca->sync != QCASPI_SYNC_READY)
         {
-            xSyncRemTime = pdMS_TO_TICKS(GREENPHY_SYNC_LOW_CHECK_TIME_MS);
+            ESP_LOGI(TAG, "Sync Update Failed.");
+#if QCASPI_TX_HOLD_MS
+            qcaspi_hold_txq(qca);
+#else
+            qcaspi_flush_txq(qca);
+#endif
+            return;
         }
+    }
+
+    if (notification & QCAGP_INT_FLAG)
+    {
+        // gpio_intr_enable(QCASPI_INT);
 
-        ulNotificationValue = ulTaskNotifyTake(pdTRUE, xSyncRemTime);
+        /* We got an interrupt. */
+        portENTER_CRITICAL(&qca->irq_lock);
+        qca->rx_irq_time = qca->irq_time;
+        portEXIT_CRITICAL(&qca->irq_lock);
+        start_spi_intr_handling(qca, &intr_cause);
+        // ESP_LOGI(TAG, "We got IRQ. %04X", intr_cause);
 
-        if (!ulNotificationValue)
+        if (intr_cause & SPI_INT_CPU_ON)
         {
-            /* We got a timeout, check if we need to restart sync. */
-            qcaspi_qca7k_sync(qca, QCASPI_SYNC_UPDATE);
-            /* Not synced. Awaiting reset, or sync unknown. */
+            ESP_LOGI(TAG, "CPU On.");
+            if (qca->boot.cpu_on == 0)
+                qca->boot.cpu_on = qca->rx_irq_time;
+
+            qcaspi_qca7k_sync(qca, QCASPI_SYNC_CPUON);
+            qca->stats.device_reset++;
+
+            /* If not synced, wait reset. */
             if (qca->sync != QCASPI_SYNC_READY)
-            {
-                ESP_LOGI(TAG, "Sync Update Failed.");
-                qcaspi_flush_txq(qca);
-                continue;
-            }
+                return;
         }
 
-        if (ulNotificationValue & QCAGP_INT_FLAG)
+        if (intr_cause & (SPI_INT_RDBUF_ERR))
         {
-            // gpio_intr_enable(QCASPI_INT);
+            ESP_LOGI(TAG, "RDBUF_ERR.");
+            qca->stats.read_buf_err++;
+            qcaspi_qca7k_sync(qca, QCASPI_SYNC_RESET);
+            return;
+        }
 
-            /* We got an interrupt. */
-            start_spi_intr_handling(qca, &intr_cause);
-            // ESP_LOGI(TAG, "We got IRQ. %04X", intr_cause);
+        if (intr_cause & (SPI_INT_WRBUF_ERR))
+        {
+            ESP_LOGI(TAG, "WRBUF_ERR.");
+            qca->stats.write_buf_err++;
+            qcaspi_qca7k_sync(qca, QCASPI_SYNC_RESET);
+            return;
+        }
 
-            if (intr_cause & SPI_INT_CPU_ON)
+        if (qca->sync == QCASPI_SYNC_READY)
+        {
+            if (intr_cause & SPI_INT_PKT_AVLBL)
             {
-                ESP_LOGI(TAG, "CPU On.");
+                /* Read by the scheduler below */
+                qca->sched.rx_pending = true;
+            }
+        }
 
-                qcaspi_qca7k_sync(qca, QCASPI_SYNC_CPUON);
-                qca->stats.device_reset++;
+        end_spi_intr_handling(qca, intr_cause);
+    }
 
-                /* If not synced, wait reset. */
-                if (qca->sync != QCASPI_SYNC_READY)
-                    continue;
-            }
+    if (qca->sync == QCASPI_SYNC_READY)
+    {
+        qcaspi_sched_round(qca);
+    }
+    else
+    {
+        qca->sched.rx_pending   = false;
+        qca->sched.tx_pending   = false;
+        qca->sched.rx_throttled = false;
+        qca->sched.rx_start     = 0;
+#if QCASPI_TX_HOLD_MS
+        qcaspi_hold_txq(qca);
+#endif
+    }
+}
 
-            if (intr_cause & (SPI_INT_RDBUF_ERR))
-            {
-                ESP_LOGI(TAG, "RDBUF_ERR.");
-                qca->stats.read_buf_err++;
-                qcaspi_qca7k_sync(qca, QCASPI_SYNC_RESET);
-                continue;
-            }
+void QCA_IRAM_ATTR qcaspi_spi_thread(void *data)
+{
+    ESP_LOGI("qca_spi", "Thread Started.");
 
-            if (intr_cause & (SPI_INT_WRBUF_ERR))
-            {
-                ESP_LOGI(TAG, "WRBUF_ERR.");
-                qca->stats.write_buf_err++;
-                qcaspi_qca7k_sync(qca, QCASPI_SYNC_RESET);
-                continue;
-            }
+    qcaspi_t *qca = (qcaspi_t *)data;
 
-            if (qca->sync == QCASPI_SYNC_READY)
-            {
-                if (intr_cause & SPI_INT_PKT_AVLBL)
-                {
-                    if (qcaspi_receive(qca) == 0)
-                    {
-                        /* All packets received. */
-                    }
-                }
-            }
+    uint32_t ulNotificationValue;
+    int64_t xWakeTime = esp_timer_get_time();
 
-            end_spi_intr_handling(qca, intr_cause);
-        }
+    qca->last_sync_check = xTaskGetTickCount();
 
-        if (qca->sync == QCASPI_SYNC_READY)
-        {
-            if (uxQueueMessagesWaiting(qca->txQueue))
-            {
-                if (qcaspi_transmit(qca) != 0)
-                {
-                    //
-                }
-            }
-        }
+    for (;;)
+    {
+        /* Everything since the last wakeup was work */
+        qca->stats.busy_us += (uint32_t)(esp_timer_get_time() - xWakeTime);
+
+        /* Take notification
+         * 0 timeout
+         * 1 interrupt (including receive)
+         * 2 receive (not used, handled by interrupt)
+         * 4 transmit
+         * */
+        ulNotificationValue = ulTaskNotifyTake(pdTRUE, qcaspi_wait_ticks(qca));
+        xWakeTime           = esp_timer_get_time();
+
+        qcaspi_service(qca, ulNotificationValue);
     }
 }
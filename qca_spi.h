@@ -17,16 +17,20 @@
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_netif.h"
+#include "esp_timer.h"
 #include "sdkconfig.h"
 
 /* FreeRTOS includes. */
 #include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
 #include "freertos/queue.h"
 #include "freertos/semphr.h"
 #include "freertos/task.h"
 
 /* QCA7k includes */
+#include "qca_bus.h"
 #include "qca_framing.h"
+#include "qca_ring.h"
 
 #define GREENPHY_SYNC_HIGH_CHECK_TIME_MS 15000
 #define GREENPHY_SYNC_LOW_CHECK_TIME_MS  1000
@@ -50,12 +54,86 @@
 #define QCAGP_RX_FLAG  (1 << 1) /* RX is passed as interrupt, too */
 #define QCAGP_TX_FLAG  (1 << 2)
 
+/* qca.events bits */
+#define QCASPI_EVT_READY (1 << 0) /* Set while sync is QCASPI_SYNC_READY */
+
 /* Max amount of bytes read in one run */
 #define QCASPI_BURST_LEN (QCASPI_HW_BUF_LEN + 4)
 
 #define QCASPI_TX_BUFFER_LEN 500
 #define QCASPI_RX_BUFFER_LEN 1200
 
+/* Descriptor ring depths, must be powers of two */
+#ifndef QCASPI_TX_RING_DEPTH
+#define QCASPI_TX_RING_DEPTH 32
+#endif
+#ifndef QCASPI_RX_RING_DEPTH
+#define QCASPI_RX_RING_DEPTH 32
+#endif
+
+_Static_assert(QCA_RING_IS_POW2(QCASPI_TX_RING_DEPTH), "QCASPI_TX_RING_DEPTH must be a power of two");
+_Static_assert(QCA_RING_IS_POW2(QCASPI_RX_RING_DEPTH), "QCASPI_RX_RING_DEPTH must be a power of two");
+
+/* Poll interval while TX frames wait for QCA7k buffer space */
+#ifndef QCASPI_TX_RETRY_TICKS
+#define QCASPI_TX_RETRY_TICKS 1
+#endif
+
+/* Received frames up to this length are copied out of the full size RX
+ * buffer into one of their size class (qca_buf.h), which stays for the
+ * next frame; longer ones are handed over in it, as are those whose class
+ * is the full size one anyway. 0 hands over every frame. */
+#ifndef QCASPI_RX_COPYBREAK
+#define QCASPI_RX_COPYBREAK 1024
+#endif
+
+/* Scheduler quanta per round: byte credit and frame cap for each direction */
+#ifndef QCASPI_SCHED_RX_QUANTUM
+#define QCASPI_SCHED_RX_QUANTUM QCAFRM_ETHMAXLEN
+#endif
+#ifndef QCASPI_SCHED_TX_QUANTUM
+#define QCASPI_SCHED_TX_QUANTUM QCAFRM_ETHMAXLEN
+#endif
+#ifndef QCASPI_SCHED_RX_FRAMES
+#define QCASPI_SCHED_RX_FRAMES 8
+#endif
+#ifndef QCASPI_SCHED_TX_FRAMES
+#define QCASPI_SCHED_TX_FRAMES 8
+#endif
+
+/* SPI thread time RX may take for one interrupt. Once RX has kept the
+ * thread busy that long without draining the QCA7k, the rest waits for
+ * the next tick, and the QCA7k drops what does not fit in its buffer.
+ * 0 disables the limit. */
+#ifndef QCASPI_SCHED_RX_BUDGET_US
+#define QCASPI_SCHED_RX_BUDGET_US 0
+#endif
+
+/* TX active queue management (CoDel, RFC 8289). Once frames have waited
+ * longer than the target in the TX ring for a whole interval, head frames
+ * are dropped at a rate rising with the square root of the drop count
+ * until the wait falls below the target again. A target of 0 disables it. */
+#ifndef QCASPI_TX_CODEL_TARGET_US
+#define QCASPI_TX_CODEL_TARGET_US 10000
+#endif
+#ifndef QCASPI_TX_CODEL_INTERVAL_US
+#define QCASPI_TX_CODEL_INTERVAL_US 100000
+#endif
+
+/* Keep TX frames queued through a resync and send them once the QCA7k is
+ * ready again, dropping those older than this while it is not. Deadlines
+ * still apply. 0 flushes the TX ring when sync is lost. */
+#ifndef QCASPI_TX_HOLD_MS
+#define QCASPI_TX_HOLD_MS 0
+#endif
+
+/* Serialise pushes into the TX ring, which is single producer. The bridge,
+ * MME requests and sends from callbacks of the SPI thread or esp_timer
+ * task all add producers. Set to 0 only if one task ever sends. */
+#ifndef QCASPI_TX_MULTI_PRODUCER
+#define QCASPI_TX_MULTI_PRODUCER 1
+#endif
+
 /* RX and TX stats */
 typedef struct {
     uint32_t rx_errors;
@@ -69,34 +147,197 @@ typedef struct {
     uint32_t device_reset;
     uint32_t read_buf_err;
     uint32_t write_buf_err;
+    uint32_t rx_deferred; /* Rounds RX stopped on its budget with data left */
+    uint32_t tx_deferred; /* Rounds TX stopped on its budget with frames left */
+    uint32_t tx_starved;  /* Rounds TX had frames but no QCA7k buffer space */
+    uint32_t rx_filtered; /* Frames dropped by the RX filter or policer */
+    uint32_t busy_us;     /* SPI thread time awake, including SPI transfers; wraps */
+    uint32_t tx_expired;  /* Frames dropped past their deadline, also in tx_dropped */
+    uint32_t tx_aqm_drop; /* Frames dropped by CoDel, also in tx_dropped */
+    uint32_t rx_policed;  /* Frames over their class limit, also in rx_filtered */
+    uint32_t rx_throttle; /* Times RX used up QCASPI_SCHED_RX_BUDGET_US */
+    uint32_t rx_copied;   /* Frames copied into a smaller buffer, see QCASPI_RX_COPYBREAK */
+    uint32_t tx_held;     /* Frames kept in the TX ring through a resync, see QCASPI_TX_HOLD_MS */
+    uint32_t tx_replayed; /* Of those, frames sent after sync came back */
+    uint32_t rx_nomem;    /* Reads put off for lack of a receive buffer, the QCA7k keeps the frames */
 } qca_stats_t;
 
+/* Register stats, indexed by register address >> 8 up to SPI_REG_ACTION_CTRL */
+#define QCASPI_REGS 0x1C
+
+/* Skip SPI transactions that would not change or tell anything new: the
+ * SPI_REG_WRBUF_SPC_AVA read while the estimate covers the next frame,
+ * and a write of 0 to INTR_CAUSE. Set to 0 to send every access to the
+ * QCA7k. */
+#ifndef QCASPI_REG_SHADOW
+#define QCASPI_REG_SHADOW 1
+#endif
+
+/* SPI transactions per register, elided ones counted apart */
+typedef struct {
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t reads_elided;
+    uint32_t writes_elided;
+} qcaspi_reg_stats_t;
+
+typedef struct {
+    uint16_t wrbuf_space; /* SPI_REG_WRBUF_SPC_AVA at least: last read less the bursts since, 0 after resets */
+    qcaspi_reg_stats_t stats[QCASPI_REGS];
+} qcaspi_regs_t;
+
+/* Deficit round robin state of the SPI thread */
+typedef struct {
+    int32_t rx_deficit;
+    int32_t tx_deficit;
+    bool rx_pending;      /* QCA7k read buffer not drained */
+    bool tx_pending;      /* TX ring not drained for lack of budget */
+    bool rx_throttled;    /* RX budget used up, RX waits for rx_resume */
+    int64_t rx_start;     /* Start of the current RX busy period, 0 while drained */
+    TickType_t rx_resume;
+} qcaspi_sched_t;
+
+/* CoDel state of the TX ring, esp_timer us */
+typedef struct {
+    int64_t first_above; /* When the wait may be judged persistent, 0 while below target */
+    int64_t drop_next;   /* Next drop while dropping */
+    uint32_t count;      /* Drops since dropping started */
+    uint32_t last_count;
+    bool dropping;
+    int64_t resumed;     /* Sync came back, earlier waits count from here */
+} qcaspi_codel_t;
+
+/* Final state of a TX frame, reported through qca_tx_complete_cb_t */
+typedef enum
+{
+    QCA_TX_SENT = 0, /* Burst written to the QCA7k */
+    QCA_TX_DROPPED,  /* Discarded by the driver after it was accepted */
+    QCA_TX_FLUSHED,  /* Discarded on a resync, or held through one past QCASPI_TX_HOLD_MS */
+    QCA_TX_EXPIRED,  /* Discarded at its deadline before it was sent */
+} qca_tx_status_t;
+
+typedef void (*qca_tx_complete_cb_t)(void *ctx, qca_tx_status_t status);
+
+/* Shared frame buffer, see qca_buf.h */
+typedef struct qca_buf qca_buf_t;
+
 typedef struct {
     uint8_t *pucEthernetBuffer; /**< Pointer to the start of the Ethernet frame. */
     size_t xDataLength; /**< Starts by holding the total Ethernet frame length, then the UDP/TCP payload length. */
+    int64_t xEntryTime; /**< RX: qca_irq_handler entry, TX: qca_send call (esp_timer, us). */
+    int64_t xDoneTime;  /**< RX: frame decoded in qcaspi_receive, TX: burst written to the QCA7k (esp_timer, us). */
+    qca_tx_complete_cb_t pxTxComplete; /**< TX only: set for caller owned buffers, which the driver never frees. */
+    void *pvTxContext;                 /**< TX only: passed to pxTxComplete. */
+    int64_t xDeadline;                 /**< TX only: dropped instead of sent from this esp_timer us on, 0 for never. */
+    qca_buf_t *pxBuffer;               /**< Reference counted buffer holding the frame, NULL for a plain malloc one. */
+    bool xStatic;                      /**< TX only: caller owned, qca_send_desc reports it to pxTxComplete only. */
 } NetworkBufferDescriptor_t;
 
+/* Size of a caller owned qca_send_async buffer for a len byte frame: QCA7k header
+ * in front, short frames padded to QCAFRM_ETHMINLEN, QCA7k footer behind */
+#define QCA_TX_BUF_SIZE(len) \
+    ((((len) < QCAFRM_ETHMINLEN) ? QCAFRM_ETHMINLEN : (len)) + QCAFRM_FRAME_OVERHEAD)
+
+/* Called from the SPI thread once a TX frame is on the wire, right before it is freed */
+typedef void (*qca_tx_report_cb_t)(const NetworkBufferDescriptor_t *txDesc);
+
+/* Called from the SPI thread whenever sync reaches or leaves QCASPI_SYNC_READY */
+typedef void (*qca_ready_cb_t)(void *ctx, bool ready);
+
+/* Start up phases, esp_timer us, 0 until reached */
+typedef struct {
+    int64_t init;           /* qca_ll_init_async called */
+    int64_t reset_asserted; /* QCA7000 reset pin low */
+    int64_t reset_released; /* QCA7000 reset pin high */
+    int64_t cpu_on;         /* First SPI_INT_CPU_ON interrupt */
+    int64_t ready;          /* First QCASPI_SYNC_READY */
+} qca_boot_times_t;
+
+/* Called from the SPI thread for every received frame before it is queued.
+ * Returns true if it consumed (and freed) the descriptor. Modules chain
+ * their hook to the one installed before them and can only unhook while
+ * they are last, so stop them in reverse order of starting; one stopped
+ * out of order stays in the chain and passes frames on. */
+typedef bool (*qca_rx_hook_t)(NetworkBufferDescriptor_t *rxDesc);
+
+/* Called from the SPI thread with the first ETH_HLEN bytes of a frame, before
+ * the rest is read. Returns false to drop the frame. */
+typedef bool (*qca_rx_filter_cb_t)(const uint8_t *ethHdr);
+
+/* Tasks the driver starts: qca_spi and qca_network, or qca_uart_rx,
+ * qca_uart_tx and qca_network */
+#define QCA_TASKS 3
+
+typedef struct {
+    const char *name;
+    TaskHandle_t handle;
+    uint32_t stack_size; /* Bytes */
+} qca_task_t;
+
 typedef struct {
     spi_device_handle_t handle;
+    qca_bus_t bus; /* All SPI transactions go through here */
     TaskHandle_t task_handle;
+    qca_task_t tasks[QCA_TASKS];
     uint8_t sync;
 
     esp_netif_driver_base_t netif_base;
 
-    QueueHandle_t txQueue;
-    QueueHandle_t rxQueue;
+    /* Single producer/single consumer descriptor rings:
+     * txRing: qca_send -> SPI thread, rxRing: SPI thread -> qca_recv.
+     * With QCASPI_TX_MULTI_PRODUCER, tx_lock serialises the producers. */
+    qca_ring_t txRing;
+    qca_ring_t rxRing;
+    _Atomic(TaskHandle_t) rx_waiter; /* Consumer blocked in qca_recv_batch */
+#if QCASPI_TX_MULTI_PRODUCER
+    portMUX_TYPE tx_lock;
+#endif
 
     NetworkBufferDescriptor_t *rx_desc;
 
-    uint8_t rx_buffer[QCAFRM_TOTAL_HEADER_LEN];
+    int64_t irq_time;    /* Written by qca_irq_handler under irq_lock, two words on a 32 bit core */
+    int64_t rx_irq_time; /* irq_time latched when the interrupt is serviced */
+    portMUX_TYPE irq_lock;
+    qca_tx_report_cb_t tx_report_cb;
+    qca_rx_hook_t rx_hook;
+    qca_rx_filter_cb_t rx_filter;
+    qca_rx_filter_cb_t rx_police; /* Checked behind rx_filter */
+    bool rx_checked;              /* rx_filter and rx_police ran for the frame being read */
+    bool rx_discard;              /* and one of them rejected it */
+
+    EventGroupHandle_t events;
+    qca_ready_cb_t ready_cb;
+    void *ready_ctx;
+    esp_timer_handle_t reset_timer;
+    qca_boot_times_t boot;
+
+    uint8_t rx_buffer[QCAFRM_TOTAL_HEADER_LEN + ETH_HLEN];
     uint16_t rx_buffer_size;
     uint16_t rx_buffer_pos;
     uint16_t rx_buffer_len;
     QcaFrmHdl lFrmHdl;
 
+    qcaspi_sched_t sched;
+    qcaspi_codel_t codel;
+    uint32_t tx_replay; /* Held frames still ahead in the TX ring */
+    TickType_t last_sync_check;
+    qcaspi_regs_t regs;
+    uint16_t spi_xfer_peak; /* Longest SPI burst */
+
     qca_stats_t stats;
 } qcaspi_t;
 
 void qcaspi_spi_thread(void *data);
+TickType_t qcaspi_wait_ticks(qcaspi_t *qca);
+void qcaspi_service(qcaspi_t *qca, uint32_t notification);
+int qcaspi_receive(qcaspi_t *qca);
+int qcaspi_transmit(qcaspi_t *qca);
+void qcaspi_tx_complete(qcaspi_t *qca, NetworkBufferDescriptor_t *txBuffer, qca_tx_status_t status);
+
+/* Shared with the UART transport */
+NetworkBufferDescriptor_t *qcaspi_tx_head(qcaspi_t *qca);
+bool qcaspi_rx_deliver(qcaspi_t *qca, NetworkBufferDescriptor_t *rxDesc);
+bool qcaspi_rx_accept(qcaspi_t *qca, const uint8_t *ethHdr);
+void qcaspi_rx_dispatch(qcaspi_t *qca);
 
 #endif
@@ -0,0 +1,220 @@
+/*====================================================================*
+ *
+ *   qca_uart.c
+ *
+ *   QCA7000 UART host interface.
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca_uart.h"
+#include "qca_driver.h"
+
+static const char *TAG = "qca_uart";
+
+static QueueHandle_t uart_queue;
+
+static bool QCA_IRAM_ATTR qca_uart_rx_desc_alloc(qcaspi_t *qca)
+{
+    NetworkBufferDescriptor_t *rxDesc = qca_alloc_desc(QCAFRM_ETHMAXLEN);
+    if (rxDesc == NULL)
+        return false;
+
+    rxDesc->xDataLength = 0;
+    qca->rx_desc        = rxDesc;
+    return true;
+}
+
+/* A frame was decoded into qca->rx_desc */
+static void QCA_IRAM_ATTR qca_uart_rx_frame(qcaspi_t *qca, uint16_t len)
+{
+    NetworkBufferDescriptor_t *rxDesc = qca->rx_desc;
+
+    rxDesc->xDataLength = len;
+    if (!qcaspi_rx_accept(qca, rxDesc->pucEthernetBuffer))
+    {
+        qca->stats.rx_filtered++;
+        return;
+    }
+
+    rxDesc->xEntryTime = qca->rx_irq_time;
+    rxDesc->xDoneTime  = esp_timer_get_time();
+    qca->stats.rx_packets++;
+    qca->stats.rx_bytes += len;
+
+    qcaspi_rx_dispatch(qca);
+}
+
+/*====================================================================*
+ *
+ *   qca_uart_decode
+ *
+ *   Run one chunk of received bytes through the framing state machine,
+ *   which may complete any number of frames and leave a partial one
+ *   for the next chunk.
+ *
+ *--------------------------------------------------------------------*/
+
+static void QCA_IRAM_ATTR qca_uart_decode(qcaspi_t *qca, const uint8_t *data, uint16_t len)
+{
+    uint16_t used;
+    int32_t ret;
+
+    while (len > 0)
+    {
+        if (qca->rx_desc == NULL && !qca_uart_rx_desc_alloc(qca))
+        {
+            /* Nowhere to put the frame: lose it and hunt for the next header */
+            qca->stats.rx_dropped++;
+            qca->lFrmHdl.state = qca->lFrmHdl.init;
+            return;
+        }
+
+        ret = QcaFrmFsmDecodeBuf(&qca->lFrmHdl, data, len, &used, qca->rx_desc->pucEthernetBuffer);
+        data += used;
+        len -= used;
+
+        if (ret > 0)
+            qca_uart_rx_frame(qca, ret);
+        else if (ret != QCAFRM_GATHER)
+            qca->stats.rx_errors++;
+    }
+}
+
+static void qca_uart_rx_thread(void *data)
+{
+    qcaspi_t *qca = (qcaspi_t *)data;
+    uint8_t chunk[QCAUART_RX_CHUNK];
+    uart_event_t event;
+    size_t buffered;
+    int len;
+
+    for (;;)
+    {
+        if (xQueueReceive(uart_queue, &event, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        qca->rx_irq_time = esp_timer_get_time();
+
+        switch (event.type)
+        {
+        case UART_DATA:
+            /* Take everything buffered, not only what this event reports;
+             * the events queued behind it then find little or nothing */
+            uart_get_buffered_data_len(QCAUART_PORT, &buffered);
+            while (buffered > 0)
+            {
+                len = uart_read_bytes(QCAUART_PORT, chunk, buffered < sizeof(chunk) ? buffered : sizeof(chunk), 0);
+                if (len <= 0)
+                    break;
+                qca_uart_decode(qca, chunk, len);
+                buffered -= len;
+            }
+            break;
+
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            /* Bytes were lost, drop what is buffered and resync on the next header */
+            ESP_LOGW(TAG, "RX overflow");
+            qca->stats.read_buf_err++;
+            uart_flush_input(QCAUART_PORT);
+            xQueueReset(uart_queue);
+            qca->lFrmHdl.state = qca->lFrmHdl.init;
+            break;
+
+        case UART_FRAME_ERR:
+        case UART_PARITY_ERR:
+            qca->stats.rx_errors++;
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+static void qca_uart_tx_thread(void *data)
+{
+    qcaspi_t *qca = (qcaspi_t *)data;
+    NetworkBufferDescriptor_t *txBuffer;
+    uint8_t *buf;
+    uint16_t len;
+
+    for (;;)
+    {
+        /* qca_send only notifies when the ring was empty, so drain it all */
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while ((txBuffer = qcaspi_tx_head(qca)) != NULL)
+        {
+            qca_ring_pop(&qca->txRing);
+
+            buf = txBuffer->pucEthernetBuffer;
+            len = QcaFrmEncapsulate(buf, txBuffer->xDataLength);
+
+            /* Blocks while the UART TX ring buffer is full */
+            uart_write_bytes(QCAUART_PORT, buf, len + QCAFRM_FRAME_OVERHEAD);
+
+            qca->stats.tx_packets++;
+            qca->stats.tx_bytes += len;
+            qcaspi_tx_complete(qca, txBuffer, QCA_TX_SENT);
+        }
+    }
+}
+
+esp_err_t qca_uart_init(void)
+{
+    const uart_config_t uart_config = {
+        .baud_rate           = QCAUART_BAUD,
+        .data_bits           = UART_DATA_8_BITS,
+        .parity              = UART_PARITY_DISABLE,
+        .stop_bits           = UART_STOP_BITS_1,
+        .flow_ctrl           = (QCAUART_RTS != UART_PIN_NO_CHANGE) ? UART_HW_FLOWCTRL_CTS_RTS
+                                                                   : UART_HW_FLOWCTRL_DISABLE,
+        .rx_flow_ctrl_thresh = 122,
+        .source_clk          = UART_SCLK_DEFAULT,
+    };
+
+    qca.boot.init = esp_timer_get_time();
+
+    qca.sync   = QCASPI_SYNC_UNKNOWN;
+    qca.events = xEventGroupCreate();
+    if (qca.events == NULL)
+        return ESP_ERR_NO_MEM;
+    ESP_ERROR_CHECK(qca_ring_init(&qca.txRing, QCASPI_TX_RING_DEPTH) ? ESP_OK : ESP_ERR_NO_MEM);
+    ESP_ERROR_CHECK(qca_ring_init(&qca.rxRing, QCASPI_RX_RING_DEPTH) ? ESP_OK : ESP_ERR_NO_MEM);
+#if QCASPI_TX_MULTI_PRODUCER
+    portMUX_INITIALIZE(&qca.tx_lock);
+#endif
+    /* No hardware length in front of UART frames */
+    QcaFrmFsmInit(&qca.lFrmHdl);
+
+    ESP_ERROR_CHECK(uart_driver_install(QCAUART_PORT, QCAUART_RX_BUF_LEN, QCAUART_TX_BUF_LEN, QCAUART_EVENT_DEPTH,
+                                        &uart_queue, 0));
+    ESP_ERROR_CHECK(uart_param_config(QCAUART_PORT, &uart_config));
+    ESP_ERROR_CHECK(uart_set_pin(QCAUART_PORT, QCAUART_TXD, QCAUART_RXD, QCAUART_RTS, QCAUART_CTS));
+    ESP_ERROR_CHECK(uart_set_rx_full_threshold(QCAUART_PORT, QCAUART_RX_FULL_THRESH));
+
+#if QCAUART_RST >= 0
+    gpio_reset_pin(QCAUART_RST);
+    gpio_set_direction(QCAUART_RST, GPIO_MODE_OUTPUT);
+    gpio_set_level(QCAUART_RST, 0);
+    qca.boot.reset_asserted = esp_timer_get_time();
+    vTaskDelay(pdMS_TO_TICKS(QCASPI_RESET_HOLD_MS));
+    gpio_set_level(QCAUART_RST, 1);
+    qca.boot.reset_released = esp_timer_get_time();
+    vTaskDelay(pdMS_TO_TICKS(QCAUART_BOOT_MS));
+    /* Whatever the modem printed while booting is not a frame */
+    uart_flush_input(QCAUART_PORT);
+#endif
+
+    qca_task_create(qca_uart_rx_thread, "qca_uart_rx", QCAUART_RX_STACK_SIZE, tskIDLE_PRIORITY + 10, NULL);
+    qca_task_create(qca_uart_tx_thread, "qca_uart_tx", QCAUART_TX_STACK_SIZE, tskIDLE_PRIORITY + 10, &qca.task_handle);
+    qca_task_create(qca_network_thread, "qca_network", QCA_NETWORK_STACK_SIZE, tskIDLE_PRIORITY + 8, NULL);
+
+    qca.sync       = QCASPI_SYNC_READY;
+    qca.boot.ready = esp_timer_get_time();
+    xEventGroupSetBits(qca.events, QCASPI_EVT_READY);
+
+    ESP_LOGI(TAG, "QCA UART Init Success.");
+    return ESP_OK;
+}
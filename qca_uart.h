@@ -0,0 +1,99 @@
+/*====================================================================*
+ *
+ *   qca_uart.h
+ *
+ *   QCA7000 UART host interface.
+ *
+ *   Alternative to the SPI transport for boards running the QCA7000
+ *   UART firmware. Frames travel in the same QCA7k header and footer
+ *   (no hardware length, no registers), so RX is decoded with
+ *   QcaFrmFsmInit/QcaFrmFsmDecodeBuf over every chunk taken from the
+ *   UART driver's receive ring buffer, and TX frames are written from
+ *   qca.txRing. qca_send, qca_recv and the rest of qca_driver.h work
+ *   unchanged, as do TX deadlines, CoDel, the RX hook and the RX
+ *   filter (applied once the frame is complete).
+ *
+ *   Call qca_uart_init instead of qca_ll_init.
+ *
+ *--------------------------------------------------------------------*/
+
+#ifndef QCA_UART_HEADER
+#define QCA_UART_HEADER
+
+#include "driver/uart.h"
+#include "qca_spi.h"
+
+#ifndef QCAUART_PORT
+#define QCAUART_PORT UART_NUM_1
+#endif
+#ifndef QCAUART_TXD
+#define QCAUART_TXD GPIO_NUM_17
+#endif
+#ifndef QCAUART_RXD
+#define QCAUART_RXD GPIO_NUM_18
+#endif
+/* RTS/CTS, UART_PIN_NO_CHANGE for none */
+#ifndef QCAUART_RTS
+#define QCAUART_RTS UART_PIN_NO_CHANGE
+#endif
+#ifndef QCAUART_CTS
+#define QCAUART_CTS UART_PIN_NO_CHANGE
+#endif
+#ifndef QCAUART_BAUD
+#define QCAUART_BAUD 115200
+#endif
+
+/* QCA7000 reset pin, -1 if not wired */
+#ifndef QCAUART_RST
+#define QCAUART_RST -1
+#endif
+/* Time the modem firmware needs after reset before it takes frames */
+#ifndef QCAUART_BOOT_MS
+#define QCAUART_BOOT_MS 1000
+#endif
+
+/* UART driver ring buffers: RX holds a few full frames, 0 makes TX
+ * writes block until the bytes are in the FIFO */
+#ifndef QCAUART_RX_BUF_LEN
+#define QCAUART_RX_BUF_LEN (4 * (QCAFRM_ETHMAXLEN + QCAFRM_FRAME_OVERHEAD))
+#endif
+#ifndef QCAUART_TX_BUF_LEN
+#define QCAUART_TX_BUF_LEN (2 * (QCAFRM_ETHMAXLEN + QCAFRM_FRAME_OVERHEAD))
+#endif
+#ifndef QCAUART_EVENT_DEPTH
+#define QCAUART_EVENT_DEPTH 16
+#endif
+
+/* Bytes taken from the RX ring buffer and decoded at a time */
+#ifndef QCAUART_RX_CHUNK
+#define QCAUART_RX_CHUNK 512
+#endif
+
+/* RX FIFO level that wakes the driver; higher means fewer interrupts at
+ * high baud rates, the RX timeout picks up the tail of a frame */
+#ifndef QCAUART_RX_FULL_THRESH
+#define QCAUART_RX_FULL_THRESH 96
+#endif
+
+/* Task stacks in bytes, the RX task holds the QCAUART_RX_CHUNK buffer */
+#ifndef QCAUART_RX_STACK_SIZE
+#define QCAUART_RX_STACK_SIZE 4096
+#endif
+#ifndef QCAUART_TX_STACK_SIZE
+#define QCAUART_TX_STACK_SIZE 2048
+#endif
+
+/*====================================================================*
+ *
+ *   qca_uart_init
+ *
+ *   Set up the UART, reset the QCA7000 if QCAUART_RST is wired and
+ *   start the RX, TX and network threads. Returns once the modem had
+ *   QCAUART_BOOT_MS to come up; the UART firmware has no CPU_ON
+ *   interrupt to wait for.
+ *
+ *--------------------------------------------------------------------*/
+
+esp_err_t qca_uart_init(void);
+
+#endif
@@ -0,0 +1,333 @@
+/*====================================================================*
+ *
+ *   qca_atten_host.c
+ *
+ *   Run the SLAC attenuation aggregator on a Linux host against the
+ *   QCA7000 model.
+ *
+ *   Round after round, up to QCA_ATTEN_SESSIONS PEVs sound at once:
+ *   each sends a CM_START_ATTEN_CHAR.IND, then its CM_MNBC_SOUND.INDs,
+ *   and every sound is followed by the CM_ATTEN_PROFILE.IND the local
+ *   QCA7000 would report for it, all pushed through the model's read
+ *   buffer. The finished CM_ATTEN_CHAR.INDs are checked against
+ *   averages worked out here, and timed from the last profile written
+ *   to the model. With -c the aggregator is left out and the network
+ *   thread averages the profiles from qca_recv byte by byte instead,
+ *   as application code would.
+ *
+ *   Build from the repository root:
+ *
+ *   cc -O2 -I. -Ihost -Ihost/include -o qca_atten_host tools/qca_atten_host.c qca_atten.c qca_mme.c \
+ *       qca_driver.c qca_spi.c qca_buf.c qca_7k.c qca_framing.c qca_bus_esp.c host/host_port.c \
+ *       host/qca7k_sim.c -lpthread
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca7k_sim.h"
+#include "qca_atten.h"
+#include "qca_driver.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define HOST_MAX_ROUNDS 100000
+
+static const uint8_t mac_evse[QCA_MME_ETH_ALEN]  = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
+static const uint8_t mac_modem[QCA_MME_ETH_ALEN] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x03};
+
+static uint32_t rounds = 1000;
+static uint8_t pevs    = QCA_ATTEN_SESSIONS;
+static uint8_t sounds  = 10;
+static bool in_app;
+
+/* Written by main, read by whoever finishes the PEV's result */
+static volatile uint32_t round_no;
+static volatile int64_t last_profile[QCA_ATTEN_SESSIONS];
+static volatile uint32_t results;
+static uint32_t timed;
+static volatile uint32_t mismatches;
+static volatile uint32_t passed_on;
+static uint32_t latency[HOST_MAX_ROUNDS * QCA_ATTEN_SESSIONS];
+
+static portMUX_TYPE host_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Per PEV sums for -c, network thread only */
+static struct {
+    uint8_t run_id[QCA_MME_RUN_ID_LEN];
+    uint8_t received;
+    uint32_t sum[QCA_MME_AAG_GROUPS];
+} app[QCA_ATTEN_SESSIONS];
+
+static void pev_mac(uint8_t *mac, int pev)
+{
+    static const uint8_t base[QCA_MME_ETH_ALEN] = {0x02, 0x00, 0x00, 0x00, 0x01, 0x00};
+
+    memcpy(mac, base, QCA_MME_ETH_ALEN);
+    mac[5] = (uint8_t)pev;
+}
+
+static void run_id(uint8_t *id, uint32_t round, int pev)
+{
+    uint32_t n = round * QCA_ATTEN_SESSIONS + pev;
+
+    memset(id, 0, QCA_MME_RUN_ID_LEN);
+    memcpy(id, &n, sizeof(n));
+}
+
+/* The attenuation of group g in the profile of sound s, 10 to 99 dB */
+static uint8_t attenuation(uint32_t round, int pev, int s, int g)
+{
+    uint32_t x = (round * 131 + pev * 31 + s) * 2654435761u ^ (uint32_t)g * 40503u;
+
+    return (uint8_t)(10 + (x >> 7) % 90);
+}
+
+static void mme_hdr(qca_mme_hdr_t *hdr, const uint8_t *dest, const uint8_t *src, uint16_t mmtype)
+{
+    memcpy(hdr->dest, dest, QCA_MME_ETH_ALEN);
+    memcpy(hdr->src, src, QCA_MME_ETH_ALEN);
+    hdr->ethertype = __builtin_bswap16(QCA_MME_ETHERTYPE);
+    hdr->mmv       = QCA_MME_MMV_AV_1_1;
+    hdr->mmtype    = mmtype;
+}
+
+/* Through the model's read buffer, waiting while it is full */
+static void inject(const void *frame, uint16_t len)
+{
+    uint8_t pad[QCAFRM_ETHMINLEN] = {0};
+
+    if (len < QCAFRM_ETHMINLEN)
+    {
+        memcpy(pad, frame, len);
+        frame = pad;
+        len   = QCAFRM_ETHMINLEN;
+    }
+    while (!qca7k_sim_rx_frame(frame, len)) usleep(20);
+}
+
+static void check(const qca_mme_atten_char_ind_t *ind)
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t sum, id;
+    bool ok;
+    int pev = ind->source_address[5];
+    int s, g;
+
+    memcpy(&id, ind->run_id, sizeof(id));
+    ok = pev < pevs && id == round_no * QCA_ATTEN_SESSIONS + pev && ind->num_sounds == sounds
+         && ind->num_groups == QCA_MME_AAG_GROUPS;
+    for (g = 0; ok && g < QCA_MME_AAG_GROUPS; g++)
+    {
+        for (sum = 0, s = 0; s < sounds; s++) sum += attenuation(round_no, pev, s, g);
+        ok = ind->aag[g] == (sum + sounds / 2) / sounds;
+    }
+
+    portENTER_CRITICAL(&host_lock);
+    if (!ok)
+        mismatches++;
+    else
+        latency[timed++] = (uint32_t)(now - last_profile[pev]);
+    results++;
+    portEXIT_CRITICAL(&host_lock);
+}
+
+static void atten_done(void *ctx, const qca_mme_atten_char_ind_t *ind)
+{
+    (void)ctx;
+    check(ind);
+}
+
+/* -c: what the driver does, done on the frames from qca_recv */
+static void app_profile(const qca_mme_atten_profile_ind_t *profile)
+{
+    qca_mme_atten_char_ind_t ind;
+    int pev = profile->pev_mac[5];
+    int g;
+
+    if (pev >= pevs)
+        return;
+    for (g = 0; g < QCA_MME_AAG_GROUPS && g < profile->num_groups; g++) app[pev].sum[g] += profile->aag[g];
+    if (++app[pev].received < sounds)
+        return;
+
+    memset(&ind, 0, sizeof(ind));
+    memcpy(ind.source_address, profile->pev_mac, QCA_MME_ETH_ALEN);
+    memcpy(ind.run_id, app[pev].run_id, QCA_MME_RUN_ID_LEN);
+    ind.num_sounds = app[pev].received;
+    ind.num_groups = QCA_MME_AAG_GROUPS;
+    for (g = 0; g < QCA_MME_AAG_GROUPS; g++)
+        ind.aag[g] = (uint8_t)((app[pev].sum[g] + ind.num_sounds / 2) / ind.num_sounds);
+    check(&ind);
+}
+
+static void app_rx(NetworkBufferDescriptor_t *desc)
+{
+    const qca_mme_start_atten_char_ind_t *start;
+    const qca_mme_atten_profile_ind_t *profile;
+
+    if ((start = QCA_MME_CAST(desc, QCA_MMTYPE_CM_START_ATTEN_CHAR | QCA_MMTYPE_IND, qca_mme_start_atten_char_ind_t))
+        != NULL)
+    {
+        if (start->av.hdr.src[5] < pevs)
+        {
+            memset(&app[start->av.hdr.src[5]], 0, sizeof(app[0]));
+            memcpy(app[start->av.hdr.src[5]].run_id, start->run_id, QCA_MME_RUN_ID_LEN);
+        }
+    }
+    else if ((profile = QCA_MME_CAST(desc, QCA_MMTYPE_CM_ATTEN_PROFILE | QCA_MMTYPE_IND, qca_mme_atten_profile_ind_t))
+             != NULL)
+    {
+        app_profile(profile);
+    }
+}
+
+void qca_network_thread(void *data)
+{
+    NetworkBufferDescriptor_t *desc;
+
+    (void)data;
+    for (;;)
+    {
+        desc = qca_recv(portMAX_DELAY);
+        if (desc == NULL)
+            continue;
+        if (in_app)
+            app_rx(desc);
+        passed_on++;
+        qca_free_desc(desc);
+    }
+}
+
+static void send_round(uint32_t round)
+{
+    qca_mme_start_atten_char_ind_t start;
+    qca_mme_mnbc_sound_ind_t sound;
+    qca_mme_atten_profile_ind_t profile;
+    uint8_t mac[QCA_MME_ETH_ALEN];
+    int pev, s, g;
+
+    for (pev = 0; pev < pevs; pev++)
+    {
+        pev_mac(mac, pev);
+        memset(&start, 0, sizeof(start));
+        mme_hdr(&start.av.hdr, mac_evse, mac, QCA_MMTYPE_CM_START_ATTEN_CHAR | QCA_MMTYPE_IND);
+        start.num_sounds = sounds;
+        start.time_out   = 6;
+        run_id(start.run_id, round, pev);
+        inject(&start, sizeof(start));
+    }
+
+    for (s = 0; s < sounds; s++)
+    {
+        for (pev = 0; pev < pevs; pev++)
+        {
+            pev_mac(mac, pev);
+            memset(&sound, 0, sizeof(sound));
+            mme_hdr(&sound.av.hdr, mac_evse, mac, QCA_MMTYPE_CM_MNBC_SOUND | QCA_MMTYPE_IND);
+            sound.cnt = (uint8_t)(sounds - 1 - s);
+            run_id(sound.run_id, round, pev);
+            inject(&sound, sizeof(sound));
+
+            memset(&profile, 0, sizeof(profile));
+            mme_hdr(&profile.av.hdr, mac_evse, mac_modem, QCA_MMTYPE_CM_ATTEN_PROFILE | QCA_MMTYPE_IND);
+            memcpy(profile.pev_mac, mac, QCA_MME_ETH_ALEN);
+            profile.num_groups = QCA_MME_AAG_GROUPS;
+            for (g = 0; g < QCA_MME_AAG_GROUPS; g++) profile.aag[g] = attenuation(round, pev, s, g);
+            if (s == sounds - 1)
+                last_profile[pev] = esp_timer_get_time();
+            inject(&profile, sizeof(profile));
+        }
+    }
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-n rounds] [-p pevs] [-k sounds] [-c]\n"
+            "  -n  sounding rounds, default 1000\n"
+            "  -p  PEVs sounding at once, default %d\n"
+            "  -k  sounds per PEV, default 10\n"
+            "  -c  average in the application from qca_recv, without qca_atten\n",
+            prog, QCA_ATTEN_SESSIONS);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    qca_atten_stats_t st;
+    uint32_t round, expect, incomplete = 0, n;
+    int64_t start, elapsed, wait;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:p:k:c")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            rounds = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'p':
+            pevs = (uint8_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'k':
+            sounds = (uint8_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            in_app = true;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (rounds == 0 || rounds > HOST_MAX_ROUNDS || pevs == 0 || pevs > QCA_ATTEN_SESSIONS || sounds == 0)
+        usage(argv[0]);
+
+    qca7k_sim_init(QCASPI_INT, QCASPI_RST);
+    qca_ll_init();
+    if (!in_app)
+        qca_atten_init(mac_evse, atten_done, NULL);
+
+    start = esp_timer_get_time();
+    for (round = 0; round < rounds; round++)
+    {
+        round_no = round;
+        expect   = results + pevs;
+        send_round(round);
+
+        /* The next round's START would restart sessions still open; a
+         * round short of results lost frames on a full RX ring */
+        wait = esp_timer_get_time() + 100000;
+        while (results < expect && esp_timer_get_time() < wait) usleep(10);
+        if (results < expect)
+            incomplete++;
+    }
+    elapsed = esp_timer_get_time() - start;
+
+    n = timed;
+    qsort(latency, n, sizeof(latency[0]), cmp_u32);
+    printf("mode        %s, %u PEVs x %u sounds\n", in_app ? "application (-c)" : "qca_atten", pevs, sounds);
+    printf("results     %u, mismatches %u, %u rounds incomplete (rx_dropped %u), %u frames to qca_recv, "
+           "%.0f profiles/s\n",
+           results, mismatches, incomplete, qca_get_stats()->rx_dropped, passed_on,
+           (double)rounds * pevs * sounds * 1e6 / elapsed);
+    if (n == 0)
+        return 1;
+    printf("latency     p50 %u us, p99 %u us, max %u us (last profile to CM_ATTEN_CHAR.IND)\n", latency[n / 2],
+           latency[n * 99 / 100], latency[n - 1]);
+    if (!in_app)
+    {
+        qca_atten_get_stats(&st);
+        printf("qca_atten   sessions %u, profiles %u, complete %u, timeouts %u, unmatched %u, table_full %u\n",
+               st.sessions, st.profiles, st.complete, st.timeouts, st.unmatched, st.table_full);
+    }
+    return mismatches == 0 && (in_app || incomplete == 0) ? 0 : 1;
+}
@@ -0,0 +1,267 @@
+/*====================================================================*
+ *
+ *   qca_bridge_host.c
+ *
+ *   Run the L2 bridge on a Linux host between the QCA7000 model and a
+ *   stand-in second interface.
+ *
+ *   Station B sits behind the stand-in port and sends numbered frames
+ *   to station A, a remote PLC station behind the model, which sends
+ *   every frame back to B. Both directions cross the bridge; the port
+ *   checks the sequence of what comes back and keeps at most -w frames
+ *   on their way. -c runs the same traffic through the application
+ *   instead, qca_recv and a copy into the port on one side, qca_send
+ *   on the other, as without the bridge.
+ *
+ *   Build from the repository root:
+ *
+ *   cc -O2 -I. -Ihost -Ihost/include -o qca_bridge_host tools/qca_bridge_host.c \
+ *       qca_bridge.c qca_driver.c qca_spi.c qca_buf.c qca_7k.c qca_framing.c qca_bus_esp.c \
+ *       host/host_port.c host/qca7k_sim.c -lpthread
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca7k_sim.h"
+#include "qca_bridge.h"
+#include "qca_driver.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define STATION_QUEUE 64
+
+static const uint8_t mac_a[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x0A};
+static const uint8_t mac_b[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x0B};
+
+static bool copy_mode;
+static uint16_t frame_len    = 1514;
+static uint32_t window       = 16;
+static volatile bool running = true;
+
+/* Stand-in port: what came back to B */
+static struct {
+    atomic_uint sent;
+    atomic_uint received;
+    atomic_ullong bytes;
+    uint32_t next;
+    atomic_uint gaps;
+} port;
+
+/* Remote PLC station A, answering outside the model's lock */
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint8_t frame[STATION_QUEUE][QCAFRM_ETHMAXLEN];
+    uint16_t len[STATION_QUEUE];
+    unsigned head;
+    unsigned count;
+    uint32_t dropped;
+} station = {.lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER};
+
+static void station_tx(void *ctx, const uint8_t *frame, size_t len)
+{
+    unsigned slot;
+
+    (void)ctx;
+    if (len < ETH_HLEN || memcmp(frame, mac_a, 6) != 0)
+        return;
+
+    pthread_mutex_lock(&station.lock);
+    if (station.count == STATION_QUEUE)
+    {
+        station.dropped++;
+    }
+    else
+    {
+        slot = (station.head + station.count) % STATION_QUEUE;
+        memcpy(station.frame[slot], frame, len);
+        station.len[slot] = (uint16_t)len;
+        station.count++;
+        pthread_cond_signal(&station.cond);
+    }
+    pthread_mutex_unlock(&station.lock);
+}
+
+static void *station_thread(void *arg)
+{
+    uint8_t frame[QCAFRM_ETHMAXLEN];
+    uint16_t len;
+
+    (void)arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&station.lock);
+        while (station.count == 0) pthread_cond_wait(&station.cond, &station.lock);
+        len = station.len[station.head];
+        memcpy(frame, station.frame[station.head], len);
+        station.head = (station.head + 1) % STATION_QUEUE;
+        station.count--;
+        pthread_mutex_unlock(&station.lock);
+
+        memcpy(frame, mac_b, 6);
+        memcpy(frame + 6, mac_a, 6);
+        while (!qca7k_sim_rx_frame(frame, len)) usleep(20);
+    }
+    return NULL;
+}
+
+static void port_deliver(const uint8_t *frame, size_t len)
+{
+    uint32_t seq;
+
+    memcpy(&seq, frame + ETH_HLEN, sizeof(seq));
+    if (seq != port.next)
+        atomic_fetch_add(&port.gaps, 1);
+    port.next = seq + 1;
+    atomic_fetch_add(&port.received, 1);
+    atomic_fetch_add(&port.bytes, len);
+}
+
+/* The bridge hands the RX descriptor over, the port "transmits" and frees it */
+static esp_err_t port_tx(void *ctx, NetworkBufferDescriptor_t *desc)
+{
+    (void)ctx;
+    port_deliver(desc->pucEthernetBuffer, desc->xDataLength);
+    qca_free_desc(desc);
+    return ESP_OK;
+}
+
+/* Station B behind the port */
+static void *port_thread(void *arg)
+{
+    uint8_t frame[QCAFRM_ETHMAXLEN] = {0};
+    NetworkBufferDescriptor_t *desc;
+    uint32_t seq;
+
+    (void)arg;
+    memcpy(frame, mac_a, 6);
+    memcpy(frame + 6, mac_b, 6);
+    frame[12] = 0x88;
+    frame[13] = 0xB5;
+
+    for (seq = 0; running; seq++)
+    {
+        /* At most window frames on their way */
+        while (running && seq - atomic_load(&port.received) >= window) usleep(10);
+
+        memcpy(frame + ETH_HLEN, &seq, sizeof(seq));
+        if (copy_mode)
+        {
+            qca_send(frame, frame_len);
+        }
+        else
+        {
+            /* The port driver receives into a descriptor with headroom */
+            desc = qca_alloc_desc(frame_len);
+            memcpy(desc->pucEthernetBuffer, frame, frame_len);
+            if (!qca_bridge_input(desc))
+                qca_free_desc(desc);
+        }
+        atomic_fetch_add(&port.sent, 1);
+    }
+    return NULL;
+}
+
+void qca_network_thread(void *data)
+{
+    NetworkBufferDescriptor_t *desc;
+    uint8_t *copy;
+
+    (void)data;
+    for (;;)
+    {
+        desc = qca_recv(portMAX_DELAY);
+        if (desc == NULL)
+            continue;
+
+        if (copy_mode)
+        {
+            /* Into the port's own buffer, as its driver would */
+            copy = malloc(desc->xDataLength);
+            memcpy(copy, desc->pucEthernetBuffer, desc->xDataLength);
+            port_deliver(copy, desc->xDataLength);
+            free(copy);
+        }
+        qca_free_desc(desc);
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-s size] [-w window] [-t seconds] [-c]\n"
+            "  -s  frame length, default 1514\n"
+            "  -w  frames on their way, default 16\n"
+            "  -t  run time, default 5\n"
+            "  -c  forward through qca_recv/qca_send with copies instead of the bridge\n",
+            prog);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    qca_bridge_config_t cfg = {.port_tx = port_tx, .local_mme = true};
+    qca_bridge_stats_t s;
+    pthread_t thread;
+    unsigned seconds = 5;
+    uint32_t received;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:w:t:c")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            frame_len = (uint16_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'w':
+            window = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            seconds = (unsigned)strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            copy_mode = true;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (frame_len < QCAFRM_ETHMINLEN || frame_len > QCAFRM_ETHMAXLEN || window == 0)
+        usage(argv[0]);
+
+    qca7k_sim_init(QCASPI_INT, QCASPI_RST);
+    qca7k_sim_set_tx_cb(station_tx, NULL);
+    qca_ll_init();
+    if (!copy_mode)
+        qca_bridge_start(&cfg);
+
+    pthread_create(&thread, NULL, station_thread, NULL);
+    pthread_detach(thread);
+    pthread_create(&thread, NULL, port_thread, NULL);
+
+    sleep(seconds);
+    running = false;
+    pthread_join(thread, NULL);
+    usleep(100000);
+
+    received = atomic_load(&port.received);
+    printf("mode        %s, %u byte frames\n", copy_mode ? "copy" : "bridge", frame_len);
+    printf("round trips %u sent, %u back, %u gaps, %u frames/s, %.2f MB/s each way\n", atomic_load(&port.sent),
+           received, atomic_load(&port.gaps), received / seconds,
+           (double)atomic_load(&port.bytes) / seconds / 1e6);
+    printf("station     dropped %u\n", station.dropped);
+    if (!copy_mode)
+    {
+        qca_bridge_get_stats(&s);
+        printf("bridge      fwd %u/%u, filtered %u/%u, local %u/%u, dropped %u/%u (PLC/port), learned %u, moved %u\n",
+               s.forwarded[QCA_BRIDGE_PLC], s.forwarded[QCA_BRIDGE_PORT], s.filtered[QCA_BRIDGE_PLC],
+               s.filtered[QCA_BRIDGE_PORT], s.local[QCA_BRIDGE_PLC], s.local[QCA_BRIDGE_PORT],
+               s.dropped[QCA_BRIDGE_PLC], s.dropped[QCA_BRIDGE_PORT], s.learned, s.moved);
+    }
+    return atomic_load(&port.gaps) == 0 ? 0 : 1;
+}
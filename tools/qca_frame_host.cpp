@@ -0,0 +1,192 @@
+/*====================================================================*
+ *
+ *   qca_frame_host.cpp
+ *
+ *   Run the C++ frame layer on a Linux host against the QCA7000 model
+ *   in loopback.
+ *
+ *   Numbered frames are built in place in qca::Frame buffers and moved
+ *   into qca::Link::send; every eighth one is a CM_SLAC_PARM.REQ MME
+ *   carrying the number in its run id. The network thread receives
+ *   them in batches, reads the headers through qca::eth and qca::mme,
+ *   checks order and content, and shares each frame once with a tap,
+ *   as a capture would. Outside the driver's RX copy-break no frame is
+ *   copied on the way.
+ *
+ *   Build from the repository root:
+ *
+ *   cc -O2 -c -I. -Ihost -Ihost/include qca_driver.c qca_spi.c qca_buf.c qca_7k.c \
+ *       qca_framing.c qca_bus_esp.c host/host_port.c host/qca7k_sim.c
+ *   c++ -std=gnu++2b -O2 -I. -Ihost -Ihost/include -o qca_frame_host \
+ *       tools/qca_frame_host.cpp *.o -lpthread
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca_frame.hpp"
+
+extern "C" {
+#include "qca7k_sim.h"
+}
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#define FRAME_ETHERTYPE 0x88B5
+
+static const uint8_t mac_local[qca::eth::alen] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+
+static std::atomic<uint32_t> received;
+static std::atomic<uint32_t> mmes;
+static std::atomic<uint32_t> tapped;
+static std::atomic<uint32_t> mismatches;
+static std::atomic<uint32_t> lost;
+static uint16_t frame_len = 256;
+
+static bool is_mme_seq(uint32_t seq)
+{
+    return (seq & 7) == 7;
+}
+
+static void fill(qca::MutableBytes f, uint32_t seq)
+{
+    memset(f.data(), 0xFF, qca::eth::alen);
+    memcpy(f.data() + qca::eth::alen, mac_local, qca::eth::alen);
+
+    if (is_mme_seq(seq))
+    {
+        auto *req = reinterpret_cast<qca_mme_slac_parm_req_t *>(f.data());
+        memset(f.data() + qca::eth::hlen, 0, f.size() - qca::eth::hlen);
+        req->av.hdr.ethertype = __builtin_bswap16(QCA_MME_ETHERTYPE);
+        req->av.hdr.mmv       = QCA_MME_MMV_AV_1_1;
+        req->av.hdr.mmtype    = QCA_MMTYPE_CM_SLAC_PARM | QCA_MMTYPE_REQ;
+        memcpy(req->run_id, &seq, sizeof(seq));
+        return;
+    }
+
+    f[12] = FRAME_ETHERTYPE >> 8;
+    f[13] = FRAME_ETHERTYPE & 0xFF;
+    memcpy(f.data() + qca::eth::hlen, &seq, sizeof(seq));
+    for (size_t i = qca::eth::hlen + sizeof(seq); i < f.size(); i++) f[i] = static_cast<uint8_t>(seq + i);
+}
+
+/* Return: true if the frame is one of ours, its number in seq */
+static bool check(const qca::Frame &frame, uint32_t *seq)
+{
+    qca::Bytes f = frame.bytes();
+    const qca_mme_slac_parm_req_t *req;
+
+    if (f.size() < frame_len || memcmp(qca::eth::src(f).data(), mac_local, qca::eth::alen) != 0)
+        return false;
+
+    if (qca::mme::is_mme(f))
+    {
+        req = qca::mme::as<qca_mme_slac_parm_req_t>(f, QCA_MMTYPE_CM_SLAC_PARM | QCA_MMTYPE_REQ);
+        if (req == nullptr || qca::mme::base(qca::mme::mmtype(f)) != QCA_MMTYPE_CM_SLAC_PARM)
+            return false;
+        memcpy(seq, req->run_id, sizeof(*seq));
+        mmes++;
+        return is_mme_seq(*seq);
+    }
+
+    if (qca::eth::ethertype(f) != FRAME_ETHERTYPE || !qca::eth::is_broadcast(f))
+        return false;
+    memcpy(seq, f.data() + qca::eth::hlen, sizeof(*seq));
+    for (size_t i = qca::eth::hlen + sizeof(*seq); i < frame_len; i++)
+        if (f[i] != static_cast<uint8_t>(*seq + i))
+            return false;
+    return true;
+}
+
+extern "C" void qca_network_thread(void *data)
+{
+    qca::Frame batch[8];
+    uint32_t next = 0, seq = 0;
+    size_t i, n;
+
+    (void)data;
+    for (;;)
+    {
+        n = qca::Link::recv(batch);
+        for (i = 0; i < n; i++)
+        {
+            /* Gaps are frames dropped on a full RX ring */
+            if (!check(batch[i], &seq))
+                mismatches++;
+            else if (seq != next)
+                lost += seq - next;
+            next = seq + 1;
+
+            /* A second owner of the same bytes, dropped right away */
+            qca::Frame tap = batch[i].share();
+            if (tap && tap.shared())
+                tapped++;
+
+            batch[i].reset();
+            received++;
+        }
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-n frames] [-s size]\n"
+            "  -n  frames to send, default 100000\n"
+            "  -s  frame length, default 256\n",
+            prog);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t count = 100000, seq, busy = 0;
+    int64_t start, elapsed;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            count = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+            break;
+        case 's':
+            frame_len = static_cast<uint16_t>(strtoul(optarg, nullptr, 0));
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (frame_len < sizeof(qca_mme_slac_parm_req_t) || frame_len < QCAFRM_ETHMINLEN || frame_len > QCAFRM_ETHMAXLEN)
+        usage(argv[0]);
+
+    qca7k_sim_init(QCASPI_INT, QCASPI_RST);
+    qca7k_sim_set_loopback(true);
+    qca_ll_init();
+
+    start = esp_timer_get_time();
+    for (seq = 0; seq < count; seq++)
+    {
+        qca::Frame f = qca::Frame::alloc(frame_len);
+        fill(f.data(), seq);
+
+        /* A full TX ring leaves the frame with us */
+        while (qca::Link::send(std::move(f)) == ESP_ERR_NO_MEM)
+        {
+            busy++;
+            usleep(50);
+        }
+    }
+
+    for (int i = 0; i < 100 && received + lost < count; i++) usleep(10000);
+    elapsed = esp_timer_get_time() - start;
+
+    printf("frames      %u sent (%u busy), %u received, %u MMEs, %u tapped, %.0f frames/s\n", count, busy,
+           received.load(), mmes.load(), tapped.load(), received * 1e6 / elapsed);
+    printf("mismatches  %u, lost %u (rx_dropped %u), loopback drops %u, rx_copied %u\n", mismatches.load(),
+           lost.load(), qca::Link::stats().rx_dropped, qca7k_sim_loopback_drops(), qca::Link::stats().rx_copied);
+    return mismatches == 0 && received + lost == count ? 0 : 1;
+}
@@ -0,0 +1,358 @@
+/*====================================================================*
+ *
+ *   qca_pcap_replay.c
+ *
+ *   Replay a pcap of PLC traffic through the driver's RX path on a
+ *   Linux host.
+ *
+ *   Every Ethernet frame of the capture is queued in the QCA7000 model
+ *   (host/qca7k_sim.c), which encodes it the way the chip does: 4 bytes
+ *   hardware length, QcaFrmCreateHeader, frame, QcaFrmCreateFooter. The
+ *   unmodified qcaspi_receive then reads it back over the simulated SPI
+ *   bus with the regular framing state machine and deficit budget, and
+ *   each frame taken from the RX ring is compared bit for bit with the
+ *   capture.
+ *
+ *   By default frames are replayed as fast as possible and the decode
+ *   throughput is reported; -r replays at the recorded speed and
+ *   reports the latency from the recorded arrival to the decoded frame.
+ *
+ *   Build from the repository root:
+ *
+ *   cc -O2 -I. -Ihost -Ihost/include -o qca_pcap_replay tools/qca_pcap_replay.c \
+ *       qca_spi.c qca_buf.c qca_7k.c qca_framing.c qca_bus_esp.c host/host_port.c host/qca7k_sim.c -lpthread
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca7k_sim.h"
+#include "qca_7k.h"
+#include "qca_buf.h"
+#include "qca_framing.h"
+#include "qca_spi.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PCAP_MAGIC_US   0xA1B2C3D4
+#define PCAP_MAGIC_NS   0xA1B23C4D
+#define PCAP_LINKTYPE_ETHERNET 1
+
+/* Longest frame as it sits in the QCA7k read buffer */
+#define REPLAY_MIN_CHUNK (QCASPI_HW_PKT_LEN + QCAFRM_ETHMAXLEN + QCAFRM_FRAME_OVERHEAD)
+
+typedef struct {
+    int64_t time; /* us, relative to the first frame */
+    uint16_t len; /* padded to QCAFRM_ETHMINLEN */
+    uint8_t *data;
+} replay_frame_t;
+
+typedef struct {
+    replay_frame_t *frames;
+    size_t count;
+    size_t skipped; /* truncated, oversized or not Ethernet */
+    uint64_t bytes;
+} replay_capture_t;
+
+static uint32_t pcap_u32(const uint8_t *p, int swap)
+{
+    uint32_t v = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    return swap ? __builtin_bswap32(v) : v;
+}
+
+/*====================================================================*
+ *
+ *   replay_load
+ *
+ *   Read a classic pcap file (either byte order, us or ns timestamps)
+ *   into memory.
+ *
+ *   Return: 0 on success, -1 with a message on stderr otherwise.
+ *
+ *--------------------------------------------------------------------*/
+
+static int replay_load(const char *path, replay_capture_t *cap)
+{
+    uint8_t hdr[24], rec[16];
+    size_t alloc = 0;
+    int64_t first = -1;
+    int swap, nsec;
+    FILE *f = fopen(path, "rb");
+
+    if (f == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    if (fread(hdr, sizeof(hdr), 1, f) != 1)
+    {
+        fprintf(stderr, "%s: no pcap header\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    uint32_t magic = pcap_u32(hdr, 0);
+    swap           = (magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS);
+    magic          = pcap_u32(hdr, swap);
+    nsec           = (magic == PCAP_MAGIC_NS);
+    if (magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS)
+    {
+        fprintf(stderr, "%s: not a pcap file (pcapng is not supported)\n", path);
+        fclose(f);
+        return -1;
+    }
+    if (pcap_u32(hdr + 20, swap) != PCAP_LINKTYPE_ETHERNET)
+    {
+        fprintf(stderr, "%s: link type %u, expected Ethernet\n", path, pcap_u32(hdr + 20, swap));
+        fclose(f);
+        return -1;
+    }
+
+    memset(cap, 0, sizeof(*cap));
+    while (fread(rec, sizeof(rec), 1, f) == 1)
+    {
+        int64_t time    = (int64_t)pcap_u32(rec, swap) * 1000000 + pcap_u32(rec + 4, swap) / (nsec ? 1000 : 1);
+        uint32_t caplen = pcap_u32(rec + 8, swap);
+        uint32_t len    = pcap_u32(rec + 12, swap);
+        uint8_t *data   = malloc(caplen < QCAFRM_ETHMINLEN ? QCAFRM_ETHMINLEN : caplen);
+
+        if (data == NULL || fread(data, 1, caplen, f) != caplen)
+        {
+            free(data);
+            break;
+        }
+
+        /* The FCS is not part of a QCA7k frame, so neither are captures that include it */
+        if (caplen != len || caplen > QCAFRM_ETHMAXLEN || caplen < ETH_HLEN)
+        {
+            free(data);
+            cap->skipped++;
+            continue;
+        }
+
+        /* The QCA7000 pads short frames, so does the decoded copy */
+        if (caplen < QCAFRM_ETHMINLEN)
+        {
+            memset(data + caplen, 0, QCAFRM_ETHMINLEN - caplen);
+            caplen = QCAFRM_ETHMINLEN;
+        }
+
+        if (cap->count == alloc)
+        {
+            alloc = alloc ? alloc * 2 : 1024;
+            replay_frame_t *frames = realloc(cap->frames, alloc * sizeof(*frames));
+            if (frames == NULL)
+            {
+                free(data);
+                break;
+            }
+            cap->frames = frames;
+        }
+
+        if (first < 0)
+            first = time;
+        cap->frames[cap->count].time = time - first;
+        cap->frames[cap->count].len  = (uint16_t)caplen;
+        cap->frames[cap->count].data = data;
+        cap->bytes += caplen;
+        cap->count++;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+/* Recorded arrival of frame i, on the esp_timer clock */
+static int64_t replay_due(const replay_capture_t *cap, size_t i, int64_t start, int64_t loop_len)
+{
+    return start + (int64_t)(i / cap->count) * loop_len + cap->frames[i % cap->count].time;
+}
+
+static void replay_sleep_until(int64_t t)
+{
+    int64_t now = esp_timer_get_time();
+
+    if (t > now)
+        usleep((useconds_t)(t - now));
+}
+
+/* -x: ethertype dropped by the RX filter, -1 for no filter */
+static long exclude = -1;
+
+static bool replay_excluded(const replay_frame_t *fr)
+{
+    return exclude >= 0 && ((fr->data[12] << 8) | fr->data[13]) == exclude;
+}
+
+static bool replay_filter(const uint8_t *ethHdr)
+{
+    return ((ethHdr[12] << 8) | ethHdr[13]) != exclude;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-r] [-n loops] [-c bytes] [-x ethertype] [-v] capture.pcap\n"
+            "  -r        replay at recorded speed (default: as fast as possible)\n"
+            "  -n loops  replay the capture loops times (default 1)\n"
+            "  -c bytes  cap RDBUF_BYTE_AVA, so frames straddle reads (>= %d, default: whole read buffer)\n"
+            "  -x type   drop this ethertype in the RX filter\n"
+            "  -v        report every mismatch\n",
+            prog, REPLAY_MIN_CHUNK);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    static qcaspi_t dev;
+    replay_capture_t cap;
+    NetworkBufferDescriptor_t *rxDesc;
+    int realtime = 0, verbose = 0, opt;
+    unsigned long loops = 1, chunk = 0;
+
+    while ((opt = getopt(argc, argv, "rn:c:x:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            realtime = 1;
+            break;
+        case 'n':
+            loops = strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            chunk = strtoul(optarg, NULL, 0);
+            if (chunk < REPLAY_MIN_CHUNK || chunk > QCASPI_HW_BUF_LEN)
+                usage(argv[0]);
+            break;
+        case 'x':
+            exclude = (long)(strtoul(optarg, NULL, 0) & 0xFFFF);
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || loops == 0)
+        usage(argv[0]);
+
+    if (replay_load(argv[optind], &cap) != 0)
+        return 1;
+    if (cap.count == 0)
+    {
+        fprintf(stderr, "%s: no usable frames (%zu skipped)\n", argv[optind], cap.skipped);
+        return 1;
+    }
+
+    /* The driver side: the real RX path on a local handle, no SPI thread */
+    qca7k_sim_init(-1, -1);
+    qca7k_sim_set_chunk((uint16_t)chunk);
+    spi_bus_add_device(SPI2_HOST, NULL, &dev.handle);
+    dev.bus.xfer = qca_bus_esp_xfer;
+    dev.bus.ctx  = dev.handle;
+    if (!qca_ring_init(&dev.rxRing, QCASPI_RX_RING_DEPTH) || !qca_ring_init(&dev.txRing, QCASPI_TX_RING_DEPTH))
+        return 1;
+    QcaFrmFsmInitSpi(&dev.lFrmHdl);
+    if (exclude >= 0)
+        dev.rx_filter = replay_filter;
+
+    size_t total = cap.count * loops;
+    size_t in = 0, out = 0, mismatches = 0, calls = 0;
+    size_t delivered = 0;
+    int64_t lat_sum = 0, lat_max = 0;
+    int64_t start   = esp_timer_get_time();
+    int64_t loop_len = cap.frames[cap.count - 1].time + 1;
+
+    while (out < total)
+    {
+        size_t fed = in, taken = out;
+        size_t space;
+        bool full = false;
+
+        /* Everything that is due and fits goes into the QCA7k read buffer */
+        while (in < total)
+        {
+            if (realtime && replay_due(&cap, in, start, loop_len) > esp_timer_get_time())
+                break;
+            if (!qca7k_sim_rx_frame(cap.frames[in % cap.count].data, cap.frames[in % cap.count].len))
+            {
+                full = true;
+                break;
+            }
+            in++;
+        }
+
+        /* One scheduler round worth of RX, as the SPI thread would do it */
+        space           = qca7k_sim_rx_space();
+        dev.rx_irq_time = esp_timer_get_time();
+        dev.sched.rx_deficit += QCASPI_SCHED_RX_QUANTUM;
+        qcaspi_receive(&dev);
+        calls++;
+
+        while ((rxDesc = qca_ring_pop(&dev.rxRing)) != NULL)
+        {
+            while (out < in && replay_excluded(&cap.frames[out % cap.count])) out++;
+            const replay_frame_t *fr = &cap.frames[out % cap.count];
+
+            if (rxDesc->xDataLength != fr->len || memcmp(rxDesc->pucEthernetBuffer, fr->data, fr->len) != 0)
+            {
+                mismatches++;
+                if (verbose)
+                    fprintf(stderr, "frame %zu: %zu bytes decoded, %u expected%s\n", out, rxDesc->xDataLength,
+                            fr->len, rxDesc->xDataLength == fr->len ? ", content differs" : "");
+            }
+
+            if (realtime)
+            {
+                int64_t lat = rxDesc->xDoneTime - replay_due(&cap, out, start, loop_len);
+                lat_sum += lat;
+                if (lat > lat_max)
+                    lat_max = lat;
+            }
+
+            qca_free_desc(rxDesc);
+            delivered++;
+            out++;
+        }
+        while (out < in && replay_excluded(&cap.frames[out % cap.count])) out++;
+
+        if (in > fed || out > taken || qca7k_sim_rx_space() != space)
+            continue;
+
+        /* No progress. Either the next frame is not due yet ... */
+        if (in < total && !full)
+        {
+            replay_sleep_until(replay_due(&cap, in, start, loop_len));
+            continue;
+        }
+
+        /* ... or the decoder lost frames and cannot get any further */
+        if (verbose)
+            fprintf(stderr, "decoder stuck after frame %zu, %zu frames lost\n", out, total - out);
+        mismatches += total - out;
+        break;
+    }
+
+    double secs = (esp_timer_get_time() - start) / 1e6;
+
+    printf("frames      %zu (%zu per loop, %zu skipped)\n", total, cap.count, cap.skipped);
+    printf("mismatches  %zu\n", mismatches);
+    printf("rx_errors   %u, rx_dropped %u, rx_filtered %u\n", dev.stats.rx_errors, dev.stats.rx_dropped,
+           dev.stats.rx_filtered);
+    printf("receives    %zu (%u deferred)\n", calls, dev.stats.rx_deferred);
+    printf("time        %.3f s\n", secs);
+    if (realtime)
+        printf("latency     avg %.1f us, max %lld us\n", (double)lat_sum / (delivered ? delivered : 1), (long long)lat_max);
+    else
+        printf("throughput  %.0f frames/s, %.2f MB/s\n", total / secs, cap.bytes * loops / secs / 1e6);
+
+    for (size_t i = 0; i < cap.count; i++) free(cap.frames[i].data);
+    free(cap.frames);
+
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,215 @@
+/*====================================================================*
+ *
+ *   qca_perf_host.c
+ *
+ *   Run the traffic generator and sink on a Linux host against the
+ *   QCA7000 model in loopback.
+ *
+ *   The whole driver runs unmodified: qca_ll_init resets the model,
+ *   the SPI thread syncs on CPU_ON, and every frame qca_perf sends is
+ *   written over the simulated SPI bus, looped back into the read
+ *   buffer and received again. This measures the driver and framing
+ *   cost without a powerline in between; the SPI transfers themselves
+ *   take no time.
+ *
+ *   -b puts a broadcast storm of minimum size frames next to the test
+ *   traffic, -p limits broadcasts to that rate with the RX policer.
+ *
+ *   -g garbles a write burst halfway through the run, and the model
+ *   takes that long over the soft reset that follows. Build with
+ *   -DQCASPI_TX_HOLD_MS=... to keep the TX ring through it.
+ *
+ *   Build from the repository root:
+ *
+ *   cc -O2 -I. -Ihost -Ihost/include -o qca_perf_host tools/qca_perf_host.c \
+ *       qca_driver.c qca_spi.c qca_buf.c qca_7k.c qca_framing.c qca_bus_esp.c qca_perf.c \
+ *       qca_rx_police.c host/host_port.c host/qca7k_sim.c -lpthread
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca7k_sim.h"
+#include "qca_driver.h"
+#include "qca_perf.h"
+#include "qca_rx_police.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static uint32_t storm_pps;
+static uint32_t storm_sent;
+static uint32_t storm_full;
+
+/* Broadcasts from elsewhere on the powerline, paced in 1 ms slots */
+static void *storm_thread(void *arg)
+{
+    uint8_t frame[QCAFRM_ETHMINLEN] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02, 0, 0, 0, 0, 0x99, 0x88, 0xB5};
+    uint64_t due = 0;
+    uint32_t n;
+
+    (void)arg;
+    for (;;)
+    {
+        due += storm_pps;
+        for (n = (uint32_t)(due / 1000); n > 0; n--)
+        {
+            if (qca7k_sim_rx_frame(frame, sizeof(frame)))
+                storm_sent++;
+            else
+                storm_full++;
+        }
+        due %= 1000;
+        usleep(1000);
+    }
+    return NULL;
+}
+
+void qca_network_thread(void *data)
+{
+    NetworkBufferDescriptor_t *desc;
+
+    for (;;)
+    {
+        desc = qca_recv(portMAX_DELAY);
+        if (desc != NULL && !qca_perf_rx(desc))
+            qca_free_desc(desc);
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-s size] [-r pps] [-t seconds] [-e ethertype] [-b pps] [-p pps] [-g ms]\n"
+            "  -s  frame length, default 1514\n"
+            "  -r  TX rate, default 0 (as fast as the TX ring takes them)\n"
+            "  -t  run time, default 5\n"
+            "  -e  ethertype, default 0x%04X\n"
+            "  -b  broadcast storm rate, default 0\n"
+            "  -p  police broadcasts to this rate, default 0 (off)\n"
+            "  -g  resync halfway, the QCA7k down this long, default 0 (none)\n",
+            prog, QCA_PERF_ETHERTYPE);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    qca_perf_config_t cfg = {
+        .mode      = QCA_PERF_TX | QCA_PERF_RX,
+        .frame_len = 1514,
+        .rate_pps  = 0,
+        .ethertype = QCA_PERF_ETHERTYPE,
+        .dest      = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02},
+        .src       = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01},
+    };
+    qca_rx_police_rule_t rule = {.burst = 16};
+    qca_rx_police_stats_t ps;
+    qca_resource_report_t rr;
+    qca_perf_report_t t;
+    pthread_t thread;
+    unsigned seconds = 5;
+    uint32_t glitch_ms = 0;
+    esp_err_t err;
+    int opt, i;
+
+    while ((opt = getopt(argc, argv, "s:r:t:e:b:p:g:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            cfg.frame_len = (uint16_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            cfg.rate_pps = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            seconds = (unsigned)strtoul(optarg, NULL, 0);
+            break;
+        case 'e':
+            cfg.ethertype = (uint16_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'b':
+            storm_pps = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'p':
+            rule.rate_pps = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'g':
+            glitch_ms = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    qca7k_sim_init(QCASPI_INT, QCASPI_RST);
+    qca7k_sim_set_loopback(true);
+    qca_ll_init();
+
+    if (rule.rate_pps != 0)
+    {
+        qca_rx_police_set(QCA_RX_POLICE_BCAST, &rule);
+        qca_rx_police_enable(true);
+    }
+    if (storm_pps != 0)
+    {
+        pthread_create(&thread, NULL, storm_thread, NULL);
+        pthread_detach(thread);
+    }
+
+    err = qca_perf_start(&cfg);
+    if (err != ESP_OK)
+    {
+        fprintf(stderr, "qca_perf_start: error 0x%x\n", (unsigned)err);
+        return 1;
+    }
+
+    if (glitch_ms != 0)
+    {
+        usleep(seconds * 500000);
+        qca7k_sim_glitch(glitch_ms);
+        usleep(seconds * 500000);
+    }
+    else
+    {
+        sleep(seconds);
+    }
+    qca_perf_stop();
+    qca_perf_get_totals(&t);
+
+    printf("%u ms: TX %u frames (%u busy) %u kbit/s, RX %u frames %u kbit/s, lost %u, reordered %u\n", t.interval_ms,
+           t.tx_frames, t.tx_busy, t.tx_kbps, t.rx_frames, t.rx_kbps, t.rx_lost, t.rx_reordered);
+    printf("RTT avg %u us max %u us, SPI thread load %u.%u%%, loopback drops %u\n", t.rtt_avg_us, t.rtt_max_us,
+           t.spi_load / 10, t.spi_load % 10, qca7k_sim_loopback_drops());
+    printf("RX copied into smaller buffers %u\n", qca.stats.rx_copied);
+    if (glitch_ms != 0)
+        printf("resync: %u device resets, TX held %u, replayed %u, dropped %u (%u expired)\n", qca.stats.device_reset,
+               qca.stats.tx_held, qca.stats.tx_replayed, qca.stats.tx_dropped, qca.stats.tx_expired);
+    if (storm_pps != 0)
+    {
+        qca_rx_police_get_stats(&ps);
+        printf("storm %u sent (%u on a full buffer), policed %u, broadcasts passed %u, RX throttled %u times\n",
+               storm_sent, storm_full, qca.stats.rx_policed, ps.passed[QCA_RX_POLICE_BCAST], qca.stats.rx_throttle);
+    }
+
+    qca_get_resource_report(&rr);
+    for (i = 0; i < QCA_TASKS; i++)
+        if (rr.tasks[i].name != NULL)
+            printf("task %-12s stack %u, %u never used\n", rr.tasks[i].name, rr.tasks[i].stack_size,
+                   rr.tasks[i].stack_free);
+    printf("rings: TX %u/%u peak %u, RX %u/%u peak %u; SPI burst peak %u of %u\n", rr.tx_ring.count, rr.tx_ring.depth,
+           rr.tx_ring.peak, rr.rx_ring.count, rr.rx_ring.depth, rr.rx_ring.peak, rr.xfer_peak, rr.xfer_size);
+    printf("frames: %u bytes in %u buffers, peak %u, %u allocations failed; fixed %u bytes\n", rr.frames.bytes,
+           rr.frames.buffers, rr.frames.bytes_peak, rr.frames.alloc_failures, rr.fixed_bytes);
+
+    for (i = 0; i < QCASPI_REGS; i++)
+    {
+        const qcaspi_reg_stats_t *r = &qca.regs.stats[i];
+
+        if (r->reads || r->writes || r->reads_elided || r->writes_elided)
+            printf("reg 0x%04X  read %u (+%u elided), written %u (+%u elided)\n", i << 8, r->reads, r->reads_elided,
+                   r->writes, r->writes_elided);
+    }
+    return 0;
+}
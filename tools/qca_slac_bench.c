@@ -0,0 +1,121 @@
+/*====================================================================*
+ *
+ *   qca_slac_bench.c
+ *
+ *   Run the SLAC round trip benchmark on a Linux host against an
+ *   emulated EVSE.
+ *
+ *   The whole driver runs unmodified on the QCA7000 model; the EVSE
+ *   (host/qca_slac_peer.c) sees every frame written to the model and
+ *   answers through its read buffer, so every leg covers qca_send, the
+ *   TX ring, the SPI thread, framing, the RX ring and qca_recv. The
+ *   first line of the output names the driver configuration, so runs
+ *   of different builds (-DQCASPI_TX_RING_DEPTH=..., -DQCASPI_SCHED_...)
+ *   can be compared side by side.
+ *
+ *   Build from the repository root:
+ *
+ *   cc -O2 -I. -Ihost -Ihost/include -o qca_slac_bench tools/qca_slac_bench.c \
+ *       qca_driver.c qca_spi.c qca_buf.c qca_7k.c qca_framing.c qca_bus_esp.c qca_mme.c \
+ *       qca_bench_slac.c host/host_port.c host/qca7k_sim.c host/qca_slac_peer.c -lpthread
+ *
+ *--------------------------------------------------------------------*/
+
+#include "qca7k_sim.h"
+#include "qca_bench_slac.h"
+#include "qca_driver.h"
+#include "qca_slac_peer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void qca_network_thread(void *data)
+{
+    NetworkBufferDescriptor_t *desc;
+
+    (void)data;
+    for (;;)
+    {
+        desc = qca_recv(portMAX_DELAY);
+        if (desc != NULL && !qca_bench_slac_rx(desc))
+            qca_free_desc(desc);
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-n sessions] [-k sounds] [-d us] [-i ms]\n"
+            "  -n  SLAC sessions, default 1000\n"
+            "  -k  CM_MNBC_SOUND.INDs the EVSE asks for, default 10\n"
+            "  -d  EVSE think time before every answer, default 0\n"
+            "  -i  gap between sounds, default 0\n",
+            prog);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    qca_bench_slac_config_t cfg = {
+        .sessions = 1000,
+        .pev_mac  = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01},
+    };
+    qca_slac_peer_config_t evse = {
+        .evse_mac   = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02},
+        .num_sounds = 10,
+    };
+    qca_bench_slac_report_t r;
+    qca_slac_peer_stats_t ps;
+    esp_err_t err;
+    int opt, leg;
+
+    while ((opt = getopt(argc, argv, "n:k:d:i:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            cfg.sessions = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'k':
+            evse.num_sounds = (uint8_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'd':
+            evse.delay_us = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'i':
+            cfg.sound_interval_ms = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    printf("config      tx_ring %d, rx_ring %d, sched rx %d/%d tx %d/%d, codel %d/%d us, multi_producer %d\n",
+           QCASPI_TX_RING_DEPTH, QCASPI_RX_RING_DEPTH, QCASPI_SCHED_RX_FRAMES, QCASPI_SCHED_RX_QUANTUM,
+           QCASPI_SCHED_TX_FRAMES, QCASPI_SCHED_TX_QUANTUM, QCASPI_TX_CODEL_TARGET_US, QCASPI_TX_CODEL_INTERVAL_US,
+           QCASPI_TX_MULTI_PRODUCER);
+    printf("peer        %u sounds, %u us think time\n", evse.num_sounds, evse.delay_us);
+
+    qca7k_sim_init(QCASPI_INT, QCASPI_RST);
+    qca_slac_peer_init(&evse);
+    qca_ll_init();
+
+    err = qca_bench_slac(&cfg, &r);
+    if (err != ESP_OK)
+    {
+        fprintf(stderr, "qca_bench_slac: error 0x%x\n", (unsigned)err);
+        return 1;
+    }
+
+    qca_slac_peer_get_stats(&ps);
+    printf("sessions    %u, %u failed; EVSE saw %u SLAC_PARM, %u sounds, %u SLAC_MATCH, dropped %u\n", r.sessions,
+           r.failed, ps.parm, ps.sounds, ps.match, ps.dropped);
+    printf("%-16s %7s %8s %8s %8s %8s\n", "leg", "n", "p50 us", "p90 us", "p99 us", "max us");
+    for (leg = 0; leg < QCA_BENCH_SLAC_LEGS; leg++)
+        printf("%-16s %7u %8u %8u %8u %8u\n", qca_bench_slac_leg_name(leg), r.leg[leg].count, r.leg[leg].p50_us,
+               r.leg[leg].p90_us, r.leg[leg].p99_us, r.leg[leg].max_us);
+
+    return r.failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,323 @@
+/*====================================================================*
+ *
+ *   qca_tapd.c
+ *
+ *   Bridge a QCA7000 on a Linux SPI bus to a TAP interface.
+ *
+ *   The driver runs single threaded on the Linux backend
+ *   (linux/qca_linux.c): the QCA7000 interrupt is a GPIO line event,
+ *   SPI goes through spidev, and every frame the TAP interface sends
+ *   is written to the powerline and every frame received is handed to
+ *   it, all from one epoll loop.
+ *
+ *   -S stands the QCA7000 model (host/qca7k_sim.c) in for the chip, in
+ *   loopback: its interrupt arrives through an eventfd and the reset
+ *   line through the host GPIO shim. Without -t, the stand-in loops
+ *   numbered frames through a SOCK_SEQPACKET socketpair instead of a
+ *   TAP interface and checks every one of them.
+ *
+ *   Build from the repository root:
+ *
+ *   cc -O2 -I. -Ihost -Ihost/include -Ilinux -o qca_tapd tools/qca_tapd.c \
+ *       linux/qca_linux.c qca_spi.c qca_buf.c qca_7k.c qca_framing.c qca_bus_esp.c \
+ *       host/host_port.c host/qca7k_sim.c -lpthread
+ *
+ *   qca_tapd -d /dev/spidev0.0 -g gpiochip0 -i 25 -r 24 -t qca0 &
+ *   ip link set qca0 up
+ *
+ *--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include "qca7k_sim.h"
+#include "qca_driver.h"
+#include "qca_linux.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define TAPD_ETHERTYPE 0x88B5
+#define TAPD_WINDOW    16
+
+static qcaspi_t dev;
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s -d spidev -g gpiochip -i irq_line -r rst_line -t tap [-c hz]\n"
+            "       %s -S [-t tap] [-n frames] [-s size]\n"
+            "  -d  spidev node, e.g. /dev/spidev0.0\n"
+            "  -c  SPI clock, default %d\n"
+            "  -g  GPIO chip of the interrupt and reset lines, e.g. gpiochip0\n"
+            "  -i  interrupt line offset\n"
+            "  -r  reset line offset\n"
+            "  -t  TAP interface name\n"
+            "  -S  stand in the QCA7000 model, in loopback, for the chip\n"
+            "  -n  stand-in self-test frames, default 20000\n"
+            "  -s  stand-in self-test frame length, default random 60..1518\n",
+            prog, prog, QCASPI_CLK_SPEED);
+    exit(2);
+}
+
+/*====================================================================*
+ *   stand-in;
+ *--------------------------------------------------------------------*/
+
+/* The model raises its interrupt from inside an SPI transfer */
+static void sim_irq(void *arg)
+{
+    uint64_t one = 1;
+
+    if (write(*(int *)arg, &one, sizeof(one)) < 0)
+        abort();
+}
+
+static void fill_frame(uint8_t *frame, uint32_t seq, uint16_t len)
+{
+    uint16_t i;
+
+    memset(frame, 0xFF, 6);
+    memcpy(frame + 6, "\x02\x00\x00\x00\x00\x01", 6);
+    frame[12] = TAPD_ETHERTYPE >> 8;
+    frame[13] = TAPD_ETHERTYPE & 0xFF;
+    memcpy(frame + 14, &seq, sizeof(seq));
+    for (i = 18; i < len; i++) frame[i] = (uint8_t)(seq + i);
+}
+
+struct loop_args {
+    int irq_fd;
+    int frame_fd;
+    int ret;
+};
+
+static void *loop_thread(void *arg)
+{
+    struct loop_args *a = arg;
+
+    a->ret = qca_linux_run(&dev, a->irq_fd, a->frame_fd, &stop);
+    return NULL;
+}
+
+/* TAPD_WINDOW frames in flight at a time, each one checked on return */
+static int self_test(int irq_fd, unsigned frames, unsigned size)
+{
+    uint8_t frame[QCAFRM_ETHMAXLEN], expect[QCAFRM_ETHMAXLEN];
+    static uint16_t frame_len_of[65536];
+    struct timeval tv = {.tv_sec = 1};
+    struct loop_args args;
+    unsigned sent = 0, received = 0, mismatches = 0;
+    uint64_t bytes = 0;
+    int64_t start, us;
+    pthread_t loop;
+    uint32_t seq, next = 0;
+    ssize_t len;
+    int sv[2];
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0)
+    {
+        perror("socketpair");
+        return 1;
+    }
+    setsockopt(sv[1], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    args.irq_fd   = irq_fd;
+    args.frame_fd = sv[0];
+    pthread_create(&loop, NULL, loop_thread, &args);
+
+    /* The first frames would only be flushed before sync */
+    while (dev.sync != QCASPI_SYNC_READY) usleep(1000);
+
+    srand(1);
+    start = esp_timer_get_time();
+    while (received < frames)
+    {
+        while (sent < frames && sent - received < TAPD_WINDOW)
+        {
+            frame_len_of[sent & 0xFFFF] =
+                size ? size : QCAFRM_ETHMINLEN + rand() % (QCAFRM_ETHMAXLEN - QCAFRM_ETHMINLEN + 1);
+            fill_frame(frame, sent, frame_len_of[sent & 0xFFFF]);
+            if (write(sv[1], frame, frame_len_of[sent & 0xFFFF]) < 0)
+                break;
+            bytes += frame_len_of[sent & 0xFFFF];
+            sent++;
+        }
+
+        len = read(sv[1], frame, sizeof(frame));
+        if (len < 18)
+            break;
+
+        memcpy(&seq, frame + 14, sizeof(seq));
+        fill_frame(expect, seq, frame_len_of[seq & 0xFFFF]);
+        if (seq != next || len != frame_len_of[seq & 0xFFFF] || memcmp(frame, expect, len) != 0)
+            mismatches++;
+        next = seq + 1;
+        received++;
+    }
+    us = esp_timer_get_time() - start;
+
+    stop = 1;
+    pthread_join(loop, NULL);
+
+    printf("frames      %u sent, %u received, %u dropped by the model\n", sent, received,
+           (unsigned)qca7k_sim_loopback_drops());
+    printf("mismatches  %u\n", mismatches);
+    printf("rx_errors   %u, rx_dropped %u, tx_expired %u, tx_aqm_drop %u\n", dev.stats.rx_errors,
+           dev.stats.rx_dropped, dev.stats.tx_expired, dev.stats.tx_aqm_drop);
+    printf("throughput  %.2f MB/s each way\n", (double)bytes / (double)us);
+
+    return (args.ret == 0 && received == frames && mismatches == 0) ? 0 : 1;
+}
+
+static int stand_in(const char *tap, unsigned frames, unsigned size)
+{
+    spi_device_handle_t handle;
+    static int irq_fd;
+    qca_bus_t bus;
+    int frame_fd;
+
+    irq_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (irq_fd < 0)
+    {
+        perror("eventfd");
+        return 1;
+    }
+
+    qca7k_sim_init(QCASPI_INT, QCASPI_RST);
+    qca7k_sim_set_loopback(true);
+    gpio_isr_handler_add(QCASPI_INT, sim_irq, &irq_fd);
+    spi_bus_add_device(SPI2_HOST, NULL, &handle);
+    bus.xfer = qca_bus_esp_xfer;
+    bus.ctx  = handle;
+    if (qca_linux_init(&dev, &bus) != ESP_OK)
+        return 1;
+
+    /* CPU_ON waits in the eventfd until the loop runs */
+    gpio_set_level(QCASPI_RST, 0);
+    usleep(QCASPI_RESET_HOLD_MS * 1000);
+    gpio_set_level(QCASPI_RST, 1);
+
+    if (tap == NULL)
+        return self_test(irq_fd, frames, size);
+
+    frame_fd = qca_linux_tap_open(tap);
+    if (frame_fd < 0)
+    {
+        fprintf(stderr, "%s: %s\n", tap, strerror(errno));
+        return 1;
+    }
+    return qca_linux_run(&dev, irq_fd, frame_fd, &stop) == 0 ? 0 : 1;
+}
+
+/*====================================================================*
+ *   main;
+ *--------------------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+    const char *spidev = NULL, *chip = NULL, *tap = NULL;
+    uint32_t speed    = QCASPI_CLK_SPEED;
+    long irq_line     = -1, rst_line = -1;
+    unsigned frames   = 20000, size = 0;
+    bool sim          = false;
+    int irq_fd, rst_fd, frame_fd, opt, ret;
+    struct sigaction sa = {.sa_handler = on_signal};
+    qca_bus_t bus;
+
+    while ((opt = getopt(argc, argv, "d:c:g:i:r:t:Sn:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            spidev = optarg;
+            break;
+        case 'c':
+            speed = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'g':
+            chip = optarg;
+            break;
+        case 'i':
+            irq_line = strtol(optarg, NULL, 0);
+            break;
+        case 'r':
+            rst_line = strtol(optarg, NULL, 0);
+            break;
+        case 't':
+            tap = optarg;
+            break;
+        case 'S':
+            sim = true;
+            break;
+        case 'n':
+            frames = (unsigned)strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            size = (unsigned)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (sim)
+    {
+        if (frames == 0 || frames > 65536 || (size && (size < QCAFRM_ETHMINLEN || size > QCAFRM_ETHMAXLEN)))
+        {
+            fprintf(stderr, "frames 1..65536, size %d..%d\n", QCAFRM_ETHMINLEN, QCAFRM_ETHMAXLEN);
+            return 2;
+        }
+        return stand_in(tap, frames, size);
+    }
+
+    if (spidev == NULL || chip == NULL || irq_line < 0 || rst_line < 0 || tap == NULL)
+        usage(argv[0]);
+
+    if (qca_linux_spidev_open(spidev, speed, &bus) != ESP_OK || qca_linux_init(&dev, &bus) != ESP_OK)
+    {
+        fprintf(stderr, "%s: %s\n", spidev, strerror(errno));
+        return 1;
+    }
+
+    /* Hold the chip in reset until its interrupt is being listened to */
+    rst_fd = qca_linux_gpio_out(chip, (unsigned)rst_line, 0);
+    irq_fd = qca_linux_gpio_irq(chip, (unsigned)irq_line);
+    if (rst_fd < 0 || irq_fd < 0)
+    {
+        fprintf(stderr, "%s: %s\n", chip, strerror(errno));
+        return 1;
+    }
+
+    frame_fd = qca_linux_tap_open(tap);
+    if (frame_fd < 0)
+    {
+        fprintf(stderr, "%s: %s\n", tap, strerror(errno));
+        return 1;
+    }
+
+    usleep(QCASPI_RESET_HOLD_MS * 1000);
+    qca_linux_gpio_set(rst_fd, 1);
+
+    ret = qca_linux_run(&dev, irq_fd, frame_fd, &stop);
+
+    printf("rx_packets %u, tx_packets %u, rx_errors %u, tx_errors %u, device_reset %u\n", dev.stats.rx_packets,
+           dev.stats.tx_packets, dev.stats.rx_errors, dev.stats.tx_errors, dev.stats.device_reset);
+    return ret == 0 ? 0 : 1;
+}
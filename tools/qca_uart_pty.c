@@ -0,0 +1,193 @@
+/*====================================================================*
+ *
+ *   qca_uart_pty.c
+ *
+ *   Run the UART transport on a Linux host over a pseudo-terminal pair.
+ *
+ *   The driver side of qca_uart.c is attached to the pty slave. This
+ *   tool plays the modem on the master: it decodes every frame the
+ *   driver writes and sends it straight back, optionally behind some
+ *   bytes of line noise. Numbered frames of random length go out
+ *   through qca_send, come back through qca_recv and are checked for
+ *   order and content.
+ *
+ *   Build from the repository root:
+ *
+ *   cc -O2 -I. -Ihost -Ihost/include -o qca_uart_pty tools/qca_uart_pty.c \
+ *       qca_uart.c qca_driver.c qca_spi.c qca_buf.c qca_7k.c qca_framing.c qca_bus_esp.c \
+ *       host/host_port.c -lpthread
+ *
+ *--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include "qca_driver.h"
+#include "qca_uart.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PTY_ETHERTYPE 0x88B5
+
+static int master_fd;
+static unsigned noise;
+static uint16_t frame_len_of[65536];
+static atomic_uint received;
+static atomic_uint mismatches;
+static uint32_t modem_frames;
+
+static void fill_frame(uint8_t *frame, uint32_t seq, uint16_t len)
+{
+    uint16_t i;
+
+    memset(frame, 0xFF, 6);
+    memcpy(frame + 6, "\x02\x00\x00\x00\x00\x01", 6);
+    frame[12] = PTY_ETHERTYPE >> 8;
+    frame[13] = PTY_ETHERTYPE & 0xFF;
+    memcpy(frame + 14, &seq, sizeof(seq));
+    for (i = 18; i < len; i++) frame[i] = (uint8_t)(seq + i);
+}
+
+/* The modem: every decoded frame goes back, re-encoded */
+static void *modem_thread(void *arg)
+{
+    static uint8_t in[4096], frame[QCAFRM_ETHMAXLEN], out[64 + QCAFRM_ETHMAXLEN + QCAFRM_FRAME_OVERHEAD];
+    QcaFrmHdl hdl;
+    uint16_t used, pos;
+    ssize_t len;
+    int32_t ret;
+    size_t n;
+
+    (void)arg;
+    QcaFrmFsmInit(&hdl);
+
+    while ((len = read(master_fd, in, sizeof(in))) > 0)
+    {
+        for (pos = 0; pos < len; pos += used)
+        {
+            ret = QcaFrmFsmDecodeBuf(&hdl, in + pos, (uint16_t)(len - pos), &used, frame);
+            if (ret <= 0)
+                continue;
+
+            modem_frames++;
+            for (n = 0; n < noise && n < 64; n++) out[n] = (n & 1) ? 0xAA : 0x5A;
+            n += QcaFrmCreateHeader(out + n, ret);
+            memcpy(out + n, frame, ret);
+            n += ret;
+            n += QcaFrmCreateFooter(out + n);
+            if (write(master_fd, out, n) != (ssize_t)n)
+                return NULL;
+        }
+    }
+    return NULL;
+}
+
+void qca_network_thread(void *data)
+{
+    uint8_t expect[QCAFRM_ETHMAXLEN];
+    NetworkBufferDescriptor_t *desc;
+    uint32_t seq, next = 0;
+
+    (void)data;
+    for (;;)
+    {
+        desc = qca_recv(portMAX_DELAY);
+        if (desc == NULL)
+            continue;
+
+        memcpy(&seq, desc->pucEthernetBuffer + 14, sizeof(seq));
+        fill_frame(expect, seq, frame_len_of[seq & 0xFFFF]);
+        if (seq != next || desc->xDataLength != frame_len_of[seq & 0xFFFF]
+            || memcmp(desc->pucEthernetBuffer, expect, desc->xDataLength) != 0)
+            mismatches++;
+        next = seq + 1;
+        received++;
+        qca_free_desc(desc);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t frame[QCAFRM_ETHMAXLEN];
+    unsigned frames = 5000;
+    unsigned size   = 0;
+    unsigned last, idle;
+    uint64_t bytes = 0;
+    pthread_t modem;
+    int64_t start, us;
+    uint32_t seq;
+    int slave_fd;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:g:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            frames = (unsigned)strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            size = (unsigned)strtoul(optarg, NULL, 0);
+            break;
+        case 'g':
+            noise = (unsigned)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr,
+                    "usage: %s [-n frames] [-s size] [-g noise]\n"
+                    "  -n  frames to loop, default 5000\n"
+                    "  -s  fixed frame length, default random 60..1518\n"
+                    "  -g  bytes of line noise in front of every returned frame (max 64)\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (frames > 65536 || (size && (size < QCAFRM_ETHMINLEN || size > QCAFRM_ETHMAXLEN)))
+    {
+        fprintf(stderr, "frames up to 65536, size %d..%d\n", QCAFRM_ETHMINLEN, QCAFRM_ETHMAXLEN);
+        return 2;
+    }
+
+    master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master_fd < 0 || grantpt(master_fd) || unlockpt(master_fd)
+        || (slave_fd = open(ptsname(master_fd), O_RDWR | O_NOCTTY)) < 0)
+    {
+        perror("pty");
+        return 1;
+    }
+    host_uart_attach(QCAUART_PORT, slave_fd);
+
+    pthread_create(&modem, NULL, modem_thread, NULL);
+    qca_uart_init();
+
+    srand(1);
+    start = esp_timer_get_time();
+    for (seq = 0; seq < frames; seq++)
+    {
+        frame_len_of[seq] = size ? size : QCAFRM_ETHMINLEN + rand() % (QCAFRM_ETHMAXLEN - QCAFRM_ETHMINLEN + 1);
+        fill_frame(frame, seq, frame_len_of[seq]);
+        while (qca_send(frame, frame_len_of[seq]) != ESP_OK) usleep(100);
+        bytes += frame_len_of[seq];
+    }
+
+    /* Wait until nothing more arrives for a second */
+    for (last = received, idle = 0; received < frames && idle < 1000; idle = (received == last) ? idle + 1 : 0)
+    {
+        last = received;
+        usleep(1000);
+    }
+    us = esp_timer_get_time() - start;
+
+    printf("frames      %u sent, %u looped by the modem, %u received\n", frames, modem_frames, (unsigned)received);
+    printf("mismatches  %u\n", (unsigned)mismatches);
+    printf("rx_errors   %u, rx_dropped %u, tx_expired %u, tx_aqm_drop %u\n", qca.stats.rx_errors,
+           qca.stats.rx_dropped, qca.stats.tx_expired, qca.stats.tx_aqm_drop);
+    printf("throughput  %.2f MB/s each way\n", (double)bytes / (double)us);
+
+    return (received == frames && mismatches == 0) ? 0 : 1;
+}